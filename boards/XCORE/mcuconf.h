@@ -45,10 +45,14 @@
 /*
  * Memory attributes settings.
  */
-#define STM32_NOCACHE_ENABLE                FALSE
+/*
+ * SRAM1+SRAM2 (NOCACHE_RAM and ETH_RAM in the linker script) are excluded from
+ * the D-Cache so DMA buffers placed there stay coherent.
+ */
+#define STM32_NOCACHE_ENABLE                TRUE
 #define STM32_NOCACHE_MPU_REGION            MPU_REGION_6
-#define STM32_NOCACHE_RBAR                  0x24000000U
-#define STM32_NOCACHE_RASR                  MPU_RASR_SIZE_16K
+#define STM32_NOCACHE_RBAR                  0x30000000U
+#define STM32_NOCACHE_RASR                  MPU_RASR_SIZE_32K
 
 /*
  * PWR system settings.
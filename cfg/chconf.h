@@ -677,15 +677,9 @@ extern volatile uint32_t last_idle_tick;
  * @note    The default is @p FALSE.
  */
 #if !defined(CH_DBG_FILL_THREADS)
-#ifdef DEBUG_BUILD
+/* Also in release builds, the system monitor reports the stack watermarks.
+   Only costs time when a thread is created.*/
 #define CH_DBG_FILL_THREADS           TRUE
-#else
-#ifdef RELEASE_BUILD
-#define CH_DBG_FILL_THREADS           FALSE
-#else
-#error "Need to define either DEBUG_BUILD or RELEASE_BUILD"
-#endif
-#endif
 #endif
 
 /**
@@ -747,7 +741,12 @@ extern volatile uint32_t last_idle_tick;
  * @details User fields added to the end of the @p thread_t structure.
  */
 #define CH_CFG_THREAD_EXTRA_FIELDS                                          \
-  /* Add threads custom fields here.*/
+  /* Run time accounting for the system monitor (src/debug/system_monitor.hpp), \
+     in realtime counter cycles. Reset by the monitor on every sample.*/    \
+  rtcnt_t monitor_switched_in;                                              \
+  rtcnt_t monitor_max_slice;                                                \
+  uint32_t monitor_switches;                                                \
+  uint64_t monitor_cycles;
 
 /**
  * @brief   Threads initialization hook.
@@ -760,6 +759,10 @@ extern volatile uint32_t last_idle_tick;
  */
 #define _CH_CFG_THREAD_INIT_HOOK(tp) {                                       \
   /* Add threads initialization code here.*/                                \
+  (tp)->monitor_switched_in = chSysGetRealtimeCounterX();                   \
+  (tp)->monitor_max_slice = 0;                                              \
+  (tp)->monitor_switches = 0;                                               \
+  (tp)->monitor_cycles = 0;                                                 \
 }
 
 /**
@@ -781,6 +784,14 @@ extern volatile uint32_t last_idle_tick;
  */
 #define _CH_CFG_CONTEXT_SWITCH_HOOK(ntp, otp) {                              \
   /* Context switch code here.*/                                            \
+  const rtcnt_t monitor_now = chSysGetRealtimeCounterX();                   \
+  const rtcnt_t monitor_slice = monitor_now - (otp)->monitor_switched_in;   \
+  (otp)->monitor_cycles += monitor_slice;                                   \
+  if (monitor_slice > (otp)->monitor_max_slice) {                           \
+    (otp)->monitor_max_slice = monitor_slice;                               \
+  }                                                                         \
+  (ntp)->monitor_switched_in = monitor_now;                                 \
+  (ntp)->monitor_switches++;                                                \
 }
 
 /**
@@ -873,6 +884,8 @@ extern volatile uint32_t last_idle_tick;
 /*===========================================================================*/
 /* Port-specific settings (override port settings defaulted in chcore.h).    */
 /*===========================================================================*/
+/* SystemView defines the CH_CFG_*_HOOK macros itself and chains the _CH_CFG_*_HOOK ones above, which keeps
+   the system monitor accounting alive. Keep our hooks named _CH_CFG_* for that.*/
 #ifdef USE_SEGGER_SYSTEMVIEW
 #ifndef __ASSEMBLER__
 #include "SEGGER_SYSVIEW_ChibiOS.h"
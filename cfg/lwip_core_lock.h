@@ -0,0 +1,24 @@
+/*
+ * lwIP core lock (LWIP_TCPIP_CORE_LOCKING) on a ChibiOS mutex.
+ *
+ * The ChibiOS bindings set LWIP_COMPAT_MUTEX, which makes sys_mutex_t a binary semaphore without
+ * priority inheritance. The core lock is taken by threads from the debug up to the safety priority
+ * (see thread_priorities.h), so a low priority holder must be boosted instead of being preempted by
+ * everything in between. Like all ChibiOS mutexes, it has to be released in reverse locking order.
+ */
+
+#ifndef LWIP_CORE_LOCK_H
+#define LWIP_CORE_LOCK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void lwip_core_lock(void);
+void lwip_core_unlock(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LWIP_CORE_LOCK_H */
@@ -38,8 +38,13 @@
 #ifndef __LWIPOPT_H__
 #define __LWIPOPT_H__
 
+#include "thread_priorities.h"
+
 #define LWIP_LINK_POLL_INTERVAL TIME_S2I(5000)
 
+/* Ethernet receive thread of the ChibiOS bindings (lwipthread.h) */
+#define LWIP_THREAD_PRIORITY THD_PRIO_NETWORK
+
 /*
    -----------------------------------------------
    ---------- Platform specific locking ----------
@@ -1204,6 +1209,14 @@
 #define LWIP_NETIF_TX_SINGLE_PBUF             0
 #endif /* LWIP_NETIF_TX_SINGLE_PBUF */
 
+/**
+ * LWIP_SUPPORT_CUSTOM_PBUF==1: pbufs with a custom free function. xbot packets are
+ * sent from their own buffer and returned to the packet pool when lwIP frees them.
+ */
+#ifndef LWIP_SUPPORT_CUSTOM_PBUF
+#define LWIP_SUPPORT_CUSTOM_PBUF              1
+#endif
+
 /*
    ------------------------------------
    ---------- LOOPIF options ----------
@@ -1255,7 +1268,7 @@
  * sys_thread_new() when the thread is created.
  */
 #ifndef TCPIP_THREAD_PRIO
-#define TCPIP_THREAD_PRIO               (LOWPRIO + 1)
+#define TCPIP_THREAD_PRIO               THD_PRIO_NETWORK
 #endif
 
 /**
@@ -1384,11 +1397,19 @@
    ----------------------------------------------
 */
 /**
- * LWIP_TCPIP_CORE_LOCKING: (EXPERIMENTAL!)
- * Don't use it if you're not an active lwIP project member
+ * LWIP_TCPIP_CORE_LOCKING: Call the stack directly under a global lock instead of
+ * passing a message to the tcpip thread and waiting for it. The xbot sockets
+ * (portable/xbot/socket.cpp) use the raw UDP API from the service threads.
  */
 #ifndef LWIP_TCPIP_CORE_LOCKING
-#define LWIP_TCPIP_CORE_LOCKING         0
+#define LWIP_TCPIP_CORE_LOCKING         1
+#endif
+
+/* The core lock needs priority inheritance, which sys_mutex_t doesn't have here (see lwip_core_lock.h) */
+#if LWIP_TCPIP_CORE_LOCKING
+#include "lwip_core_lock.h"
+#define LOCK_TCPIP_CORE()               lwip_core_lock()
+#define UNLOCK_TCPIP_CORE()             lwip_core_unlock()
 #endif
 
 /**
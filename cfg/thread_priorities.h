@@ -0,0 +1,99 @@
+/*
+ * Thread priorities and deadlines of the firmware, in one place.
+ *
+ * Rate-monotonic: the shorter a thread's deadline, the higher its priority, i.e.
+ * safety > motor control > network > IMU > GPS > power > UI > debug.
+ * The network threads (lwIP and the xbot IO threads) sit above the sensors, because twist and
+ * emergency commands from the host pass through them; their work per packet is short.
+ *
+ * The deadline of a role is the longest acceptable response time of its threads (e.g. from an ESC
+ * frame to the new duty cycle, or the lateness of a periodic tick). Misses are counted at runtime
+ * and reported with the xbot diagnostics, see xbot/deadlines.hpp.
+ *
+ * Platform specific entries come first and take precedence over the defaults, keyed by
+ * ROBOT_PLATFORM_<name>. Plain C, so lwipopts.h can use it as well.
+ */
+
+#ifndef THREAD_PRIORITIES_H
+#define THREAD_PRIORITIES_H
+
+#if defined(ROBOT_PLATFORM_Sabo)
+/* The LCD rendering takes long, give it more time instead of priority */
+#define THD_DEADLINE_US_UI 250000
+#endif
+
+/* Emergency fast path (input edge to zero duty), above everything else */
+#ifndef THD_PRIO_EMERGENCY_STOP
+#define THD_PRIO_EMERGENCY_STOP HIGHPRIO
+#endif
+
+/* System monitor, only samples once per second, but must not be starved by what it observes */
+#ifndef THD_PRIO_MONITOR
+#define THD_PRIO_MONITOR (NORMALPRIO + 60)
+#endif
+
+/* Emergency and input services */
+#ifndef THD_PRIO_SAFETY
+#define THD_PRIO_SAFETY (NORMALPRIO + 50)
+#endif
+#ifndef THD_DEADLINE_US_SAFETY
+#define THD_DEADLINE_US_SAFETY 2000
+#endif
+
+/* Diff drive and mower services, ESC drivers */
+#ifndef THD_PRIO_MOTOR_CONTROL
+#define THD_PRIO_MOTOR_CONTROL (NORMALPRIO + 40)
+#endif
+#ifndef THD_DEADLINE_US_MOTOR_CONTROL
+#define THD_DEADLINE_US_MOTOR_CONTROL 10000
+#endif
+
+/* lwIP, xbot IO and TX threads */
+#ifndef THD_PRIO_NETWORK
+#define THD_PRIO_NETWORK (NORMALPRIO + 30)
+#endif
+#ifndef THD_DEADLINE_US_NETWORK
+#define THD_DEADLINE_US_NETWORK 5000
+#endif
+
+/* IMU service */
+#ifndef THD_PRIO_IMU
+#define THD_PRIO_IMU (NORMALPRIO + 20)
+#endif
+#ifndef THD_DEADLINE_US_IMU
+#define THD_DEADLINE_US_IMU 10000
+#endif
+
+/* GPS service and driver */
+#ifndef THD_PRIO_GPS
+#define THD_PRIO_GPS (NORMALPRIO + 10)
+#endif
+#ifndef THD_DEADLINE_US_GPS
+#define THD_DEADLINE_US_GPS 50000
+#endif
+
+/* Power, BMS and high level services */
+#ifndef THD_PRIO_POWER
+#define THD_PRIO_POWER NORMALPRIO
+#endif
+#ifndef THD_DEADLINE_US_POWER
+#define THD_DEADLINE_US_POWER 100000
+#endif
+
+/* Cover UI controllers and display drivers */
+#ifndef THD_PRIO_UI
+#define THD_PRIO_UI (NORMALPRIO - 10)
+#endif
+#ifndef THD_DEADLINE_US_UI
+#define THD_DEADLINE_US_UI 100000
+#endif
+
+/* Debug interfaces, service discovery */
+#ifndef THD_PRIO_DEBUG
+#define THD_PRIO_DEBUG (NORMALPRIO - 20)
+#endif
+#ifndef THD_DEADLINE_US_DEBUG
+#define THD_DEADLINE_US_DEBUG 1000000
+#endif
+
+#endif /* THREAD_PRIORITIES_H */
@@ -0,0 +1,130 @@
+//
+// HostSim: runs the GPS and VESC drivers on the host, fed from files or pipes.
+//
+// Usage: hostsim [--fast] [--ubx FILE | --nmea FILE] [--gps-tx FILE] [--vesc FILE] [--vesc-tx FILE]
+//
+// --ubx / --nmea   replay a recorded GPS stream (e.g. a u-center .ubx log) through the respective driver
+// --vesc           replay a recorded VESC stream through the VESC driver
+// --*-tx           write everything the drivers send (config, status requests) to FILE
+// --fast           don't pace RX data at the configured baud rate
+//
+// Use named pipes (mkfifo) or pseudo terminals (socat) to talk to real devices.
+//
+
+#include <ulog.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <xbot-service/portable/system.hpp>
+
+#include "ch.h"
+#include "drivers/gps/nmea_gps_driver.h"
+#include "drivers/gps/ublox_gps_driver.h"
+#include "drivers/motor/vesc/VescDriver.h"
+#include "hal.h"
+
+using namespace xbot::driver::gps;
+using namespace xbot::driver::motor;
+
+namespace {
+UbxGpsDriver ubx_driver{};
+NmeaGpsDriver nmea_driver{};
+VescDriver vesc_driver{};
+
+uint32_t gps_updates = 0;
+uint32_t vesc_updates = 0;
+
+void LogToStdout(ulog_level_t severity, char* msg) {
+  printf("%10u [%s] %s\n", TIME_I2MS(chVTGetSystemTimeX()), ulog_level_name(severity), msg);
+}
+
+void OnGpsState(const GpsDriver::GpsState& state) {
+  gps_updates++;
+  printf("gps: fix=%d rtk=%d sv=%u lat=%.8f lon=%.8f h=%.3f acc=%.3f vel=(%.3f, %.3f, %.3f) heading=%.3f\n",
+         state.fix_type, state.rtk_type, state.num_sv, state.pos_lat, state.pos_lon, state.pos_height,
+         state.position_h_accuracy, state.vel_e, state.vel_n, state.vel_u, state.motion_heading);
+}
+
+void OnVescState(const MotorDriver::ESCState& state) {
+  vesc_updates++;
+  printf("vesc: status=%u v_in=%.2f i_in=%.2f duty=%.3f rpm=%.1f tacho=%u t_pcb=%.1f t_motor=%.1f\n",
+         static_cast<unsigned>(state.status), state.voltage_input, state.current_input, state.duty_cycle, state.rpm,
+         state.tacho, state.temperature_pcb, state.temperature_motor);
+}
+
+void Usage(const char* argv0) {
+  fprintf(stderr, "Usage: %s [--fast] [--ubx FILE | --nmea FILE] [--gps-tx FILE] [--vesc FILE] [--vesc-tx FILE]\n",
+          argv0);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const char* gps_rx = nullptr;
+  const char* gps_tx = nullptr;
+  const char* vesc_rx = nullptr;
+  const char* vesc_tx = nullptr;
+  bool nmea = false;
+  bool paced = true;
+
+  for (int i = 1; i < argc; i++) {
+    const bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "--fast") == 0) {
+      paced = false;
+    } else if (strcmp(argv[i], "--ubx") == 0 && has_value) {
+      gps_rx = argv[++i];
+      nmea = false;
+    } else if (strcmp(argv[i], "--nmea") == 0 && has_value) {
+      gps_rx = argv[++i];
+      nmea = true;
+    } else if (strcmp(argv[i], "--gps-tx") == 0 && has_value) {
+      gps_tx = argv[++i];
+    } else if (strcmp(argv[i], "--vesc") == 0 && has_value) {
+      vesc_rx = argv[++i];
+    } else if (strcmp(argv[i], "--vesc-tx") == 0 && has_value) {
+      vesc_tx = argv[++i];
+    } else {
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+  if (gps_rx == nullptr && vesc_rx == nullptr) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  chRegSetThreadName("main");
+  xbot::service::system::initSystem(1);
+  ULOG_SUBSCRIBE(LogToStdout, ULOG_DEBUG_LEVEL);
+
+  if (gps_rx != nullptr) {
+    if (!hostsim::UartAttachFile(&UARTD1, gps_rx, gps_tx, paced)) {
+      fprintf(stderr, "Could not open GPS input %s\n", gps_rx);
+      return 1;
+    }
+    GpsDriver& gps = nmea ? static_cast<GpsDriver&>(nmea_driver) : static_cast<GpsDriver&>(ubx_driver);
+    gps.SetStateCallback(GpsDriver::StateCallback::create<OnGpsState>());
+    gps.StartDriver(&UARTD1, 921600);
+  }
+
+  if (vesc_rx != nullptr) {
+    if (!hostsim::UartAttachFile(&UARTD2, vesc_rx, vesc_tx, paced)) {
+      fprintf(stderr, "Could not open VESC input %s\n", vesc_rx);
+      return 1;
+    }
+    vesc_driver.SetUART(&UARTD2, 115200);
+    vesc_driver.SetStateCallback(MotorDriver::StateCallback::create<OnVescState>());
+    vesc_driver.Start();
+  }
+
+  // Run until all inputs are consumed, then give the drivers some time to process the last buffer.
+  while (!hostsim::UartRxDone(&UARTD1) || !hostsim::UartRxDone(&UARTD2)) {
+    chThdSleepMilliseconds(100);
+  }
+  chThdSleepMilliseconds(500);
+
+  printf("done: %u GPS updates, %u VESC updates\n", gps_updates, vesc_updates);
+  fflush(stdout);
+  // The driver threads are still running and blocked on kernel objects, skip the static destructors.
+  _Exit(0);
+}
@@ -0,0 +1,112 @@
+//
+// Parser throughput benchmark on the host, see src/debug/parser_benchmark.hpp.
+//
+// Usage: parser_benchmark [--replay FILE --parser ubx|nmea|vesc|yfr4esc [--chunk N] [--repeat N]]
+//
+// Without arguments, all parsers are run through the synthetic scenarios.
+// --replay   feed a recorded stream (e.g. a u-center .ubx log) through the given parser instead
+// --chunk    bytes per ProcessBytes() call, 0 for random 1..64 byte fragments (default: driver DMA buffer size)
+// --repeat   number of passes over the recording (default: 1)
+//
+
+#include <ulog.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <xbot-service/portable/system.hpp>
+
+#include "ch.h"
+#include "debug/parser_benchmark.hpp"
+
+using xbot::debug::ParserBenchmark;
+
+namespace {
+void LogToStdout(ulog_level_t severity, char* msg) {
+  printf("[%s] %s\n", ulog_level_name(severity), msg);
+}
+
+bool ParseParser(const char* name, ParserBenchmark::Parser& parser) {
+  static constexpr ParserBenchmark::Parser PARSERS[] = {
+      ParserBenchmark::Parser::UBX, ParserBenchmark::Parser::NMEA, ParserBenchmark::Parser::VESC,
+      ParserBenchmark::Parser::YFR4ESC, ParserBenchmark::Parser::YF_COVER_UI};
+  for (const auto candidate : PARSERS) {
+    if (strcmp(name, ParserBenchmark::ParserName(candidate)) == 0 && ParserBenchmark::IsAvailable(candidate)) {
+      parser = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ReadFile(const char* path, std::vector<uint8_t>& data) {
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  uint8_t buffer[4096];
+  size_t len;
+  while ((len = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    data.insert(data.end(), buffer, buffer + len);
+  }
+  fclose(file);
+  return true;
+}
+
+void Usage(const char* argv0) {
+  fprintf(stderr, "Usage: %s [--replay FILE --parser ubx|nmea|vesc|yfr4esc [--chunk N] [--repeat N]]\n", argv0);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  const char* replay = nullptr;
+  const char* parser_name = nullptr;
+  long chunk = -1;
+  long repeat = 1;
+
+  for (int i = 1; i < argc; i++) {
+    const bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "--replay") == 0 && has_value) {
+      replay = argv[++i];
+    } else if (strcmp(argv[i], "--parser") == 0 && has_value) {
+      parser_name = argv[++i];
+    } else if (strcmp(argv[i], "--chunk") == 0 && has_value) {
+      chunk = strtol(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--repeat") == 0 && has_value) {
+      repeat = strtol(argv[++i], nullptr, 10);
+    } else {
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+  if ((replay == nullptr) != (parser_name == nullptr) || repeat < 1) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  chRegSetThreadName("main");
+  xbot::service::system::initSystem(1);
+  ULOG_SUBSCRIBE(LogToStdout, ULOG_INFO_LEVEL);
+
+  if (replay == nullptr) {
+    ParserBenchmark::RunAll(ParserBenchmark::ResultCallback::create<&ParserBenchmark::LogResult>());
+  } else {
+    ParserBenchmark::Parser parser;
+    if (!ParseParser(parser_name, parser)) {
+      fprintf(stderr, "Unknown parser %s\n", parser_name);
+      return 1;
+    }
+    std::vector<uint8_t> data;
+    if (!ReadFile(replay, data)) {
+      fprintf(stderr, "Could not open %s\n", replay);
+      return 1;
+    }
+    const size_t chunk_size = chunk < 0 ? ParserBenchmark::DmaChunkSize(parser) : static_cast<size_t>(chunk);
+    ParserBenchmark::LogResult(ParserBenchmark::Run(parser, "replay", data.data(), data.size(), chunk_size, 0,
+                                                    static_cast<uint32_t>(repeat)));
+  }
+
+  fflush(stdout);
+  _Exit(0);
+}
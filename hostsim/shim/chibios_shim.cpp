@@ -0,0 +1,389 @@
+//
+// HostSim: implementation of the ChibiOS/RT subset declared in include/ch.h.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "ch.h"
+
+namespace hostsim {
+
+namespace {
+using Clock = std::chrono::steady_clock;
+using KernelGuard = std::unique_lock<std::recursive_mutex>;
+
+const Clock::time_point start_time = Clock::now();
+
+thread_local thread_t *current_thread = nullptr;
+
+// Armed virtual timers (unsorted, there are only a few of them).
+virtual_timer_t *timer_list = nullptr;
+// Never destroyed, the timer thread is still waiting on it when the process exits.
+std::condition_variable_any &timer_cv = *new std::condition_variable_any();
+bool timer_thread_started = false;
+
+Clock::time_point ToTimePoint(systime_t time) {
+  // systime_t wraps after ~5 days at 10kHz, which is fine for simulation runs.
+  return start_time + std::chrono::microseconds(TIME_I2US(time));
+}
+
+// Waits on cv until pred() is true or timeout expired. Returns pred().
+template <typename Pred>
+bool WaitFor(std::condition_variable_any &cv, KernelGuard &lk, sysinterval_t timeout, Pred pred) {
+  if (timeout == TIME_INFINITE) {
+    cv.wait(lk, pred);
+    return true;
+  }
+  return cv.wait_for(lk, std::chrono::microseconds(TIME_I2US(timeout)), pred);
+}
+
+// Signed distance to the deadline, negative if expired.
+int32_t TimeUntil(const virtual_timer_t *vtp) {
+  return (int32_t)(vtp->deadline - chVTGetSystemTimeX());
+}
+
+void TimerThread() {
+  KernelGuard lk(KernelLock());
+  while (true) {
+    virtual_timer_t *next = nullptr;
+    for (virtual_timer_t *vtp = timer_list; vtp != nullptr; vtp = vtp->next) {
+      if (next == nullptr || TimeUntil(vtp) < TimeUntil(next)) {
+        next = vtp;
+      }
+    }
+    if (next == nullptr) {
+      timer_cv.wait(lk);
+      continue;
+    }
+    if (TimeUntil(next) > 0) {
+      timer_cv.wait_until(lk, ToTimePoint(next->deadline));
+      continue;
+    }
+    // Expired: disarm and run the callback in "ISR" context (kernel locked)
+    vtfunc_t func = next->func;
+    void *par = next->par;
+    chVTResetI(next);
+    func(next, par);
+  }
+}
+}  // namespace
+
+std::recursive_mutex &KernelLock() {
+  static std::recursive_mutex lock;
+  return lock;
+}
+
+void Halt(const char *reason, const char *file, int line) {
+  fprintf(stderr, "HALT: %s (%s:%d)\n", reason != nullptr ? reason : "", file, line);
+  fflush(stderr);
+  abort();
+}
+
+}  // namespace hostsim
+
+using hostsim::KernelGuard;
+using hostsim::WaitFor;
+
+rtcnt_t chSysGetRealtimeCounterX() {
+  return (rtcnt_t)std::chrono::duration_cast<std::chrono::nanoseconds>(hostsim::Clock::now().time_since_epoch())
+      .count();
+}
+
+systime_t chVTGetSystemTimeX() {
+  const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(hostsim::Clock::now() - hostsim::start_time);
+  return (systime_t)((uint64_t)elapsed.count() * CH_CFG_ST_FREQUENCY / 1000000);
+}
+
+/*===========================================================================*/
+/* Threads                                                                   */
+/*===========================================================================*/
+
+thread_t *chThdCreateStatic(void *wsp, size_t size, tprio_t prio, tfunc_t pf, void *arg) {
+  (void)wsp;
+  (void)size;
+  // Threads are never joined or destroyed in the firmware, the thread_t lives forever.
+  auto *tp = new thread_t();
+  tp->prio = prio;
+  std::thread([tp, pf, arg]() {
+    hostsim::current_thread = tp;
+    pf(arg);
+  }).detach();
+  return tp;
+}
+
+thread_t *chThdGetSelfX() {
+  if (hostsim::current_thread == nullptr) {
+    // Threads not created by chThdCreateStatic (e.g. main)
+    hostsim::current_thread = new thread_t();
+  }
+  return hostsim::current_thread;
+}
+
+void chRegSetThreadName(const char *name) {
+  chThdGetSelfX()->name = name;
+}
+
+void chThdSleep(sysinterval_t time) {
+  if (time == TIME_INFINITE) {
+    while (true) {
+      std::this_thread::sleep_for(std::chrono::hours(1));
+    }
+  }
+  std::this_thread::sleep_for(std::chrono::microseconds(TIME_I2US(time)));
+}
+
+void chThdSleepUntil(systime_t time) {
+  std::this_thread::sleep_until(hostsim::ToTimePoint(time));
+}
+
+void chThdYield() {
+  std::this_thread::yield();
+}
+
+/*===========================================================================*/
+/* Semaphores                                                                */
+/*===========================================================================*/
+
+void chSemObjectInit(semaphore_t *sp, cnt_t n) {
+  KernelGuard lk(hostsim::KernelLock());
+  sp->cnt = n;
+}
+
+msg_t chSemWaitTimeout(semaphore_t *sp, sysinterval_t timeout) {
+  KernelGuard lk(hostsim::KernelLock());
+  if (!WaitFor(sp->cv, lk, timeout, [sp]() { return sp->cnt > 0; })) {
+    return MSG_TIMEOUT;
+  }
+  sp->cnt--;
+  return MSG_OK;
+}
+
+void chSemSignalI(semaphore_t *sp) {
+  sp->cnt++;
+  sp->cv.notify_one();
+}
+
+void chSemSignal(semaphore_t *sp) {
+  KernelGuard lk(hostsim::KernelLock());
+  chSemSignalI(sp);
+}
+
+cnt_t chSemGetCounterI(const semaphore_t *sp) {
+  return sp->cnt;
+}
+
+/*===========================================================================*/
+/* Mailboxes                                                                 */
+/*===========================================================================*/
+
+void chMBObjectInit(mailbox_t *mbp, msg_t *buf, size_t n) {
+  KernelGuard lk(hostsim::KernelLock());
+  mbp->buffer = buf;
+  mbp->size = n;
+  mbp->rd = 0;
+  mbp->cnt = 0;
+}
+
+void chMBReset(mailbox_t *mbp) {
+  KernelGuard lk(hostsim::KernelLock());
+  mbp->rd = 0;
+  mbp->cnt = 0;
+  mbp->cv.notify_all();
+}
+
+msg_t chMBPostI(mailbox_t *mbp, msg_t msg) {
+  if (mbp->cnt >= mbp->size) {
+    return MSG_TIMEOUT;
+  }
+  mbp->buffer[(mbp->rd + mbp->cnt) % mbp->size] = msg;
+  mbp->cnt++;
+  mbp->cv.notify_all();
+  return MSG_OK;
+}
+
+msg_t chMBPostTimeout(mailbox_t *mbp, msg_t msg, sysinterval_t timeout) {
+  KernelGuard lk(hostsim::KernelLock());
+  if (!WaitFor(mbp->cv, lk, timeout, [mbp]() { return mbp->cnt < mbp->size; })) {
+    return MSG_TIMEOUT;
+  }
+  return chMBPostI(mbp, msg);
+}
+
+msg_t chMBFetchI(mailbox_t *mbp, msg_t *msgp) {
+  if (mbp->cnt == 0) {
+    return MSG_TIMEOUT;
+  }
+  *msgp = mbp->buffer[mbp->rd];
+  mbp->rd = (mbp->rd + 1) % mbp->size;
+  mbp->cnt--;
+  mbp->cv.notify_all();
+  return MSG_OK;
+}
+
+msg_t chMBFetchTimeout(mailbox_t *mbp, msg_t *msgp, sysinterval_t timeout) {
+  KernelGuard lk(hostsim::KernelLock());
+  if (!WaitFor(mbp->cv, lk, timeout, [mbp]() { return mbp->cnt > 0; })) {
+    return MSG_TIMEOUT;
+  }
+  return chMBFetchI(mbp, msgp);
+}
+
+size_t chMBGetUsedCountI(const mailbox_t *mbp) {
+  return mbp->cnt;
+}
+
+size_t chMBGetFreeCountI(const mailbox_t *mbp) {
+  return mbp->size - mbp->cnt;
+}
+
+/*===========================================================================*/
+/* Events                                                                    */
+/*===========================================================================*/
+
+void chEvtRegisterMaskWithFlags(event_source_t *esp, event_listener_t *elp, eventmask_t events, eventflags_t wflags) {
+  KernelGuard lk(hostsim::KernelLock());
+  elp->next = esp->next;
+  esp->next = elp;
+  elp->listener = chThdGetSelfX();
+  elp->events = events;
+  elp->flags = 0;
+  elp->wflags = wflags;
+}
+
+void chEvtUnregister(event_source_t *esp, event_listener_t *elp) {
+  KernelGuard lk(hostsim::KernelLock());
+  event_listener_t **link = &esp->next;
+  while (*link != nullptr) {
+    if (*link == elp) {
+      *link = elp->next;
+      break;
+    }
+    link = &(*link)->next;
+  }
+}
+
+eventflags_t chEvtGetAndClearFlags(event_listener_t *elp) {
+  KernelGuard lk(hostsim::KernelLock());
+  eventflags_t flags = elp->flags;
+  elp->flags = 0;
+  return flags;
+}
+
+eventmask_t chEvtGetAndClearEvents(eventmask_t events) {
+  KernelGuard lk(hostsim::KernelLock());
+  thread_t *tp = chThdGetSelfX();
+  eventmask_t m = tp->epending & events;
+  tp->epending &= ~events;
+  return m;
+}
+
+eventmask_t chEvtAddEvents(eventmask_t events) {
+  KernelGuard lk(hostsim::KernelLock());
+  thread_t *tp = chThdGetSelfX();
+  tp->epending |= events;
+  return tp->epending;
+}
+
+void chEvtSignalI(thread_t *tp, eventmask_t events) {
+  tp->epending |= events;
+  tp->cv.notify_all();
+}
+
+void chEvtSignal(thread_t *tp, eventmask_t events) {
+  KernelGuard lk(hostsim::KernelLock());
+  chEvtSignalI(tp, events);
+}
+
+void chEvtBroadcastFlagsI(event_source_t *esp, eventflags_t flags) {
+  for (event_listener_t *elp = esp->next; elp != nullptr; elp = elp->next) {
+    elp->flags |= flags;
+    if (flags == 0 || (flags & elp->wflags) != 0) {
+      chEvtSignalI(elp->listener, elp->events);
+    }
+  }
+}
+
+void chEvtBroadcastFlags(event_source_t *esp, eventflags_t flags) {
+  KernelGuard lk(hostsim::KernelLock());
+  chEvtBroadcastFlagsI(esp, flags);
+}
+
+eventmask_t chEvtWaitOneTimeout(eventmask_t events, sysinterval_t timeout) {
+  KernelGuard lk(hostsim::KernelLock());
+  thread_t *tp = chThdGetSelfX();
+  if (!WaitFor(tp->cv, lk, timeout, [tp, events]() { return (tp->epending & events) != 0; })) {
+    return 0;
+  }
+  eventmask_t m = tp->epending & events;
+  m ^= m & (m - 1);  // lowest pending event
+  tp->epending &= ~m;
+  return m;
+}
+
+eventmask_t chEvtWaitAnyTimeout(eventmask_t events, sysinterval_t timeout) {
+  KernelGuard lk(hostsim::KernelLock());
+  thread_t *tp = chThdGetSelfX();
+  if (!WaitFor(tp->cv, lk, timeout, [tp, events]() { return (tp->epending & events) != 0; })) {
+    return 0;
+  }
+  eventmask_t m = tp->epending & events;
+  tp->epending &= ~m;
+  return m;
+}
+
+eventmask_t chEvtWaitAllTimeout(eventmask_t events, sysinterval_t timeout) {
+  KernelGuard lk(hostsim::KernelLock());
+  thread_t *tp = chThdGetSelfX();
+  if (!WaitFor(tp->cv, lk, timeout, [tp, events]() { return (tp->epending & events) == events; })) {
+    return 0;
+  }
+  tp->epending &= ~events;
+  return events;
+}
+
+/*===========================================================================*/
+/* Virtual timers                                                            */
+/*===========================================================================*/
+
+void chVTSetI(virtual_timer_t *vtp, sysinterval_t delay, vtfunc_t vtfunc, void *par) {
+  if (!hostsim::timer_thread_started) {
+    hostsim::timer_thread_started = true;
+    std::thread(hostsim::TimerThread).detach();
+  }
+  chVTResetI(vtp);
+  vtp->deadline = chTimeAddX(chVTGetSystemTimeX(), delay);
+  vtp->func = vtfunc;
+  vtp->par = par;
+  vtp->next = hostsim::timer_list;
+  hostsim::timer_list = vtp;
+  hostsim::timer_cv.notify_all();
+}
+
+void chVTSet(virtual_timer_t *vtp, sysinterval_t delay, vtfunc_t vtfunc, void *par) {
+  KernelGuard lk(hostsim::KernelLock());
+  chVTSetI(vtp, delay, vtfunc, par);
+}
+
+void chVTResetI(virtual_timer_t *vtp) {
+  virtual_timer_t **link = &hostsim::timer_list;
+  while (*link != nullptr) {
+    if (*link == vtp) {
+      *link = vtp->next;
+      break;
+    }
+    link = &(*link)->next;
+  }
+  vtp->next = nullptr;
+  vtp->func = nullptr;
+}
+
+void chVTReset(virtual_timer_t *vtp) {
+  KernelGuard lk(hostsim::KernelLock());
+  chVTResetI(vtp);
+}
+
+bool chVTIsArmedI(const virtual_timer_t *vtp) {
+  return vtp->func != nullptr;
+}
@@ -0,0 +1,198 @@
+//
+// HostSim: UART driver stub, see include/hal.h.
+//
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+
+#include "hal.h"
+
+UARTDriver UARTD1, UARTD2, UARTD3, UARTD4, UARTD5, UARTD6, UARTD7, UARTD8;
+
+namespace {
+using KernelGuard = std::unique_lock<std::recursive_mutex>;
+
+// Character match is configured through the upper byte of CR2 (see USART_CR2_ADD_Pos).
+bool CharacterMatch(const UARTDriver *uartp, uint8_t c) {
+  if (uartp->config == nullptr || uartp->config->rx_cm_cb == nullptr || (uartp->config->cr1 & USART_CR1_CMIE) == 0) {
+    return false;
+  }
+  return c == (uint8_t)(uartp->config->cr2 >> USART_CR2_ADD_Pos);
+}
+
+// Delivers one byte into the active receive buffer, like the RX DMA stream would.
+void DeliverByte(UARTDriver *uartp, uint8_t c) {
+  KernelGuard lk(hostsim::KernelLock());
+  // Wait for the driver to provide a buffer; real hardware would drop the byte (overrun),
+  // but on the host the producer is a file, so back-pressure is the more useful behavior.
+  uartp->rx_cv_.wait(lk, [uartp]() { return uartp->rx_active_ && uartp->rx_stream_.NDTR > 0; });
+
+  const size_t pos = uartp->rx_size_ - uartp->rx_stream_.NDTR;
+  uartp->rx_buffer_[pos] = c;
+  uartp->rx_stream_.NDTR = uartp->rx_stream_.NDTR - 1;
+  uartp->rx_bytes_++;
+
+  if (uartp->config->rxchar_cb != nullptr) {
+    uartp->config->rxchar_cb(uartp, c);
+  }
+  if (CharacterMatch(uartp, c)) {
+    uartp->config->rx_cm_cb(uartp);
+  }
+  if (uartp->rx_active_ && uartp->rx_stream_.NDTR == 0) {
+    uartp->rx_active_ = false;
+    if (uartp->config->rxend_cb != nullptr) {
+      uartp->config->rxend_cb(uartp);
+    }
+  }
+}
+
+void RxThread(UARTDriver *uartp) {
+  uint8_t buf[64];
+  auto next = std::chrono::steady_clock::now();
+  while (true) {
+    ssize_t len = read(uartp->rx_fd_, buf, sizeof(buf));
+    if (len <= 0) {
+      break;
+    }
+    for (ssize_t i = 0; i < len; i++) {
+      if (uartp->paced_ && uartp->config != nullptr && uartp->config->speed > 0) {
+        // 8N1: 10 bits per byte
+        next += std::chrono::nanoseconds(10ULL * 1000000000ULL / uartp->config->speed);
+        std::this_thread::sleep_until(next);
+      }
+      DeliverByte(uartp, buf[i]);
+    }
+  }
+  uartp->rx_eof_ = true;
+}
+
+void WriteTx(UARTDriver *uartp, const uint8_t *data, size_t size) {
+  if (uartp->tx_fd_ >= 0) {
+    size_t written = 0;
+    while (written < size) {
+      ssize_t len = write(uartp->tx_fd_, data + written, size - written);
+      if (len <= 0) {
+        break;
+      }
+      written += len;
+    }
+  }
+  uartp->tx_bytes_ += size;
+}
+
+// Plays the TX DMA stream: writes the buffer passed to uartStartSendI() and calls the end callbacks.
+void TxThread(UARTDriver *uartp) {
+  KernelGuard lk(hostsim::KernelLock());
+  while (true) {
+    uartp->tx_cv_.wait(lk, [uartp]() { return uartp->tx_active_; });
+    const uint8_t *data = uartp->tx_buffer_;
+    const size_t size = uartp->tx_size_;
+    lk.unlock();
+    WriteTx(uartp, data, size);
+    lk.lock();
+    uartp->tx_active_ = false;
+    if (uartp->config != nullptr && uartp->config->txend1_cb != nullptr) {
+      uartp->config->txend1_cb(uartp);
+    }
+    if (uartp->config != nullptr && uartp->config->txend2_cb != nullptr) {
+      uartp->config->txend2_cb(uartp);
+    }
+  }
+}
+}  // namespace
+
+msg_t uartStart(UARTDriver *uartp, const UARTConfig *config) {
+  KernelGuard lk(hostsim::KernelLock());
+  uartp->config = config;
+  return MSG_OK;
+}
+
+void uartStop(UARTDriver *uartp) {
+  KernelGuard lk(hostsim::KernelLock());
+  uartp->rx_active_ = false;
+  uartp->config = nullptr;
+}
+
+void uartStartReceiveI(UARTDriver *uartp, size_t n, void *rxbuf) {
+  uartp->rx_buffer_ = static_cast<uint8_t *>(rxbuf);
+  uartp->rx_size_ = n;
+  uartp->rx_stream_.NDTR = n;
+  uartp->rx_stream_.M0AR = (uint32_t)(uintptr_t)rxbuf;
+  uartp->rx_active_ = true;
+  uartp->rx_cv_.notify_all();
+}
+
+void uartStartReceive(UARTDriver *uartp, size_t n, void *rxbuf) {
+  KernelGuard lk(hostsim::KernelLock());
+  uartStartReceiveI(uartp, n, rxbuf);
+}
+
+size_t uartStopReceiveI(UARTDriver *uartp) {
+  if (!uartp->rx_active_) {
+    return UART_ERR_NOT_ACTIVE;
+  }
+  uartp->rx_active_ = false;
+  return uartp->rx_stream_.NDTR;
+}
+
+size_t uartStopReceive(UARTDriver *uartp) {
+  KernelGuard lk(hostsim::KernelLock());
+  return uartStopReceiveI(uartp);
+}
+
+void uartStartSendI(UARTDriver *uartp, size_t n, const void *txbuf) {
+  if (!uartp->tx_thread_started_) {
+    uartp->tx_thread_started_ = true;
+    std::thread(TxThread, uartp).detach();
+  }
+  uartp->tx_buffer_ = static_cast<const uint8_t *>(txbuf);
+  uartp->tx_size_ = n;
+  uartp->tx_active_ = true;
+  uartp->tx_cv_.notify_all();
+}
+
+void uartStartSend(UARTDriver *uartp, size_t n, const void *txbuf) {
+  KernelGuard lk(hostsim::KernelLock());
+  uartStartSendI(uartp, n, txbuf);
+}
+
+msg_t uartSendFullTimeout(UARTDriver *uartp, size_t *np, const void *txbuf, sysinterval_t timeout) {
+  (void)timeout;
+  WriteTx(uartp, static_cast<const uint8_t *>(txbuf), *np);
+  if (uartp->config != nullptr && uartp->config->txend2_cb != nullptr) {
+    KernelGuard lk(hostsim::KernelLock());
+    uartp->config->txend2_cb(uartp);
+  }
+  return MSG_OK;
+}
+
+namespace hostsim {
+
+void UartAttach(UARTDriver *uartp, int rx_fd, int tx_fd, bool paced) {
+  uartp->rx_fd_ = rx_fd;
+  uartp->tx_fd_ = tx_fd;
+  uartp->paced_ = paced;
+  uartp->rx_eof_ = rx_fd < 0;
+  if (rx_fd >= 0) {
+    std::thread(RxThread, uartp).detach();
+  }
+}
+
+bool UartAttachFile(UARTDriver *uartp, const char *rx_path, const char *tx_path, bool paced) {
+  int rx_fd = -1;
+  int tx_fd = -1;
+  if (rx_path != nullptr && (rx_fd = open(rx_path, O_RDONLY)) < 0) {
+    return false;
+  }
+  if (tx_path != nullptr && (tx_fd = open(tx_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+    if (rx_fd >= 0) close(rx_fd);
+    return false;
+  }
+  UartAttach(uartp, rx_fd, tx_fd, paced);
+  return true;
+}
+
+}  // namespace hostsim
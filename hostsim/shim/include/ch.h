@@ -0,0 +1,343 @@
+//
+// HostSim: minimal ChibiOS/RT API on top of the C++ standard library (pthreads).
+//
+// Only the subset used by the code compiled into the HostSim build is provided.
+// All "kernel" state (events, semaphores, mailboxes, virtual timers and the
+// chSysLock() critical sections) is protected by one recursive kernel lock,
+// which keeps the I-class / S-locked semantics of the firmware code intact.
+// Thread priorities are accepted but ignored.
+//
+
+#ifndef HOSTSIM_CH_H
+#define HOSTSIM_CH_H
+
+#ifndef __cplusplus
+#error "The HostSim ChibiOS shim can only be used from C++"
+#endif
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+
+/*===========================================================================*/
+/* Types and constants                                                       */
+/*===========================================================================*/
+
+// Pointers are passed through mailboxes, so msg_t needs to be pointer sized on the host.
+typedef intptr_t msg_t;
+typedef uint32_t systime_t;
+typedef uint32_t sysinterval_t;
+typedef uint32_t time_secs_t;
+typedef uint32_t time_msecs_t;
+typedef uint32_t time_usecs_t;
+typedef uint32_t rtcnt_t;
+typedef uint32_t syssts_t;
+typedef uint32_t eventmask_t;
+typedef uint32_t eventflags_t;
+typedef int32_t eventid_t;
+typedef uint32_t tprio_t;
+typedef int32_t cnt_t;
+typedef void (*tfunc_t)(void *p);
+
+#define MSG_OK ((msg_t)0)
+#define MSG_TIMEOUT ((msg_t)-1)
+#define MSG_RESET ((msg_t)-2)
+
+#define IDLEPRIO (tprio_t)1
+#define LOWPRIO (tprio_t)2
+#define NORMALPRIO (tprio_t)128
+#define HIGHPRIO (tprio_t)255
+
+#define ALL_EVENTS ((eventmask_t)-1)
+#define EVENT_MASK(eid) ((eventmask_t)1 << (eventmask_t)(eid))
+
+// Same tick rate as the firmware (cfg/chconf.h)
+#define CH_CFG_ST_FREQUENCY 10000
+
+#define TIME_IMMEDIATE ((sysinterval_t)0)
+#define TIME_INFINITE ((sysinterval_t)-1)
+
+#define TIME_S2I(secs) ((sysinterval_t)((uint64_t)(secs) * (uint64_t)CH_CFG_ST_FREQUENCY))
+#define TIME_MS2I(msecs) \
+  ((sysinterval_t)((((uint64_t)(msecs) * (uint64_t)CH_CFG_ST_FREQUENCY) + (uint64_t)999) / (uint64_t)1000))
+#define TIME_US2I(usecs) \
+  ((sysinterval_t)((((uint64_t)(usecs) * (uint64_t)CH_CFG_ST_FREQUENCY) + (uint64_t)999999) / (uint64_t)1000000))
+#define TIME_I2S(interval) \
+  (time_secs_t)((((uint64_t)(interval)) + (uint64_t)CH_CFG_ST_FREQUENCY - (uint64_t)1) / (uint64_t)CH_CFG_ST_FREQUENCY)
+#define TIME_I2MS(interval) \
+  (time_msecs_t)((((uint64_t)(interval) * (uint64_t)1000) + (uint64_t)CH_CFG_ST_FREQUENCY - (uint64_t)1) / \
+                 (uint64_t)CH_CFG_ST_FREQUENCY)
+#define TIME_I2US(interval) \
+  (time_usecs_t)((((uint64_t)(interval) * (uint64_t)1000000) + (uint64_t)CH_CFG_ST_FREQUENCY - (uint64_t)1) / \
+                 (uint64_t)CH_CFG_ST_FREQUENCY)
+
+/*===========================================================================*/
+/* Compiler portability (ccportab.h)                                         */
+/*===========================================================================*/
+
+// There are no memory regions on the host, section placement is ignored.
+#define CC_SECTION(s)
+#define CC_ALIGN_DATA(n) __attribute__((aligned(n)))
+#define CC_PACK __attribute__((packed))
+#define CC_NO_INLINE __attribute__((noinline))
+#define CC_FORCE_INLINE __attribute__((always_inline))
+#define CC_WEAK __attribute__((weak))
+
+/*===========================================================================*/
+/* System                                                                    */
+/*===========================================================================*/
+
+namespace hostsim {
+// The big kernel lock, see file header.
+std::recursive_mutex &KernelLock();
+[[noreturn]] void Halt(const char *reason, const char *file, int line);
+}  // namespace hostsim
+
+#define chDbgAssert(c, r)                           \
+  do {                                              \
+    if (!(c)) {                                     \
+      hostsim::Halt((r), __FILE__, __LINE__);       \
+    }                                               \
+  } while (false)
+#define chDbgCheck(c) chDbgAssert(c, #c)
+#define osalDbgAssert(c, r) chDbgAssert(c, r)
+#define osalDbgCheck(c) chDbgCheck(c)
+
+inline void chSysLock() {
+  hostsim::KernelLock().lock();
+}
+inline void chSysUnlock() {
+  hostsim::KernelLock().unlock();
+}
+inline void chSysLockFromISR() {
+  chSysLock();
+}
+inline void chSysUnlockFromISR() {
+  chSysUnlock();
+}
+// The kernel lock is recursive, so the status is not needed
+inline syssts_t chSysGetStatusAndLockX() {
+  chSysLock();
+  return 0;
+}
+inline void chSysRestoreStatusX(syssts_t) {
+  chSysUnlock();
+}
+[[noreturn]] inline void chSysHalt(const char *reason) {
+  hostsim::Halt(reason, __FILE__, __LINE__);
+}
+
+// Free running counter, counts nanoseconds on the host (DWT CYCCNT on target).
+rtcnt_t chSysGetRealtimeCounterX();
+
+/*===========================================================================*/
+/* Time                                                                      */
+/*===========================================================================*/
+
+systime_t chVTGetSystemTimeX();
+inline systime_t chVTGetSystemTime() {
+  return chVTGetSystemTimeX();
+}
+inline sysinterval_t chTimeDiffX(systime_t start, systime_t end) {
+  return (sysinterval_t)((systime_t)(end - start));
+}
+inline systime_t chTimeAddX(systime_t systime, sysinterval_t interval) {
+  return systime + (systime_t)interval;
+}
+inline sysinterval_t chVTTimeElapsedSinceX(systime_t start) {
+  return chTimeDiffX(start, chVTGetSystemTimeX());
+}
+inline bool chTimeIsInRangeX(systime_t time, systime_t start, systime_t end) {
+  return (systime_t)((systime_t)time - (systime_t)start) < (systime_t)((systime_t)end - (systime_t)start);
+}
+
+/*===========================================================================*/
+/* Threads                                                                   */
+/*===========================================================================*/
+
+typedef struct ch_thread {
+  const char *name = nullptr;
+  tprio_t prio = NORMALPRIO;
+  eventmask_t epending = 0;
+  // Signalled (under the kernel lock) whenever epending changes.
+  std::condition_variable_any cv;
+} thread_t;
+
+// The working area is not used as stack on the host, keep the symbol for sizeof().
+#define THD_WORKING_AREA(s, n) uint8_t s[(n)]
+#define THD_FUNCTION(tname, arg) void tname(void *arg)
+
+thread_t *chThdCreateStatic(void *wsp, size_t size, tprio_t prio, tfunc_t pf, void *arg);
+thread_t *chThdGetSelfX();
+void chRegSetThreadName(const char *name);
+inline const char *chRegGetThreadNameX(thread_t *tp) {
+  return tp->name;
+}
+void chThdSleep(sysinterval_t time);
+void chThdSleepUntil(systime_t time);
+void chThdYield();
+inline void chThdSleepSeconds(uint32_t sec) {
+  chThdSleep(TIME_S2I(sec));
+}
+inline void chThdSleepMilliseconds(uint32_t msec) {
+  chThdSleep(TIME_MS2I(msec));
+}
+inline void chThdSleepMicroseconds(uint32_t usec) {
+  chThdSleep(TIME_US2I(usec));
+}
+
+/*===========================================================================*/
+/* Mutexes                                                                   */
+/*===========================================================================*/
+
+typedef struct ch_mutex {
+  std::recursive_mutex m;
+} mutex_t;
+
+#define MUTEX_DECL(name) mutex_t name
+inline void chMtxObjectInit(mutex_t *mp) {
+  (void)mp;
+}
+inline void chMtxLock(mutex_t *mp) {
+  mp->m.lock();
+}
+inline bool chMtxTryLock(mutex_t *mp) {
+  return mp->m.try_lock();
+}
+inline void chMtxUnlock(mutex_t *mp) {
+  mp->m.unlock();
+}
+
+/*===========================================================================*/
+/* Semaphores                                                                */
+/*===========================================================================*/
+
+typedef struct ch_semaphore {
+  explicit ch_semaphore(cnt_t n = 0) : cnt(n) {
+  }
+  cnt_t cnt;
+  std::condition_variable_any cv;
+} semaphore_t;
+
+#define SEMAPHORE_DECL(name, n) semaphore_t name{n}
+void chSemObjectInit(semaphore_t *sp, cnt_t n);
+msg_t chSemWaitTimeout(semaphore_t *sp, sysinterval_t timeout);
+inline msg_t chSemWait(semaphore_t *sp) {
+  return chSemWaitTimeout(sp, TIME_INFINITE);
+}
+void chSemSignalI(semaphore_t *sp);
+void chSemSignal(semaphore_t *sp);
+cnt_t chSemGetCounterI(const semaphore_t *sp);
+// Only valid while the counter is positive (no waiting)
+inline void chSemFastWaitI(semaphore_t *sp) {
+  sp->cnt--;
+}
+
+/*===========================================================================*/
+/* Mailboxes                                                                 */
+/*===========================================================================*/
+
+typedef struct ch_mailbox {
+  msg_t *buffer = nullptr;
+  size_t size = 0;
+  size_t rd = 0;
+  size_t cnt = 0;
+  std::condition_variable_any cv;
+} mailbox_t;
+
+void chMBObjectInit(mailbox_t *mbp, msg_t *buf, size_t n);
+void chMBReset(mailbox_t *mbp);
+msg_t chMBPostTimeout(mailbox_t *mbp, msg_t msg, sysinterval_t timeout);
+msg_t chMBPostI(mailbox_t *mbp, msg_t msg);
+msg_t chMBFetchTimeout(mailbox_t *mbp, msg_t *msgp, sysinterval_t timeout);
+msg_t chMBFetchI(mailbox_t *mbp, msg_t *msgp);
+size_t chMBGetUsedCountI(const mailbox_t *mbp);
+size_t chMBGetFreeCountI(const mailbox_t *mbp);
+
+/*===========================================================================*/
+/* Events                                                                    */
+/*===========================================================================*/
+
+typedef struct event_listener {
+  struct event_listener *next = nullptr;
+  thread_t *listener = nullptr;
+  eventmask_t events = 0;
+  eventflags_t flags = 0;
+  eventflags_t wflags = 0;
+} event_listener_t;
+
+typedef struct event_source {
+  event_listener_t *next = nullptr;
+} event_source_t;
+
+#define EVENTSOURCE_DECL(name) event_source_t name
+inline void chEvtObjectInit(event_source_t *esp) {
+  esp->next = nullptr;
+}
+void chEvtRegisterMaskWithFlags(event_source_t *esp, event_listener_t *elp, eventmask_t events, eventflags_t wflags);
+inline void chEvtRegisterMask(event_source_t *esp, event_listener_t *elp, eventmask_t events) {
+  chEvtRegisterMaskWithFlags(esp, elp, events, (eventflags_t)-1);
+}
+inline void chEvtRegister(event_source_t *esp, event_listener_t *elp, eventid_t event) {
+  chEvtRegisterMask(esp, elp, EVENT_MASK(event));
+}
+void chEvtUnregister(event_source_t *esp, event_listener_t *elp);
+eventflags_t chEvtGetAndClearFlags(event_listener_t *elp);
+eventmask_t chEvtGetAndClearEvents(eventmask_t events);
+eventmask_t chEvtAddEvents(eventmask_t events);
+void chEvtSignalI(thread_t *tp, eventmask_t events);
+void chEvtSignal(thread_t *tp, eventmask_t events);
+void chEvtBroadcastFlagsI(event_source_t *esp, eventflags_t flags);
+void chEvtBroadcastFlags(event_source_t *esp, eventflags_t flags);
+inline void chEvtBroadcastI(event_source_t *esp) {
+  chEvtBroadcastFlagsI(esp, (eventflags_t)0);
+}
+inline void chEvtBroadcast(event_source_t *esp) {
+  chEvtBroadcastFlags(esp, (eventflags_t)0);
+}
+eventmask_t chEvtWaitOneTimeout(eventmask_t events, sysinterval_t timeout);
+eventmask_t chEvtWaitAnyTimeout(eventmask_t events, sysinterval_t timeout);
+eventmask_t chEvtWaitAllTimeout(eventmask_t events, sysinterval_t timeout);
+inline eventmask_t chEvtWaitOne(eventmask_t events) {
+  return chEvtWaitOneTimeout(events, TIME_INFINITE);
+}
+inline eventmask_t chEvtWaitAny(eventmask_t events) {
+  return chEvtWaitAnyTimeout(events, TIME_INFINITE);
+}
+inline eventmask_t chEvtWaitAll(eventmask_t events) {
+  return chEvtWaitAllTimeout(events, TIME_INFINITE);
+}
+
+/*===========================================================================*/
+/* Virtual timers                                                            */
+/*===========================================================================*/
+
+typedef struct ch_virtual_timer virtual_timer_t;
+typedef void (*vtfunc_t)(virtual_timer_t *vtp, void *p);
+
+struct ch_virtual_timer {
+  struct ch_virtual_timer *next = nullptr;
+  systime_t deadline = 0;
+  vtfunc_t func = nullptr;
+  void *par = nullptr;
+};
+
+inline void chVTObjectInit(virtual_timer_t *vtp) {
+  vtp->func = nullptr;
+}
+void chVTSetI(virtual_timer_t *vtp, sysinterval_t delay, vtfunc_t vtfunc, void *par);
+void chVTSet(virtual_timer_t *vtp, sysinterval_t delay, vtfunc_t vtfunc, void *par);
+void chVTResetI(virtual_timer_t *vtp);
+void chVTReset(virtual_timer_t *vtp);
+bool chVTIsArmedI(const virtual_timer_t *vtp);
+inline bool chVTIsArmed(const virtual_timer_t *vtp) {
+  chSysLock();
+  bool armed = chVTIsArmedI(vtp);
+  chSysUnlock();
+  return armed;
+}
+
+#endif  // HOSTSIM_CH_H
@@ -0,0 +1,140 @@
+//
+// HostSim: minimal ChibiOS/HAL API for the host build.
+//
+// Only the UART driver is provided. Each UART can be attached to file
+// descriptors (files, pipes, pseudo terminals): bytes read from the RX fd are
+// "DMA"-ed into the buffer passed to uartStartReceive() at the configured baud
+// rate, including the rxend and character-match callbacks, and transmitted
+// bytes are written to the TX fd.
+//
+
+#ifndef HOSTSIM_HAL_H
+#define HOSTSIM_HAL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include "ch.h"
+
+/*===========================================================================*/
+/* Cache                                                                     */
+/*===========================================================================*/
+
+#define CACHE_LINE_SIZE 32U
+#define cacheBufferInvalidate(saddr, n) \
+  {                                     \
+    (void)(saddr);                      \
+    (void)(n);                          \
+  }
+#define cacheBufferFlush(saddr, n) \
+  {                                \
+    (void)(saddr);                 \
+    (void)(n);                     \
+  }
+
+/*===========================================================================*/
+/* UART                                                                      */
+/*===========================================================================*/
+
+#define UART_ERR_NOT_ACTIVE ((size_t)-1)
+
+// USART register bits used to configure the character match interrupt
+#define USART_CR1_IDLEIE (1U << 4)
+#define USART_CR1_CMIE (1U << 14)
+#define USART_CR2_ADD_Pos 24U
+
+typedef uint32_t uartflags_t;
+typedef struct hal_uart_driver UARTDriver;
+typedef void (*uartcb_t)(UARTDriver *uartp);
+typedef void (*uartccb_t)(UARTDriver *uartp, uint16_t c);
+typedef void (*uartecb_t)(UARTDriver *uartp, uartflags_t e);
+
+typedef struct hal_uart_config {
+  uartcb_t txend1_cb;
+  uartcb_t txend2_cb;
+  uartcb_t rxend_cb;
+  uartccb_t rxchar_cb;
+  uartecb_t rxerr_cb;
+  uartcb_t timeout_cb;
+  uartcb_t rx_cm_cb;
+  uint32_t timeout;
+  uint32_t speed;
+  uint32_t cr1;
+  uint32_t cr2;
+  uint32_t cr3;
+} UARTConfig;
+
+namespace hostsim {
+// Stands in for the DMA stream registers which are polled by the drivers.
+struct DmaStream {
+  volatile uint32_t NDTR = 0;
+  volatile uint32_t M0AR = 0;
+};
+struct DmaChannel {
+  DmaStream *stream;
+};
+}  // namespace hostsim
+
+struct hal_uart_driver {
+  const UARTConfig *config = nullptr;
+  const hostsim::DmaChannel *dmarx = &rx_dma_;
+
+  // HostSim state, guarded by the kernel lock
+  hostsim::DmaStream rx_stream_{};
+  hostsim::DmaChannel rx_dma_{&rx_stream_};
+  uint8_t *rx_buffer_ = nullptr;
+  size_t rx_size_ = 0;
+  bool rx_active_ = false;
+  std::condition_variable_any rx_cv_;
+  int rx_fd_ = -1;
+  int tx_fd_ = -1;
+  // Asynchronous transmission (uartStartSendI), handled by a TX thread
+  const uint8_t *tx_buffer_ = nullptr;
+  size_t tx_size_ = 0;
+  bool tx_active_ = false;
+  bool tx_thread_started_ = false;
+  std::condition_variable_any tx_cv_;
+  bool paced_ = true;
+  std::atomic<bool> rx_eof_{true};
+  std::atomic<uint64_t> rx_bytes_{0};
+  std::atomic<uint64_t> rx_dropped_{0};
+  std::atomic<uint64_t> tx_bytes_{0};
+};
+
+extern UARTDriver UARTD1, UARTD2, UARTD3, UARTD4, UARTD5, UARTD6, UARTD7, UARTD8;
+
+msg_t uartStart(UARTDriver *uartp, const UARTConfig *config);
+void uartStop(UARTDriver *uartp);
+void uartStartReceiveI(UARTDriver *uartp, size_t n, void *rxbuf);
+void uartStartReceive(UARTDriver *uartp, size_t n, void *rxbuf);
+size_t uartStopReceiveI(UARTDriver *uartp);
+size_t uartStopReceive(UARTDriver *uartp);
+void uartStartSendI(UARTDriver *uartp, size_t n, const void *txbuf);
+void uartStartSend(UARTDriver *uartp, size_t n, const void *txbuf);
+msg_t uartSendFullTimeout(UARTDriver *uartp, size_t *np, const void *txbuf, sysinterval_t timeout);
+inline msg_t uartSendTimeout(UARTDriver *uartp, size_t *np, const void *txbuf, sysinterval_t timeout) {
+  return uartSendFullTimeout(uartp, np, txbuf, timeout);
+}
+
+namespace hostsim {
+
+/**
+ * Connects a UART to file descriptors. Either one may be -1 (no RX data / TX is discarded).
+ * With paced = true, RX bytes are delivered at the configured baud rate (10 bits per byte),
+ * otherwise as fast as the drivers accept them (for benchmarking).
+ */
+void UartAttach(UARTDriver *uartp, int rx_fd, int tx_fd, bool paced = true);
+
+// Convenience wrapper opening the given paths, nullptr for unused directions.
+bool UartAttachFile(UARTDriver *uartp, const char *rx_path, const char *tx_path, bool paced = true);
+
+// True, once all bytes of the RX fd have been delivered into a receive buffer (or no RX fd is attached).
+inline bool UartRxDone(const UARTDriver *uartp) {
+  return uartp->rx_eof_;
+}
+
+}  // namespace hostsim
+
+#endif  // HOSTSIM_HAL_H
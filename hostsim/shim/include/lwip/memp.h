@@ -0,0 +1,60 @@
+//
+// HostSim: lwIP custom memory pools (LWIP_MEMPOOL_*) on top of a fixed array and a free list.
+//
+
+#ifndef HOSTSIM_LWIP_MEMP_H
+#define HOSTSIM_LWIP_MEMP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace hostsim {
+
+struct MemPool {
+  uint8_t *base;
+  size_t num;
+  size_t size;
+  void *free_list = nullptr;
+  std::mutex mtx{};
+
+  void Init() {
+    std::lock_guard<std::mutex> lk(mtx);
+    free_list = nullptr;
+    for (size_t i = num; i > 0; i--) {
+      void *elem = base + (i - 1) * size;
+      *static_cast<void **>(elem) = free_list;
+      free_list = elem;
+    }
+  }
+
+  void *Alloc() {
+    std::lock_guard<std::mutex> lk(mtx);
+    void *elem = free_list;
+    if (elem != nullptr) {
+      free_list = *static_cast<void **>(elem);
+    }
+    return elem;
+  }
+
+  void Free(void *elem) {
+    std::lock_guard<std::mutex> lk(mtx);
+    *static_cast<void **>(elem) = free_list;
+    free_list = elem;
+  }
+};
+
+}  // namespace hostsim
+
+#define HOSTSIM_MEMPOOL_ELEM_SIZE(size) \
+  ((((size) < sizeof(void *) ? sizeof(void *) : (size)) + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1))
+
+#define LWIP_MEMPOOL_PROTOTYPE(name) extern hostsim::MemPool memp_##name
+#define LWIP_MEMPOOL_DECLARE(name, num, size, desc)                                                   \
+  alignas(max_align_t) static uint8_t memp_memory_##name[(num) * HOSTSIM_MEMPOOL_ELEM_SIZE(size)]; \
+  hostsim::MemPool memp_##name{memp_memory_##name, (num), HOSTSIM_MEMPOOL_ELEM_SIZE(size)};
+#define LWIP_MEMPOOL_INIT(name) memp_##name.Init()
+#define LWIP_MEMPOOL_ALLOC(name) memp_##name.Alloc()
+#define LWIP_MEMPOOL_FREE(name, x) memp_##name.Free(x)
+
+#endif  // HOSTSIM_LWIP_MEMP_H
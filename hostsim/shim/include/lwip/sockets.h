@@ -0,0 +1,29 @@
+//
+// HostSim: lwIP BSD socket API mapped onto the host's POSIX sockets.
+//
+
+#ifndef HOSTSIM_LWIP_SOCKETS_H
+#define HOSTSIM_LWIP_SOCKETS_H
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define lwip_close close
+#define lwip_read read
+#define lwip_write write
+
+// Only the interface address is used (see portable/xbot/socket.cpp)
+struct netif {
+  struct {
+    in_addr addr;
+  } ip_addr;
+};
+
+extern struct netif *netif_default;
+
+#endif  // HOSTSIM_LWIP_SOCKETS_H
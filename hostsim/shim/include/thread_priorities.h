@@ -0,0 +1,10 @@
+//
+// HostSim: the firmware's thread priority table, the rest of cfg/ is not used by the host build.
+//
+
+#ifndef HOSTSIM_THREAD_PRIORITIES_H
+#define HOSTSIM_THREAD_PRIORITIES_H
+
+#include "../../../cfg/thread_priorities.h"
+
+#endif  // HOSTSIM_THREAD_PRIORITIES_H
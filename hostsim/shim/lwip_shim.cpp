@@ -0,0 +1,12 @@
+//
+// HostSim: network interface used by the portable layer (see include/lwip/sockets.h).
+//
+
+#include "lwip/sockets.h"
+
+namespace {
+// The firmware binds its sockets to the interface address, on the host loopback works everywhere.
+netif loopback_netif{{{htonl(INADDR_LOOPBACK)}}};
+}  // namespace
+
+netif *netif_default = &loopback_netif;
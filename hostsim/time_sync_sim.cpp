@@ -0,0 +1,92 @@
+//
+// Simulation of the host clock synchronization (portable/xbot/time_sync.cpp), run as a test.
+//
+// The host clock runs DRIFT_PPM faster than the board clock and starts with an offset. Every SYNC_PERIOD_MS the
+// simulated host runs a four timestamp exchange, with a fixed path delay and, for some exchanges, extra queuing
+// delay in one direction. After the estimate settled, ToHostNanos() of random board times must be within
+// MAX_ERROR_US of the true host time.
+//
+// Usage: time_sync_sim [--drift-ppm N]
+//
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <xbot/time_sync.hpp>
+#include <xbot/timebase.hpp>
+
+namespace {
+constexpr int64_t HOST_OFFSET_NS = 1'700'000'000'000'000'000;
+constexpr uint64_t SYNC_PERIOD_MS = 1000;
+constexpr uint64_t SETTLE_EXCHANGES = 120;
+constexpr uint64_t EXCHANGES = 1200;
+constexpr uint64_t PATH_DELAY_NS = 150'000;
+constexpr uint64_t MAX_QUEUING_NS = 3'000'000;
+constexpr uint64_t TURNAROUND_NS = 30'000;
+constexpr int64_t MAX_ERROR_US = 50;
+
+double drift_ppm = 80.0;
+std::mt19937_64 rng{42};
+
+// Board time in ns -> true host time in ns
+int64_t HostTime(uint64_t board_ns) {
+  return HOST_OFFSET_NS + static_cast<int64_t>(static_cast<double>(board_ns) * (1.0 + drift_ppm * 1e-6));
+}
+
+uint64_t PathDelay() {
+  // Every fifth packet is queued behind other traffic
+  std::uniform_int_distribution<uint64_t> queuing{0, MAX_QUEUING_NS};
+  std::uniform_int_distribution<int> chance{0, 4};
+  return PATH_DELAY_NS + (chance(rng) == 0 ? queuing(rng) : 0);
+}
+
+// Board timestamps are taken from the timebase, so they are multiples of a tick
+uint64_t ToBoardTick(uint64_t board_ns) {
+  return board_ns / xbot::timebase::NANOS_PER_TICK * xbot::timebase::NANOS_PER_TICK;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--drift-ppm") == 0 && i + 1 < argc) {
+      drift_ppm = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "Usage: %s [--drift-ppm N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  using namespace xbot::time_sync;
+  std::uniform_int_distribution<uint64_t> sample_time{0, SYNC_PERIOD_MS * 1'000'000};
+  int64_t max_error_ns = 0;
+  uint64_t board_ns = 10'000'000'000;
+  for (uint64_t exchange = 0; exchange < EXCHANGES; exchange++) {
+    // SYNC leaves the host at board time board_ns
+    const uint64_t t1 = HostTime(board_ns);
+    const uint64_t t2 = ToBoardTick(board_ns + PathDelay());
+    const uint64_t t3 = ToBoardTick(t2 + TURNAROUND_NS);
+    const uint64_t t4 = HostTime(t3 + PathDelay());
+    detail::AddSample(t1, t2, t3, t4);
+
+    if (exchange >= SETTLE_EXCHANGES) {
+      // Outputs stamped until the next exchange
+      for (int i = 0; i < 10; i++) {
+        const uint64_t ticks = (t3 + sample_time(rng)) / xbot::timebase::NANOS_PER_TICK;
+        const int64_t error =
+            static_cast<int64_t>(ToHostNanos(ticks)) - HostTime(xbot::timebase::TicksToNanos(ticks));
+        if (llabs(error) > max_error_ns) {
+          max_error_ns = llabs(error);
+        }
+      }
+    }
+    board_ns += SYNC_PERIOD_MS * 1'000'000;
+  }
+
+  const Estimate estimate = GetEstimate();
+  printf("drift %.1f ppm: estimated %.1f ppm, %u accepted, %u rejected, max. error %lld us\n", drift_ppm,
+         estimate.drift_ppb / 1000.0, estimate.accepted, estimate.rejected,
+         static_cast<long long>(max_error_ns / 1000));
+  return max_error_ns <= MAX_ERROR_US * 1000 ? 0 : 1;
+}
@@ -1,6 +1,7 @@
 //
 // Created by clemens on 7/14/24.
 //
+#include <lwip/sockets.h>
 #include <string.h>
 #include <ulog.h>
 
@@ -8,6 +9,16 @@
 #include <xbot-service/Lock.hpp>
 #include <xbot-service/portable/thread.hpp>
 #include <xbot/datatypes/XbotHeader.hpp>
+#include <xbot/deadlines.hpp>
+#include <xbot/io_diagnostics.hpp>
+#include <xbot/io_priority.hpp>
+#include <xbot/output_subscriptions.hpp>
+#include <xbot/packet_chaining.hpp>
+#include <xbot/packet_pool.hpp>
+#include <xbot/system_monitor.hpp>
+#include <xbot/time_sync.hpp>
+#include <xbot/timebase.hpp>
+#include <xbot/trace.hpp>
 
 namespace xbot::service {
 
@@ -15,6 +26,8 @@ namespace xbot::service {
 // All services have a pointer to the next one, so we can loop through all
 // of them (for IO)
 static ServiceIo* firstService_ = nullptr;
+// Dense service id -> service lookup for ids below SERVICE_TABLE_SIZE
+static ServiceIo* serviceTable_[io_diagnostics::SERVICE_TABLE_SIZE]{};
 
 // This Socket is used for all UDP comms for all the services
 static XBOT_SOCKET_TYPEDEF udp_socket_{};
@@ -25,19 +38,377 @@ static XBOT_SOCKET_TYPEDEF udp_socket_{};
  */
 #ifdef XBOT_ENABLE_STATIC_STACK
 static THD_WORKING_AREA(waIoThread, 2000);
+static THD_WORKING_AREA(waTxThread, 1024);
 #endif
 XBOT_THREAD_TYPEDEF io_thread_{};
+XBOT_THREAD_TYPEDEF tx_thread_{};
 
 static const char* IO_THD_NAME = "xbot-io";
+static const char* TX_THD_NAME = "xbot-tx";
+
+// Datagram being filled with packets for the same destination (see xbot/packet_chaining.hpp).
+// The first packet is used as buffer for the whole datagram.
+static packet::PacketPtr txFrame_ = nullptr;
+static uint32_t txFrameIp_ = 0;
+static uint16_t txFramePort_ = 0;
+static uint32_t txFramePackets_ = 0;
+static MUTEX_DECL(txMutex_);
+// Signalled when a new datagram was started, the TX thread sends it after the coalescing window
+static SEMAPHORE_DECL(txFrameStarted_, 0);
 
 using namespace xbot::service;
 
+/**
+ * Answers a time sync packet in place and sends it back to its origin, see xbot/time_sync.hpp.
+ * Takes ownership of the packet.
+ */
+static void handleTimeSync(packet::PacketPtr packet, datatypes::XbotHeader* header) {
+  using namespace xbot::time_sync;
+  if (header->payload_size != sizeof(TimeSyncMessage)) {
+    ULOG_ERROR("Time sync packet has the wrong size.");
+    packet::freePacket(packet);
+    return;
+  }
+  auto* msg = reinterpret_cast<TimeSyncMessage*>(header + 1);
+  switch (msg->type) {
+    case MessageType::SYNC:
+      if (detail::OnSync(packet->source_ip, packet->source_port, msg->sequence)) {
+        // The new host may not understand chained datagrams, it enables coalescing again by sending one
+        packet_chaining::SetTxCoalescing(false);
+      }
+      msg->type = MessageType::DELAY_REQ;
+      msg->t2 = timebase::TicksToNanos(packet->rx_ticks);
+      // Stamp as late as possible, everything until sendto() is counted as path delay
+      msg->t3 = timebase::TicksToNanos(timebase::NowTicks());
+      break;
+    case MessageType::DELAY_RESP: {
+      detail::AddSample(msg->t1, msg->t2, msg->t3, msg->t4);
+      const Estimate estimate = GetEstimate();
+      msg->type = MessageType::STATUS;
+      msg->offset_ns = estimate.valid ? estimate.offset_ns : 0;
+      msg->drift_ppb = static_cast<int32_t>(estimate.drift_ppb);
+      msg->round_trip_ns = estimate.round_trip_ns;
+      break;
+    }
+    default:
+      // DELAY_REQ and STATUS only go to the host
+      packet::freePacket(packet);
+      return;
+  }
+  sock::transmitPacket(&udp_socket_, packet, packet->source_ip, packet->source_port);
+}
+
+/**
+ * Answers a diagnostics request in place with the IO and per-service counters or the service reports,
+ * see xbot/io_diagnostics.hpp. Takes ownership of the packet.
+ */
+static void handleDiagnostics(packet::PacketPtr packet, datatypes::XbotHeader* header) {
+  using namespace xbot::io_diagnostics;
+  static_assert(sizeof(datatypes::XbotHeader) + sizeof(IoCounters) + sizeof(packet_pool::PoolStats) +
+                        deadlines::ROLE_COUNT * sizeof(deadlines::DeadlineStats) <=
+                    sizeof(packet::Packet::buffer),
+                "Diagnostics don't fit a packet");
+  auto command = Command::COUNTERS;
+  if (header->payload_size >= 1) {
+    command = static_cast<Command>(*reinterpret_cast<uint8_t*>(header + 1));
+  }
+  // The answer is longer than the request
+  packet::packetMakeWritable(packet);
+  header = reinterpret_cast<datatypes::XbotHeader*>(packet->data);
+  auto* payload = reinterpret_cast<uint8_t*>(header + 1);
+  const uint8_t* end = packet->buffer + sizeof(packet->buffer);
+
+  if (command == Command::SERVICE_REPORTS) {
+    header->payload_size = ServiceReport::GetAll(payload, end - payload);
+    packet->used_data = sizeof(datatypes::XbotHeader) + header->payload_size;
+    sock::transmitPacket(&udp_socket_, packet, packet->source_ip, packet->source_port);
+    return;
+  }
+
+  const IoCounters io_counters = GetIoCounters();
+  memcpy(payload, &io_counters, sizeof(io_counters));
+  size_t payload_size = sizeof(io_counters);
+  const packet_pool::PoolStats pool_stats = packet_pool::GetPoolStats();
+  memcpy(payload + payload_size, &pool_stats, sizeof(pool_stats));
+  payload_size += sizeof(pool_stats);
+  for (size_t role = 0; role < deadlines::ROLE_COUNT; role++) {
+    const deadlines::DeadlineStats deadline_stats = deadlines::GetStats(static_cast<deadlines::Role>(role));
+    memcpy(payload + payload_size, &deadline_stats, sizeof(deadline_stats));
+    payload_size += sizeof(deadline_stats);
+  }
+  for (uint16_t id = 0; id < SERVICE_TABLE_SIZE; id++) {
+    ServiceCounters counters{};
+    if (!GetServiceCounters(id, &counters)) {
+      continue;
+    }
+    if (payload + payload_size + sizeof(counters) > end) {
+      break;
+    }
+    memcpy(payload + payload_size, &counters, sizeof(counters));
+    payload_size += sizeof(counters);
+  }
+  header->payload_size = payload_size;
+  packet->used_data = sizeof(datatypes::XbotHeader) + payload_size;
+  sock::transmitPacket(&udp_socket_, packet, packet->source_ip, packet->source_port);
+}
+
+/**
+ * Applies the subscriptions in the request and answers in place with the resulting table,
+ * see xbot/output_subscriptions.hpp. Takes ownership of the packet.
+ */
+static void handleSubscriptions(packet::PacketPtr packet, datatypes::XbotHeader* header) {
+  using namespace xbot::output_subscriptions;
+  static_assert(sizeof(datatypes::XbotHeader) + MAX_SUBSCRIPTIONS * sizeof(Subscription) <=
+                    sizeof(packet::Packet::buffer),
+                "Subscription table doesn't fit a packet");
+  if (header->payload_size % sizeof(Subscription) != 0) {
+    ULOG_ERROR("Subscription packet has the wrong size.");
+    packet::freePacket(packet);
+    return;
+  }
+  // The answer can be longer than the request
+  packet::packetMakeWritable(packet);
+  header = reinterpret_cast<datatypes::XbotHeader*>(packet->data);
+  auto* subscriptions = reinterpret_cast<Subscription*>(header + 1);
+  for (size_t i = 0; i < header->payload_size / sizeof(Subscription); i++) {
+    Subscription subscription{};
+    memcpy(&subscription, &subscriptions[i], sizeof(subscription));
+    if (subscription.policy > Policy::ON_CHANGE) {
+      ULOG_WARNING("Unknown subscription policy %d, ignoring service %d output %d",
+                   static_cast<int>(subscription.policy), subscription.service_id, subscription.output_id);
+      continue;
+    }
+    if (subscription.policy != Policy::DEFAULT &&
+        !OutputGate::Supports(subscription.service_id, subscription.output_id)) {
+      ULOG_WARNING("Service %d can't decimate output %d, ignoring the subscription", subscription.service_id,
+                   subscription.output_id);
+      continue;
+    }
+    if (!Subscribe(subscription)) {
+      ULOG_WARNING("Subscription table full, ignoring service %d output %d", subscription.service_id,
+                   subscription.output_id);
+    }
+  }
+  header->payload_size = GetSubscriptions(subscriptions, MAX_SUBSCRIPTIONS) * sizeof(Subscription);
+  packet->used_data = sizeof(datatypes::XbotHeader) + header->payload_size;
+  sock::transmitPacket(&udp_socket_, packet, packet->source_ip, packet->source_port);
+}
+
+/**
+ * Answers a trace request in place with the span statistics or the newest ring entries, see xbot/trace.hpp.
+ * Takes ownership of the packet.
+ */
+static void handleTrace(packet::PacketPtr packet, datatypes::XbotHeader* header) {
+  using namespace xbot::trace;
+  static_assert(sizeof(datatypes::XbotHeader) + SPAN_COUNT * sizeof(SpanSnapshot) <= sizeof(packet::Packet::buffer),
+                "Trace statistics don't fit a packet");
+  auto command = Command::STATISTICS;
+  if (header->payload_size >= 1) {
+    command = static_cast<Command>(*reinterpret_cast<uint8_t*>(header + 1));
+  }
+  // The answer is longer than the request
+  packet::packetMakeWritable(packet);
+  header = reinterpret_cast<datatypes::XbotHeader*>(packet->data);
+  auto* payload = reinterpret_cast<uint8_t*>(header + 1);
+  size_t payload_size = 0;
+  if (command == Command::RING) {
+    // Packed, so it can be written to the payload directly
+    const size_t max_count = (sizeof(packet->buffer) - sizeof(datatypes::XbotHeader)) / sizeof(RingEntry);
+    payload_size = GetRing(reinterpret_cast<RingEntry*>(payload), max_count) * sizeof(RingEntry);
+  } else {
+    for (size_t i = 0; i < SPAN_COUNT; i++) {
+      const SpanSnapshot snapshot = GetSnapshot(static_cast<Span>(i), command == Command::STATISTICS_RESET);
+      memcpy(payload + payload_size, &snapshot, sizeof(snapshot));
+      payload_size += sizeof(snapshot);
+    }
+  }
+  header->payload_size = payload_size;
+  packet->used_data = sizeof(datatypes::XbotHeader) + payload_size;
+  sock::transmitPacket(&udp_socket_, packet, packet->source_ip, packet->source_port);
+}
+
+/**
+ * Answers a system monitor request in place with the thread and schedule statistics, see xbot/system_monitor.hpp.
+ * Takes ownership of the packet.
+ */
+static void handleSystemMonitor(packet::PacketPtr packet, datatypes::XbotHeader* header) {
+  using namespace xbot::system_monitor;
+  const bool reset = header->payload_size >= 1 && *reinterpret_cast<uint8_t*>(header + 1) == 1;
+  // The answer is longer than the request
+  packet::packetMakeWritable(packet);
+  header = reinterpret_cast<datatypes::XbotHeader*>(packet->data);
+  auto* payload = reinterpret_cast<uint8_t*>(header + 1);
+  size_t space = sizeof(packet->buffer) - sizeof(datatypes::XbotHeader) - sizeof(Summary);
+
+  // Packed, so they can be written to the payload directly
+  Summary summary{};
+  auto* threads = reinterpret_cast<ThreadStats*>(payload + sizeof(Summary));
+  const size_t thread_count = GetThreads(threads, space / sizeof(ThreadStats), &summary);
+  space -= thread_count * sizeof(ThreadStats);
+  auto* schedules = reinterpret_cast<ScheduleStats*>(threads + thread_count);
+  const size_t schedule_count = ScheduleMonitor::GetAll(schedules, space / sizeof(ScheduleStats), reset);
+  summary.threads = static_cast<uint8_t>(thread_count);
+  summary.schedules = static_cast<uint8_t>(schedule_count);
+  memcpy(payload, &summary, sizeof(summary));
+
+  header->payload_size =
+      sizeof(Summary) + thread_count * sizeof(ThreadStats) + schedule_count * sizeof(ScheduleStats);
+  packet->used_data = sizeof(datatypes::XbotHeader) + header->payload_size;
+  sock::transmitPacket(&udp_socket_, packet, packet->source_ip, packet->source_port);
+}
+
+static void sendDatagram(packet::PacketPtr packet, uint32_t ip, uint16_t port, uint32_t packets) {
+  chSysLock();
+  io_diagnostics::IoCounters& counters = io_diagnostics::detail::MutableIoCounters();
+  counters.tx_packets += packets;
+  counters.tx_datagrams++;
+  chSysUnlock();
+  sock::transmitPacket(&udp_socket_, packet, ip, port);
+}
+
+static void flushTxFrame() {
+  chMtxLock(&txMutex_);
+  const packet::PacketPtr frame = txFrame_;
+  const uint32_t ip = txFrameIp_;
+  const uint16_t port = txFramePort_;
+  const uint32_t packets = txFramePackets_;
+  txFrame_ = nullptr;
+  chMtxUnlock(&txMutex_);
+  if (frame != nullptr) {
+    sendDatagram(frame, ip, port, packets);
+  }
+}
+
+void runTx(void* arg) {
+  (void)arg;
+  while (true) {
+    chSemWait(&txFrameStarted_);
+    chThdSleepMicroseconds(packet_chaining::TX_COALESCE_WINDOW_US);
+    flushTxFrame();
+  }
+}
+
+static ServiceIo* findService(uint16_t service_id) {
+  if (service_id < io_diagnostics::SERVICE_TABLE_SIZE) {
+    return serviceTable_[service_id];
+  }
+  for (ServiceIo* service = firstService_; service != nullptr; service = service->next_service_) {
+    if (service->service_id_ == service_id) {
+      return service;
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * Hands a single xbot packet to its service (or answers it, for the reserved ids).
+ * Takes ownership of the packet.
+ */
+static void dispatchPacket(packet::PacketPtr packet) {
+  const auto header = reinterpret_cast<datatypes::XbotHeader*>(packet->data);
+  if (header->service_id == time_sync::TIME_SYNC_SERVICE_ID) {
+    handleTimeSync(packet, header);
+    return;
+  }
+  if (header->service_id == io_diagnostics::DIAGNOSTICS_SERVICE_ID) {
+    handleDiagnostics(packet, header);
+    return;
+  }
+  if (header->service_id == output_subscriptions::SUBSCRIPTION_SERVICE_ID) {
+    handleSubscriptions(packet, header);
+    return;
+  }
+  if (header->service_id == trace::TRACE_SERVICE_ID) {
+    handleTrace(packet, header);
+    return;
+  }
+  if (header->service_id == system_monitor::SYSTEM_MONITOR_SERVICE_ID) {
+    handleSystemMonitor(packet, header);
+    return;
+  }
+  ServiceIo* service = findService(header->service_id);
+  io_diagnostics::ServiceCounters* counters = io_diagnostics::detail::MutableServiceCounters(header->service_id);
+  if (counters != nullptr) {
+    counters->received++;
+  }
+  if (service == nullptr || service->stopped) {
+    // service not running or not found
+    io_diagnostics::detail::MutableIoCounters().undeliverable++;
+    packet::freePacket(packet);
+    return;
+  }
+  packet_chaining::detail::OnServicePacket(packet->source_ip, packet->source_port);
+  const bool priority = io_priority::IsPriority(header->service_id);
+  if (!priority && header->service_id < io_diagnostics::SERVICE_TABLE_SIZE &&
+      !packet::packetChargeService(packet, header->service_id, io_priority::detail::GetQuota(header->service_id))) {
+    counters->dropped_quota++;
+    packet::freePacket(packet);
+    return;
+  }
+  if (priority) {
+    // Not limited, only charged for the latency measurement
+    packet::packetChargeService(packet, header->service_id, UINT8_MAX);
+  }
+  // Give packet to service, the queue reports its fill level to the counters
+  io_diagnostics::detail::SetDispatchCounters(counters);
+  io_priority::detail::SetDispatchingBulk(!priority);
+  service->ioInput(packet);
+  io_priority::detail::SetDispatchingBulk(false);
+  io_diagnostics::detail::SetDispatchCounters(nullptr);
+}
+
+/**
+ * Splits a datagram with several xbot packets and dispatches each of them in its own packet (sharing the pbuf).
+ * Takes ownership of the packet.
+ */
+static void dispatchChained(packet::PacketPtr packet) {
+  // Validate the whole chain first, so a corrupt datagram is dropped completely
+  size_t offset = 0;
+  while (offset < packet->used_data) {
+    if (packet->used_data - offset < sizeof(datatypes::XbotHeader)) {
+      break;
+    }
+    const auto header = reinterpret_cast<datatypes::XbotHeader*>(packet->data + offset);
+    const size_t size = sizeof(datatypes::XbotHeader) + header->payload_size;
+    if (size > packet->used_data - offset) {
+      break;
+    }
+    offset += size;
+  }
+  if (offset != packet->used_data) {
+    ULOG_ERROR("Packet header size does not match actual packet size.");
+    io_diagnostics::detail::MutableIoCounters().malformed++;
+    packet::freePacket(packet);
+    return;
+  }
+
+  io_diagnostics::detail::MutableIoCounters().chained++;
+  // The host understands chained datagrams
+  packet_chaining::detail::OnChainedDatagram(packet->source_ip, packet->source_port);
+
+  offset = 0;
+  while (offset < packet->used_data) {
+    const auto header = reinterpret_cast<datatypes::XbotHeader*>(packet->data + offset);
+    const size_t size = sizeof(datatypes::XbotHeader) + header->payload_size;
+    const packet::PacketPtr slice = packet::packetSlice(packet, offset, size);
+    if (slice == nullptr) {
+      ULOG_ERROR("No packet for a chained xbot packet.");
+      break;
+    }
+    dispatchPacket(slice);
+    offset += size;
+  }
+  packet::freePacket(packet);
+}
+
 void runIo(void* arg) {
   (void)arg;
+  io_diagnostics::detail::SetDispatchThread();
   while (true) {
     packet::PacketPtr packet = nullptr;
 
     if (sock::receivePacket(&udp_socket_, &packet)) {
+      io_diagnostics::detail::MutableIoCounters().received++;
       // Got a packet, check if valid and put it into the processing queue.
       void* buffer = nullptr;
       size_t used_data = 0;
@@ -47,34 +418,20 @@ void runIo(void* arg) {
       }
       if (used_data < sizeof(datatypes::XbotHeader)) {
         ULOG_ERROR("Packet too short to contain header.");
+        io_diagnostics::detail::MutableIoCounters().malformed++;
         packet::freePacket(packet);
         continue;
       }
 
       const auto header = static_cast<datatypes::XbotHeader*>(buffer);
-      // Check, if the header size is correct
-      if (used_data - sizeof(datatypes::XbotHeader) != header->payload_size) {
-        // TODO: In order to allow chaining of xBot packets in the future,
-        // this needs to be adapted. (scan and split packets)
-        ULOG_ERROR("Packet header size does not match actual packet size.");
-        packet::freePacket(packet);
-        continue;
-      }
-      bool packet_delivered = false;
-      for (ServiceIo* service = firstService_; service != nullptr; service = service->next_service_) {
-        if (service->service_id_ == header->service_id) {
-          if (!service->stopped) {
-            // Give packet to service
-            service->ioInput(packet);
-            packet_delivered = true;
-            break;
-          }
-        }
-      }
-      if (!packet_delivered) {
-        // service not running or not found
-        packet::freePacket(packet);
+      // The packet is gone after dispatching
+      const uint64_t rx_ticks = packet->rx_ticks;
+      if (used_data - sizeof(datatypes::XbotHeader) == header->payload_size) {
+        dispatchPacket(packet);
+      } else {
+        dispatchChained(packet);
       }
+      trace::Record(trace::Span::IO_RX_TO_DISPATCH, rx_ticks, timebase::NowTicks());
     }
   }
 }
@@ -85,15 +442,61 @@ bool Io::registerServiceIo(ServiceIo* service) {
     last_service = &(*last_service)->next_service_;
   }
   *last_service = service;
+  const uint16_t id = service->service_id_;
+  if (id < io_diagnostics::SERVICE_TABLE_SIZE && serviceTable_[id] == nullptr) {
+    serviceTable_[id] = service;
+    io_diagnostics::detail::RegisterService(id);
+  }
   return true;
 }
 
 bool Io::transmitPacket(packet::PacketPtr packet, uint32_t ip, uint16_t port) {
-  return sock::transmitPacket(&udp_socket_, packet, ip, port);
+  if (packet == nullptr) {
+    return false;
+  }
+  // Priority lane services (e.g. emergency) are never held back by the coalescing window
+  const auto* header = reinterpret_cast<const datatypes::XbotHeader*>(packet->data);
+  if (!packet_chaining::IsTxCoalescing() ||
+      (packet->used_data >= sizeof(datatypes::XbotHeader) && io_priority::IsPriority(header->service_id))) {
+    sendDatagram(packet, ip, port, 1);
+    return true;
+  }
+
+  chMtxLock(&txMutex_);
+  // A different destination or no more space: send the pending datagram first
+  packet::PacketPtr full_frame = nullptr;
+  const uint32_t full_frame_ip = txFrameIp_;
+  const uint16_t full_frame_port = txFramePort_;
+  const uint32_t full_frame_packets = txFramePackets_;
+  if (txFrame_ != nullptr && (txFrameIp_ != ip || txFramePort_ != port ||
+                              txFrame_->used_data + packet->used_data > config::max_packet_size)) {
+    full_frame = txFrame_;
+    txFrame_ = nullptr;
+  }
+  const bool started = txFrame_ == nullptr;
+  if (started) {
+    txFrame_ = packet;
+    txFrameIp_ = ip;
+    txFramePort_ = port;
+    txFramePackets_ = 1;
+  } else {
+    packet::packetAppendData(txFrame_, packet->data, packet->used_data);
+    txFramePackets_++;
+    packet::freePacket(packet);
+  }
+  chMtxUnlock(&txMutex_);
+
+  if (full_frame != nullptr) {
+    sendDatagram(full_frame, full_frame_ip, full_frame_port, full_frame_packets);
+  }
+  if (started) {
+    chSemSignal(&txFrameStarted_);
+  }
+  return true;
 }
 
 bool Io::transmitPacket(packet::PacketPtr packet, const char* ip, uint16_t port) {
-  return sock::transmitPacket(&udp_socket_, packet, ip, port);
+  return transmitPacket(packet, ntohl(inet_addr(ip)), port);
 }
 
 bool Io::getEndpoint(char* ip, size_t ip_len, uint16_t* port) {
@@ -105,7 +508,20 @@ bool Io::start(const char* bind_ip) {
   if (!sock::initialize(&udp_socket_, false)) {
     return false;
   }
-  return thread::initialize(&io_thread_, runIo, nullptr, &waIoThread, sizeof(waIoThread), IO_THD_NAME);
+  if (!thread::initializeWithPriority(&tx_thread_, runTx, nullptr, &waTxThread, sizeof(waTxThread), TX_THD_NAME,
+                                     THD_PRIO_NETWORK)) {
+    return false;
+  }
+  return thread::initializeWithPriority(&io_thread_, runIo, nullptr, &waIoThread, sizeof(waIoThread), IO_THD_NAME,
+                                        THD_PRIO_NETWORK);
 }
 
 }  // namespace xbot::service
+
+namespace xbot::packet_chaining {
+
+void detail::FlushTxFrame() {
+  service::flushTxFrame();
+}
+
+}  // namespace xbot::packet_chaining
@@ -0,0 +1,145 @@
+//
+// Thread roles with their priority and deadline, see cfg/thread_priorities.h.
+//
+// Response times (trace spans, schedule lateness) are checked against the deadline of their role. The number of
+// checks and misses per role is appended to the diagnostics answer, see xbot/io_diagnostics.hpp.
+//
+// Service threads are created by the framework through xbot::service::thread::initialize(), with the service as
+// the thread argument. AssignThread() tells it the role of such a thread, other threads pass their priority to
+// chThdCreateStatic() or thread::initializeWithPriority() directly.
+//
+
+#ifndef DEADLINES_HPP
+#define DEADLINES_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "ch.h"
+#include "thread_priorities.h"
+
+namespace xbot::deadlines {
+
+enum class Role : uint8_t {
+  SAFETY,
+  MOTOR_CONTROL,
+  NETWORK,
+  IMU,
+  GPS,
+  POWER,
+  UI,
+  DEBUG,
+  COUNT
+};
+
+constexpr size_t ROLE_COUNT = static_cast<size_t>(Role::COUNT);
+constexpr tprio_t PRIORITIES[ROLE_COUNT] = {
+    THD_PRIO_SAFETY, THD_PRIO_MOTOR_CONTROL, THD_PRIO_NETWORK, THD_PRIO_IMU,
+    THD_PRIO_GPS,    THD_PRIO_POWER,         THD_PRIO_UI,      THD_PRIO_DEBUG,
+};
+constexpr uint32_t DEADLINES_US[ROLE_COUNT] = {
+    THD_DEADLINE_US_SAFETY, THD_DEADLINE_US_MOTOR_CONTROL, THD_DEADLINE_US_NETWORK, THD_DEADLINE_US_IMU,
+    THD_DEADLINE_US_GPS,    THD_DEADLINE_US_POWER,         THD_DEADLINE_US_UI,      THD_DEADLINE_US_DEBUG,
+};
+
+// Service threads which can be assigned a role
+constexpr size_t MAX_ASSIGNED_THREADS = 16;
+
+constexpr tprio_t PriorityOf(Role role) {
+  return PRIORITIES[static_cast<size_t>(role)];
+}
+
+constexpr uint32_t DeadlineUsOf(Role role) {
+  return DEADLINES_US[static_cast<size_t>(role)];
+}
+
+#pragma pack(push, 1)
+struct DeadlineStats {
+  uint8_t role;
+  uint8_t priority;
+  uint16_t reserved;
+  uint32_t deadline_us;
+  uint32_t checks;
+  uint32_t misses;
+  uint32_t worst_us;
+};
+#pragma pack(pop)
+
+namespace detail {
+struct RoleCounters {
+  std::atomic<uint32_t> checks{0};
+  std::atomic<uint32_t> misses{0};
+  std::atomic<uint32_t> worst_us{0};
+};
+
+inline RoleCounters counters[ROLE_COUNT]{};
+
+struct AssignedThread {
+  const void* owner;
+  Role role;
+};
+
+// Written before the threads are created
+inline AssignedThread assigned[MAX_ASSIGNED_THREADS]{};
+inline size_t assigned_count = 0;
+}  // namespace detail
+
+/**
+ * Checks a response time against the deadline of the role. Lock free, callable from ISRs.
+ */
+inline void Check(Role role, uint32_t response_us) {
+  detail::RoleCounters& counters = detail::counters[static_cast<size_t>(role)];
+  counters.checks.fetch_add(1, std::memory_order_relaxed);
+  if (response_us > DeadlineUsOf(role)) {
+    counters.misses.fetch_add(1, std::memory_order_relaxed);
+  }
+  uint32_t worst = counters.worst_us.load(std::memory_order_relaxed);
+  while (response_us > worst &&
+         !counters.worst_us.compare_exchange_weak(worst, response_us, std::memory_order_relaxed)) {
+  }
+}
+
+inline DeadlineStats GetStats(Role role) {
+  const detail::RoleCounters& counters = detail::counters[static_cast<size_t>(role)];
+  DeadlineStats stats{};
+  stats.role = static_cast<uint8_t>(role);
+  stats.priority = static_cast<uint8_t>(PriorityOf(role));
+  stats.deadline_us = DeadlineUsOf(role);
+  stats.checks = counters.checks.load(std::memory_order_relaxed);
+  stats.misses = counters.misses.load(std::memory_order_relaxed);
+  stats.worst_us = counters.worst_us.load(std::memory_order_relaxed);
+  return stats;
+}
+
+/**
+ * Assigns a role to the thread which will be created with owner as its argument.
+ * Call before the thread is created (e.g. before starting the service).
+ */
+inline bool AssignThread(const void* owner, Role role) {
+  for (size_t i = 0; i < detail::assigned_count; i++) {
+    if (detail::assigned[i].owner == owner) {
+      detail::assigned[i].role = role;
+      return true;
+    }
+  }
+  if (detail::assigned_count == MAX_ASSIGNED_THREADS) {
+    return false;
+  }
+  detail::assigned[detail::assigned_count++] = {owner, role};
+  return true;
+}
+
+inline bool FindAssignedThread(const void* owner, Role* role) {
+  for (size_t i = 0; i < detail::assigned_count; i++) {
+    if (detail::assigned[i].owner == owner) {
+      *role = detail::assigned[i].role;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace xbot::deadlines
+
+#endif  // DEADLINES_HPP
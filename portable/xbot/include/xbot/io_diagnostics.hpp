@@ -0,0 +1,169 @@
+//
+// Packet dispatch counters of the xbot IO thread.
+//
+// A packet to DIAGNOSTICS_SERVICE_ID is answered by the IO thread. The first payload byte is a Command
+// (an empty payload means COUNTERS):
+//   COUNTERS         header, IoCounters, the packet pool statistics (xbot/packet_pool.hpp), one DeadlineStats
+//                    entry per thread role (xbot/deadlines.hpp) and one ServiceCounters entry per registered
+//                    service.
+//   SERVICE_REPORTS  header, then a ReportHeader followed by its data for every published ServiceReport.
+//
+
+#ifndef IO_DIAGNOSTICS_HPP
+#define IO_DIAGNOSTICS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "ch.h"
+
+namespace xbot::io_diagnostics {
+
+// Reserved service id for diagnostics requests
+constexpr uint16_t DIAGNOSTICS_SERVICE_ID = 0xFFFD;
+
+// Services with smaller ids are looked up in a table and have counters, others are found by walking the list
+constexpr uint16_t SERVICE_TABLE_SIZE = 64;
+
+enum class Command : uint8_t {
+  COUNTERS = 0,
+  SERVICE_REPORTS = 1,
+};
+
+#pragma pack(push, 1)
+struct IoCounters {
+  uint32_t received;
+  // Too short or size mismatch
+  uint32_t malformed;
+  // No such service, or the service is stopped
+  uint32_t undeliverable;
+  // Datagrams with more than one xbot packet
+  uint32_t chained;
+  // Sent xbot packets and the datagrams they were sent in (less with coalescing)
+  uint32_t tx_packets;
+  uint32_t tx_datagrams;
+  // Receive until the service freed the packet, per lane (see xbot/io_priority.hpp)
+  uint32_t priority_latency_last_us;
+  uint32_t priority_latency_max_us;
+  uint32_t bulk_latency_max_us;
+};
+
+struct ServiceCounters {
+  uint16_t service_id;
+  // Max. number of packets waiting in the service queue
+  uint16_t queue_high_water;
+  uint32_t received;
+  uint32_t delivered;
+  // The queue was still full after waiting for it
+  uint32_t dropped_queue_full;
+  // The queue was full and the IO thread had to wait (or dropped the packet, for bulk services)
+  uint32_t queue_blocked;
+  // The service already held its quota of pool packets
+  uint32_t dropped_quota;
+};
+
+struct ReportHeader {
+  uint16_t service_id;
+  // Defined by the service, in case it has several reports
+  uint8_t type;
+  // Bytes of data following the header
+  uint8_t size;
+};
+#pragma pack(pop)
+
+IoCounters GetIoCounters();
+
+/**
+ * @return false if the service id is not registered or has no counters (id >= SERVICE_TABLE_SIZE)
+ */
+bool GetServiceCounters(uint16_t service_id, ServiceCounters* counters);
+
+/**
+ * Diagnostics of a service which have no output in its definition (e.g. the GpsService RTCM statistics).
+ * The service publishes a snapshot whenever it has new values, the IO thread serves the latest snapshot of
+ * every report. Registers itself on construction.
+ */
+class ServiceReport {
+ public:
+  static constexpr size_t MAX_SIZE = 128;
+
+  ServiceReport(uint16_t service_id, uint8_t type) : service_id_(service_id), type_(type) {
+    // Lock free, reports are constructed with their services before the kernel runs
+    next_ = first_.load();
+    while (!first_.compare_exchange_weak(next_, this)) {
+    }
+  }
+
+  ServiceReport(const ServiceReport&) = delete;
+  ServiceReport& operator=(const ServiceReport&) = delete;
+
+  // Data beyond MAX_SIZE is cut off
+  void Publish(const void* data, size_t size) {
+    if (size > MAX_SIZE) {
+      size = MAX_SIZE;
+    }
+    chSysLock();
+    memcpy(data_, data, size);
+    size_ = static_cast<uint8_t>(size);
+    chSysUnlock();
+  }
+
+  /**
+   * Writes a ReportHeader and the data of every published report.
+   * @return The number of bytes written, reports which don't fit are left out
+   */
+  static size_t GetAll(uint8_t* buffer, size_t max_size) {
+    size_t used = 0;
+    for (ServiceReport* report = first_.load(); report != nullptr; report = report->next_) {
+      chSysLock();
+      const ReportHeader header{report->service_id_, report->type_, report->size_};
+      const bool fits = header.size > 0 && used + sizeof(header) + header.size <= max_size;
+      if (fits) {
+        memcpy(buffer + used, &header, sizeof(header));
+        memcpy(buffer + used + sizeof(header), report->data_, header.size);
+        used += sizeof(header) + header.size;
+      }
+      chSysUnlock();
+    }
+    return used;
+  }
+
+ private:
+  inline static std::atomic<ServiceReport*> first_{nullptr};
+  ServiceReport* next_ = nullptr;
+
+  uint16_t service_id_;
+  uint8_t type_;
+  // Nothing is served until the first Publish()
+  uint8_t size_ = 0;
+  uint8_t data_[MAX_SIZE]{};
+};
+
+namespace detail {
+/**
+ * Called by the queue port after posting a packet. Only counted while the IO thread delivers a packet,
+ * other queue users are ignored.
+ * @param blocked The queue was full at first
+ * @param posted The packet is in the queue
+ * @param fill Packets in the queue afterwards
+ */
+void OnQueuePush(bool blocked, bool posted, size_t fill);
+
+// Written by the IO thread without locking, by other threads with the system locked
+IoCounters& MutableIoCounters();
+// nullptr for ids >= SERVICE_TABLE_SIZE
+ServiceCounters* MutableServiceCounters(uint16_t service_id);
+void RegisterService(uint16_t service_id);
+
+// Called once by the IO thread
+void SetDispatchThread();
+bool IsDispatchThread();
+// Counters of the service which the IO thread is giving a packet to, nullptr afterwards
+void SetDispatchCounters(ServiceCounters* counters);
+}  // namespace detail
+
+}  // namespace xbot::io_diagnostics
+
+#endif  // IO_DIAGNOSTICS_HPP
@@ -0,0 +1,44 @@
+//
+// Priority lane and packet pool quotas for received xbot packets.
+//
+// Datagrams for priority services (e.g. emergency, twist) are queued in a separate lane which the
+// IO thread drains first, and the last RESERVED_PACKETS packets of the pool are only handed out to
+// them. Every other service may hold at most its quota of received packets, and the IO thread
+// doesn't wait for their queues, so a burst of bulk data (RTCM, config blobs) can't delay the
+// priority lane.
+//
+// Latency is measured per lane from the receive callback until the service freed the packet.
+//
+
+#ifndef IO_PRIORITY_HPP
+#define IO_PRIORITY_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace xbot::io_priority {
+
+constexpr size_t RESERVED_PACKETS = 4;
+constexpr uint8_t DEFAULT_QUOTA = 8;
+
+// Only for ids below io_diagnostics::SERVICE_TABLE_SIZE, call before the services are started
+void SetPriority(uint16_t service_id, bool priority);
+void SetQuota(uint16_t service_id, uint8_t max_packets);
+
+bool IsPriority(uint16_t service_id);
+
+namespace detail {
+// True if any xbot packet in the datagram is for a priority service
+bool IsPriorityDatagram(const uint8_t* data, size_t size);
+// False while the IO thread delivers to a bulk service, its queue is not waited for
+bool QueueMayWait();
+void OnPacketDone(bool priority, uint64_t latency_ticks);
+// DEFAULT_QUOTA unless set, service_id must be below io_diagnostics::SERVICE_TABLE_SIZE
+uint8_t GetQuota(uint16_t service_id);
+// Set by the IO thread while it delivers to a bulk service
+void SetDispatchingBulk(bool bulk);
+}  // namespace detail
+
+}  // namespace xbot::io_priority
+
+#endif  // IO_PRIORITY_HPP
@@ -0,0 +1,133 @@
+//
+// Output rates requested by the host.
+//
+// Without a subscription, a service sends an output whenever its schedule produces it. The host can
+// subscribe to single outputs (or to all outputs of a service) with a period, an on-change policy or
+// switch them off, by sending Subscription entries to SUBSCRIPTION_SERVICE_ID. The IO thread answers
+// every request with the complete subscription table, so an empty request just reads it.
+//
+// Services decimate their outputs with an OutputGate. Outputs which are always sent together share a
+// gate for ALL_OUTPUTS and follow the service wide subscription. Subscriptions to outputs without a
+// gate (and unknown policies) are rejected, so the table the host gets back is what the services honor.
+// A period shorter than the service's schedule is capped by it, services which can produce faster
+// (e.g. the IMU) adapt to GetPeriodUs(). Outputs sent in the same transaction and outputs of several
+// services are batched into one datagram by the TX coalescing (xbot/packet_chaining.hpp).
+//
+
+#ifndef OUTPUT_SUBSCRIPTIONS_HPP
+#define OUTPUT_SUBSCRIPTIONS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace xbot::output_subscriptions {
+
+// Reserved service id for subscription requests
+constexpr uint16_t SUBSCRIPTION_SERVICE_ID = 0xFFFC;
+
+// Subscribes to all outputs of a service, a subscription to a single output takes precedence
+constexpr uint16_t ALL_OUTPUTS = 0xFFFF;
+
+constexpr size_t MAX_SUBSCRIPTIONS = 32;
+
+enum class Policy : uint8_t {
+  // Removes the subscription, the service sends at its own rate again
+  DEFAULT = 0,
+  OFF = 1,
+  // At most once per period
+  PERIODIC = 2,
+  // Only when the value changed, at most once per period
+  ON_CHANGE = 3,
+};
+
+#pragma pack(push, 1)
+struct Subscription {
+  uint16_t service_id;
+  uint16_t output_id;
+  Policy policy;
+  uint8_t reserved[3];
+  uint32_t period_us;
+};
+#pragma pack(pop)
+
+/**
+ * Applies a subscription, replacing an existing one for the same output.
+ * @return false if the table is full
+ */
+bool Subscribe(const Subscription& subscription);
+
+/**
+ * @return The policy for the output, DEFAULT if there is no subscription. period_us is set to its period.
+ */
+Policy GetPolicy(uint16_t service_id, uint16_t output_id, uint32_t* period_us);
+
+/**
+ * Shortest period subscribed for the output, falls back to the service wide subscription.
+ * @return 0 if there is no subscription with a period
+ */
+uint32_t GetPeriodUs(uint16_t service_id, uint16_t output_id);
+
+/**
+ * Incremented on every change of the table, so services can cheaply check whether to reconfigure.
+ */
+uint32_t GetGeneration();
+
+/**
+ * Copies the table into subscriptions.
+ * @return The number of entries
+ */
+size_t GetSubscriptions(Subscription* subscriptions, size_t max_count);
+
+/**
+ * Decides whether a service sends an output now. One gate per output (or group of outputs sent together),
+ * only used by the service thread. Registers itself on construction, so subscriptions can be checked.
+ */
+class OutputGate {
+ public:
+  OutputGate(uint16_t service_id, uint16_t output_id) : service_id_(service_id), output_id_(output_id) {
+    // Lock free, gates are constructed with their services before the kernel runs
+    next_ = first_.load();
+    while (!first_.compare_exchange_weak(next_, this)) {
+    }
+  }
+
+  OutputGate(const OutputGate&) = delete;
+  OutputGate& operator=(const OutputGate&) = delete;
+
+  /**
+   * @param changed For on-change subscriptions: the value differs from the last one sent
+   * @return true if the output should be sent, the gate then counts it as sent
+   */
+  bool Due(uint64_t now_ticks, bool changed = true);
+
+  uint16_t GetOutputId() const {
+    return output_id_;
+  }
+
+  /**
+   * @return true if a gate honors a subscription to the output. A service wide subscription needs any gate
+   * of the service, a single output needs its own gate.
+   */
+  static bool Supports(uint16_t service_id, uint16_t output_id) {
+    for (const OutputGate* gate = first_.load(); gate != nullptr; gate = gate->next_) {
+      if (gate->service_id_ == service_id && (output_id == ALL_OUTPUTS || gate->output_id_ == output_id)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  inline static std::atomic<OutputGate*> first_{nullptr};
+  OutputGate* next_ = nullptr;
+
+  uint16_t service_id_;
+  uint16_t output_id_;
+  bool sent_ = false;
+  uint64_t last_sent_ticks_ = 0;
+};
+
+}  // namespace xbot::output_subscriptions
+
+#endif  // OUTPUT_SUBSCRIPTIONS_HPP
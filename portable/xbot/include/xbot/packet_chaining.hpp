@@ -0,0 +1,37 @@
+//
+// Several xbot packets (header + payload, back to back) in one UDP datagram.
+//
+// Receiving: the IO thread splits chained datagrams and hands each packet to its service.
+// Sending: with coalescing enabled, Io::transmitPacket() collects packets to the same destination
+// for up to TX_COALESCE_WINDOW_US (or until the datagram is full) and sends them as one datagram.
+// Packets of priority services (xbot/io_priority.hpp) are always sent right away.
+// Coalescing is enabled automatically once the host sent a chained datagram itself, since a host
+// which doesn't know about chaining would reject them. It's disabled again when a new host session
+// starts: a packet for a service arrives from another endpoint, or the time sync (xbot/time_sync.hpp)
+// restarts. The new host enables it again with its first chained datagram.
+//
+
+#ifndef PACKET_CHAINING_HPP
+#define PACKET_CHAINING_HPP
+
+#include <cstdint>
+
+namespace xbot::packet_chaining {
+
+// Max. time a packet waits for others, about one scheduler slot of the services
+constexpr uint32_t TX_COALESCE_WINDOW_US = 500;
+
+void SetTxCoalescing(bool enabled);
+bool IsTxCoalescing();
+
+namespace detail {
+// Implemented by the IO, sends the datagram which is being filled right away
+void FlushTxFrame();
+// Called by the IO thread for every chained datagram and for every packet delivered to a service
+void OnChainedDatagram(uint32_t ip, uint16_t port);
+void OnServicePacket(uint32_t ip, uint16_t port);
+}  // namespace detail
+
+}  // namespace xbot::packet_chaining
+
+#endif  // PACKET_CHAINING_HPP
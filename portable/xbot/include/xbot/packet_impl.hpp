@@ -7,15 +7,86 @@
 
 #include <lwip/memp.h>
 
+#include <cstdint>
 #include <xbot/config.hpp>
 
+#ifndef HOSTSIM
+#include <lwip/pbuf.h>
+#endif
+
 LWIP_MEMPOOL_PROTOTYPE(xbot_packet_pool);
 
 namespace xbot::service::packet {
+
+// Room for the Ethernet, IP and UDP headers in front of the buffer, so lwIP can prepend them in place
+constexpr size_t TX_HEADROOM = 64;
+
+constexpr uint16_t NO_SERVICE = 0xFFFF;
+
+// Received pbufs which packets may hold at the same time. They come from the MAC's receive pool
+// (PBUF_POOL_SIZE), which must keep enough buffers for ARP and priority traffic. Beyond this, received data is copied.
+constexpr size_t MAX_HELD_RX_PBUFS = 4;
+
 struct Packet {
   size_t used_data;
+  // Points to buffer, or for received packets into the pbuf which holds the data (no copy)
+  uint8_t* data;
+  struct pbuf* rx_pbuf;
+  // Set by receivePacket(): sender (host byte order) and xbot::timebase ticks when the datagram arrived
+  uint32_t source_ip;
+  uint16_t source_port;
+  uint64_t rx_ticks;
+  // Received on the priority lane
+  bool priority;
+  // Service whose quota this packet is charged to, see packetChargeService()
+  uint16_t owner_service;
+  // Allocating thread, index into the pool statistics
+  uint8_t pool_owner;
+#ifndef HOSTSIM
+  // Wraps headroom + buffer while lwIP sends the packet, frees the packet when lwIP is done with it.
+  // Must be placed before the headroom (lwIP checks that headers don't overlap the pbuf struct).
+  struct pbuf_custom tx_pbuf;
+#endif
+  alignas(4) uint8_t headroom[TX_HEADROOM];
   uint8_t buffer[xbot::config::max_packet_size];
 };
+
+/**
+ * Like allocatePacket(), with a custom timeout.
+ * @return nullptr if no packet became free in time
+ */
+Packet* allocatePacketTimeout(uint32_t timeout_ms);
+
+/**
+ * Like allocatePacket(), but returns nullptr instead of waiting if the pool is empty.
+ * Only priority packets may take the last xbot::io_priority::RESERVED_PACKETS packets.
+ */
+Packet* tryAllocatePacket(bool priority);
+
+/**
+ * Charges the packet to the service until it is freed.
+ * @return false if the service already holds quota packets
+ */
+bool packetChargeService(Packet* packet, uint16_t service_id, uint8_t quota);
+
+/**
+ * Hands a received pbuf to the packet without copying (freePacket() releases it),
+ * unless MAX_HELD_RX_PBUFS are already held.
+ * @return false if the caller has to copy the data
+ */
+bool packetHoldRxPbuf(Packet* packet, struct pbuf* p);
+
+/**
+ * Makes sure the packet owns its data (copies it out of the received pbuf), so it can be modified or extended.
+ */
+void packetMakeWritable(Packet* packet);
+
+/**
+ * Allocates a packet with size bytes of another packet's data, starting at offset.
+ * Received packets share their pbuf instead of copying.
+ */
+Packet* packetSlice(const Packet* packet, size_t offset, size_t size);
+
 }  // namespace xbot::service::packet
 
 #define XBOT_PACKET_TYPEDEF Packet
@@ -0,0 +1,53 @@
+//
+// Statistics of the xbot packet pool, reported with the IO diagnostics.
+//
+// allocatePacket() waits at most ALLOC_TIMEOUT_MS for a free packet and returns nullptr after that,
+// so a leak or a burst shows up as failed allocations instead of a frozen thread.
+//
+
+#ifndef PACKET_POOL_HPP
+#define PACKET_POOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace xbot::packet_pool {
+
+constexpr size_t POOL_SIZE = 25;
+constexpr uint32_t ALLOC_TIMEOUT_MS = 100;
+
+// Threads which allocate packets, further threads share the last entry
+constexpr size_t MAX_OWNERS = 8;
+
+// Wait time histogram: no wait, <= 100 us, <= 1 ms, <= 10 ms, longer, no packet at all
+constexpr size_t WAIT_BUCKETS = 6;
+constexpr uint32_t WAIT_BUCKET_LIMITS_US[] = {0, 100, 1'000, 10'000};
+
+#pragma pack(push, 1)
+struct OwnerStats {
+  char name[12];
+  uint16_t outstanding;
+  uint16_t max_outstanding;
+};
+
+struct PoolStats {
+  uint16_t size;
+  uint16_t in_use;
+  uint16_t high_water;
+  // Packets only handed out to the priority lane, see xbot/io_priority.hpp
+  uint16_t priority_reserve;
+  uint32_t allocations;
+  // A packet was requested while none (or only the priority reserve) was free
+  uint32_t exhausted;
+  // Requests which got no packet (timeout, or empty pool for try-allocations)
+  uint32_t failed;
+  uint32_t wait_histogram[WAIT_BUCKETS];
+  OwnerStats owners[MAX_OWNERS];
+};
+#pragma pack(pop)
+
+PoolStats GetPoolStats();
+
+}  // namespace xbot::packet_pool
+
+#endif  // PACKET_POOL_HPP
@@ -0,0 +1,55 @@
+//
+// Capture times of the samples in service outputs, in host time.
+//
+// The service definitions have no field for the time a sample was captured (xbot::timebase ticks, taken in
+// ISR context). Right after sending an output with a sample, a service calls Send() with its capture time. A
+// Stamp then goes to SAMPLE_STAMP_SERVICE_ID at the host which runs the time sync (xbot/time_sync.hpp),
+// converted into the host clock. With TX coalescing it shares the datagram with the output, the host pairs
+// it with the last output of that service. Nothing is sent before the host started the time sync.
+//
+
+#ifndef SAMPLE_STAMPS_HPP
+#define SAMPLE_STAMPS_HPP
+
+#include <cstdint>
+
+namespace xbot::sample_stamps {
+
+// Reserved service id for the stamps sent to the host
+constexpr uint16_t SAMPLE_STAMP_SERVICE_ID = 0xFFF9;
+
+enum class Source : uint8_t {
+  // ImuService Axes, center of the averaging window
+  IMU_AXES,
+  // DiffDriveService wheel ticks and actual twist, status frame of the left / right ESC
+  LEFT_ESC,
+  RIGHT_ESC,
+  // MowerService ESC status
+  MOWER_ESC,
+  // GpsService fix, end of the burst which completed the solution
+  GPS_FIX,
+  COUNT
+};
+
+#pragma pack(push, 1)
+struct Stamp {
+  uint16_t service_id;
+  Source source;
+  // host_ns is valid, the time sync has an estimate
+  uint8_t valid;
+  // Counts the stamps sent for this source, gaps show lost stamps
+  uint32_t sequence;
+  uint64_t board_ns;
+  uint64_t host_ns;
+};
+#pragma pack(pop)
+
+/**
+ * Sends the capture time of a sample which the service just sent in an output. Doesn't wait for a packet.
+ * @return false if no host runs the time sync or no packet was free
+ */
+bool Send(uint16_t service_id, Source source, uint64_t capture_ticks);
+
+}  // namespace xbot::sample_stamps
+
+#endif  // SAMPLE_STAMPS_HPP
@@ -5,6 +5,38 @@
 #ifndef SOCKET_IMPL_HPP
 #define SOCKET_IMPL_HPP
 
+#ifdef HOSTSIM
 #define XBOT_SOCKET_TYPEDEF int
+#else
+#include <ch.h>
+
+#include <cstdint>
+
+struct udp_pcb;
+
+namespace xbot::service::sock {
+
+constexpr size_t RX_QUEUE_LENGTH = 8;
+constexpr size_t RX_PRIORITY_QUEUE_LENGTH = 4;
+
+// UDP socket on the lwIP raw API, received pbufs are handed out without copying
+struct UdpSocket {
+  struct udp_pcb* pcb;
+  // Received packets, posted from the lwIP receive callback. Priority datagrams (see xbot/io_priority.hpp)
+  // go to their own queue, which is fetched first.
+  mailbox_t rx_mailbox;
+  msg_t rx_mailbox_buffer[RX_QUEUE_LENGTH];
+  mailbox_t rx_priority_mailbox;
+  msg_t rx_priority_mailbox_buffer[RX_PRIORITY_QUEUE_LENGTH];
+  // Packets in both queues
+  semaphore_t rx_available;
+  // Datagrams dropped because the packet pool or the queue was full
+  uint32_t rx_dropped;
+};
+
+}  // namespace xbot::service::sock
+
+#define XBOT_SOCKET_TYPEDEF xbot::service::sock::UdpSocket
+#endif
 
 #endif  // SOCKET_IMPL_HPP
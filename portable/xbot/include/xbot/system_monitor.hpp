@@ -0,0 +1,191 @@
+//
+// Per-thread CPU load and service schedule jitter.
+//
+// The firmware samples the run time of every thread (accounted in the context switch hook, see cfg/chconf.h)
+// and publishes the result here once per sample interval. Every MonitoredSchedule (services/service_ext.hpp)
+// measures its actual tick interval against the planned one with a ScheduleMonitor.
+//
+// The IO thread answers requests on SYSTEM_MONITOR_SERVICE_ID with a Summary, followed by a ThreadStats per
+// thread and a ScheduleStats per schedule (as many as fit the packet). If the first payload byte is 1, the
+// schedule statistics are reset after answering.
+//
+
+#ifndef SYSTEM_MONITOR_HPP
+#define SYSTEM_MONITOR_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <xbot/timebase.hpp>
+
+#include "ch.h"
+
+namespace xbot::system_monitor {
+
+// Reserved service id for system monitor requests
+constexpr uint16_t SYSTEM_MONITOR_SERVICE_ID = 0xFFFA;
+
+constexpr size_t MAX_THREADS = 24;
+
+#pragma pack(push, 1)
+struct Summary {
+  uint32_t sample_interval_ms;
+  uint32_t samples;
+  // All threads except idle, in 1/1000
+  uint16_t cpu_load_permille;
+  uint8_t threads;
+  uint8_t schedules;
+};
+
+struct ThreadStats {
+  char name[16];
+  uint8_t priority;
+  uint8_t reserved;
+  // Share of the run time in the last sample interval, in 1/1000
+  uint16_t cpu_permille;
+  // Times the thread was switched in during the last sample interval
+  uint32_t switches;
+  // Longest time it ran without being switched out during the last sample interval
+  uint32_t max_slice_us;
+  uint32_t stack_size;
+  // Stack high-water mark
+  uint32_t stack_used;
+};
+
+struct ScheduleStats {
+  uint16_t service_id;
+  uint16_t reserved;
+  uint32_t period_us;
+  uint32_t ticks;
+  // Actual minus planned interval between two ticks
+  int32_t last_jitter_us;
+  int32_t min_jitter_us;
+  int32_t max_jitter_us;
+  uint32_t avg_abs_jitter_us;
+};
+#pragma pack(pop)
+
+namespace detail {
+// Only accessed with the system locked
+inline Summary summary{};
+inline ThreadStats threads[MAX_THREADS]{};
+}  // namespace detail
+
+/**
+ * Replaces the thread statistics with the ones of the latest sample interval.
+ */
+inline void PublishThreads(const ThreadStats* threads, size_t count, uint32_t sample_interval_ms,
+                           uint16_t cpu_load_permille) {
+  if (count > MAX_THREADS) {
+    count = MAX_THREADS;
+  }
+  chSysLock();
+  memcpy(detail::threads, threads, count * sizeof(ThreadStats));
+  detail::summary.sample_interval_ms = sample_interval_ms;
+  detail::summary.samples++;
+  detail::summary.cpu_load_permille = cpu_load_permille;
+  detail::summary.threads = static_cast<uint8_t>(count);
+  chSysUnlock();
+}
+
+/**
+ * @return The number of threads copied
+ */
+inline size_t GetThreads(ThreadStats* threads, size_t max_count, Summary* summary) {
+  chSysLock();
+  *summary = detail::summary;
+  const size_t count = detail::summary.threads < max_count ? detail::summary.threads : max_count;
+  memcpy(threads, detail::threads, count * sizeof(ThreadStats));
+  chSysUnlock();
+  return count;
+}
+
+/**
+ * Measures the jitter of a periodic callback. Registers itself on construction, Tick() is called by the
+ * callback's thread.
+ */
+class ScheduleMonitor {
+ public:
+  explicit ScheduleMonitor(uint32_t period_us) : period_us_(period_us) {
+    // Lock free, schedules are also constructed before the kernel runs
+    next_ = first_.load();
+    while (!first_.compare_exchange_weak(next_, this)) {
+    }
+  }
+
+  ScheduleMonitor(const ScheduleMonitor&) = delete;
+  ScheduleMonitor& operator=(const ScheduleMonitor&) = delete;
+
+  /**
+   * @return The jitter of this tick in us, 0 for the first one
+   */
+  int32_t Tick(uint16_t service_id) {
+    const uint64_t now = timebase::NowTicks();
+    int32_t jitter_us = 0;
+    chSysLock();
+    service_id_ = service_id;
+    if (last_ticks_ != 0) {
+      const auto interval_us = static_cast<int64_t>(timebase::TicksToMicros(now - last_ticks_));
+      const int64_t jitter = interval_us - static_cast<int64_t>(period_us_);
+      jitter_us = static_cast<int32_t>(jitter > INT32_MAX ? INT32_MAX : jitter);
+      if (ticks_ == 0 || jitter_us < min_jitter_us_) {
+        min_jitter_us_ = jitter_us;
+      }
+      if (ticks_ == 0 || jitter_us > max_jitter_us_) {
+        max_jitter_us_ = jitter_us;
+      }
+      last_jitter_us_ = jitter_us;
+      sum_abs_jitter_us_ += static_cast<uint64_t>(jitter_us < 0 ? -static_cast<int64_t>(jitter_us) : jitter_us);
+      ticks_++;
+    }
+    last_ticks_ = now;
+    chSysUnlock();
+    return jitter_us;
+  }
+
+  /**
+   * Copies the statistics of all schedules.
+   * @return The number of schedules copied
+   */
+  static size_t GetAll(ScheduleStats* stats, size_t max_count, bool reset) {
+    size_t count = 0;
+    for (ScheduleMonitor* monitor = first_.load(); monitor != nullptr && count < max_count; monitor = monitor->next_) {
+      ScheduleStats& entry = stats[count++];
+      entry = ScheduleStats{};
+      chSysLock();
+      entry.service_id = monitor->service_id_;
+      entry.period_us = monitor->period_us_;
+      entry.ticks = monitor->ticks_;
+      entry.last_jitter_us = monitor->last_jitter_us_;
+      entry.min_jitter_us = monitor->min_jitter_us_;
+      entry.max_jitter_us = monitor->max_jitter_us_;
+      entry.avg_abs_jitter_us =
+          monitor->ticks_ > 0 ? static_cast<uint32_t>(monitor->sum_abs_jitter_us_ / monitor->ticks_) : 0;
+      if (reset) {
+        monitor->ticks_ = 0;
+        monitor->sum_abs_jitter_us_ = 0;
+      }
+      chSysUnlock();
+    }
+    return count;
+  }
+
+ private:
+  inline static std::atomic<ScheduleMonitor*> first_{nullptr};
+  ScheduleMonitor* next_ = nullptr;
+
+  uint32_t period_us_;
+  // Unknown until the first tick
+  uint16_t service_id_ = 0xFFFF;
+  uint64_t last_ticks_ = 0;
+  uint32_t ticks_ = 0;
+  int32_t last_jitter_us_ = 0;
+  int32_t min_jitter_us_ = 0;
+  int32_t max_jitter_us_ = 0;
+  uint64_t sum_abs_jitter_us_ = 0;
+};
+
+}  // namespace xbot::system_monitor
+
+#endif  // SYSTEM_MONITOR_HPP
@@ -9,4 +9,15 @@
 
 #define XBOT_THREAD_TYPEDEF thread_t*
 
+#include <cstddef>
+
+namespace xbot::service::thread {
+/**
+ * Like initialize(), with an explicit priority (cfg/thread_priorities.h) for the threads of the port itself.
+ * initialize() uses the role assigned with xbot::deadlines::AssignThread() or NORMALPRIO.
+ */
+bool initializeWithPriority(thread_t** thread, void (*threadfunc)(void*), void* arg, void* stackbuf, size_t buflen,
+                            const char* name, tprio_t priority);
+}  // namespace xbot::service::thread
+
 #endif  // THREAD_IMPL_HPP
@@ -0,0 +1,85 @@
+//
+// Clock synchronization with the host (PTP-style, four timestamps), handled by the xbot IO thread.
+//
+// The host is the master. Exchange (all timestamps in ns, each in its own clock):
+//   1. host  -> board  SYNC        t1 = host send time
+//   2. board -> host   DELAY_REQ   t2 = board receive time of SYNC, t3 = board send time
+//   3. host  -> board  DELAY_RESP  t4 = host receive time of DELAY_REQ
+//   4. board -> host   STATUS      current offset / drift estimate
+// The board is stateless until DELAY_RESP arrives with all four timestamps.
+//
+// offset (host - board) = ((t1 - t2) + (t4 - t3)) / 2, round trip = (t4 - t1) - (t3 - t2)
+//
+// Board timestamps are taken from the timebase when the socket hands over the packet and
+// right before it is sent.
+//
+
+#ifndef TIME_SYNC_HPP
+#define TIME_SYNC_HPP
+
+#include <cstdint>
+
+namespace xbot::time_sync {
+
+// Reserved service id for time sync packets (header followed by a TimeSyncMessage)
+constexpr uint16_t TIME_SYNC_SERVICE_ID = 0xFFFE;
+
+enum class MessageType : uint8_t { SYNC = 1, DELAY_REQ = 2, DELAY_RESP = 3, STATUS = 4 };
+
+#pragma pack(push, 1)
+struct TimeSyncMessage {
+  MessageType type;
+  uint8_t reserved[3];
+  uint32_t sequence;
+  uint64_t t1;
+  uint64_t t2;
+  uint64_t t3;
+  uint64_t t4;
+  // Filled in STATUS messages
+  int64_t offset_ns;
+  int32_t drift_ppb;
+  uint32_t round_trip_ns;
+};
+#pragma pack(pop)
+
+struct Estimate {
+  bool valid;
+  // Host time - board time at reference_ns (board time)
+  int64_t offset_ns;
+  uint64_t reference_ns;
+  // Rate of the host clock relative to the board clock, in parts per billion
+  double drift_ppb;
+  // Round trip of the last accepted exchange
+  uint32_t round_trip_ns;
+  uint32_t accepted;
+  uint32_t rejected;
+};
+
+Estimate GetEstimate();
+
+/**
+ * Converts a board timebase value (xbot::timebase ticks) into host time.
+ * Used for the capture times sent with the service outputs, see xbot/sample_stamps.hpp.
+ * @return Host time in ns, 0 if no estimate exists yet
+ */
+uint64_t ToHostNanos(uint64_t board_ticks);
+
+/**
+ * Endpoint of the host which sends the SYNC messages (host byte order).
+ * @return false if no SYNC was received yet
+ */
+bool GetHost(uint32_t* ip, uint16_t* port);
+
+namespace detail {
+// Called by the IO thread with the timestamps of a complete exchange
+void AddSample(uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4);
+/**
+ * Called by the IO thread for every SYNC message.
+ * @return true if it started a new host session (first SYNC, another endpoint or the sequence restarted)
+ */
+bool OnSync(uint32_t ip, uint16_t port, uint32_t sequence);
+}  // namespace detail
+
+}  // namespace xbot::time_sync
+
+#endif  // TIME_SYNC_HPP
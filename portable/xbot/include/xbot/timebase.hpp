@@ -0,0 +1,89 @@
+//
+// 64-bit monotonic timebase.
+//
+// TIM5 (32 bit) runs freely at TICKS_PER_SECOND and is extended to 64 bits in software:
+// every read compares against the previous one and counts the wraps. A virtual timer reads
+// it once a minute, so no wrap (every ~14 minutes) is ever missed.
+//
+// NowTicks() can be called from threads and from ISRs up to the kernel priority.
+//
+
+#ifndef TIMEBASE_HPP
+#define TIMEBASE_HPP
+
+#include <cstdint>
+
+#ifdef HOSTSIM
+#include <chrono>
+#else
+#include "ch.h"
+#include "hal.h"
+#endif
+
+namespace xbot::timebase {
+
+// 200 ns resolution
+constexpr uint32_t TICKS_PER_SECOND = 5'000'000;
+constexpr uint32_t TICKS_PER_MICROSECOND = TICKS_PER_SECOND / 1'000'000;
+constexpr uint32_t NANOS_PER_TICK = 1'000'000'000 / TICKS_PER_SECOND;
+
+constexpr uint64_t TicksToMicros(uint64_t ticks) {
+  return ticks / TICKS_PER_MICROSECOND;
+}
+
+constexpr uint64_t TicksToNanos(uint64_t ticks) {
+  return ticks * NANOS_PER_TICK;
+}
+
+#ifdef HOSTSIM
+inline void Init() {
+}
+
+inline uint64_t NowTicks() {
+  const auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count() / NANOS_PER_TICK;
+}
+#else
+static_assert(STM32_TIMCLK1 % TICKS_PER_SECOND == 0, "TIM5 clock is not a multiple of the timebase frequency");
+
+namespace detail {
+// Upper 32 bits and the last counter value seen, only accessed with the system locked
+inline uint32_t high = 0;
+inline uint32_t last_low = 0;
+inline virtual_timer_t wrap_timer;
+}  // namespace detail
+
+inline uint64_t NowTicks() {
+  const syssts_t sts = chSysGetStatusAndLockX();
+  const uint32_t low = TIM5->CNT;
+  if (low < detail::last_low) {
+    detail::high++;
+  }
+  detail::last_low = low;
+  const uint64_t ticks = static_cast<uint64_t>(detail::high) << 32 | low;
+  chSysRestoreStatusX(sts);
+  return ticks;
+}
+
+// Starts TIM5, call once after halInit() and chSysInit()
+inline void Init() {
+  rccEnableTIM5(true);
+  rccResetTIM5();
+  TIM5->PSC = STM32_TIMCLK1 / TICKS_PER_SECOND - 1;
+  TIM5->ARR = 0xFFFFFFFF;
+  // Load the prescaler
+  TIM5->EGR = TIM_EGR_UG;
+  TIM5->CR1 = TIM_CR1_CEN;
+
+  chVTObjectInit(&detail::wrap_timer);
+  chVTSetContinuous(&detail::wrap_timer, TIME_S2I(60), [](virtual_timer_t*, void*) { NowTicks(); }, nullptr);
+}
+#endif
+
+inline uint64_t NowMicros() {
+  return TicksToMicros(NowTicks());
+}
+
+}  // namespace xbot::timebase
+
+#endif  // TIMEBASE_HPP
@@ -0,0 +1,257 @@
+//
+// Always-on latency tracing with named spans.
+//
+// A span is measured between two xbot::timebase timestamps, e.g. from the capture of an ESC status frame
+// until the ActualTwist output was sent. Record() appends (span, start, duration) to a ring buffer and
+// updates the span's statistics (count, min, avg, max and a log2 histogram for percentiles). Recording
+// only uses atomic operations and a short critical section for the 64 bit sum, so it can be called from
+// any thread or ISR.
+//
+// The IO thread serves snapshots to requests on TRACE_SERVICE_ID: the first payload byte is a Command,
+// the answer is a header followed by a SpanSnapshot per span, or by the newest RingEntry records.
+//
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <xbot/deadlines.hpp>
+#include <xbot/timebase.hpp>
+
+#include "ch.h"
+
+namespace xbot::trace {
+
+// Reserved service id for trace requests
+constexpr uint16_t TRACE_SERVICE_ID = 0xFFFB;
+
+enum class Span : uint8_t {
+  // Datagram received by lwIP until the IO thread handed it to the service
+  IO_RX_TO_DISPATCH,
+  // ControlTwist received by DiffDriveService until the resulting duty was sent to the ESCs
+  TWIST_TO_DUTY,
+  // ESC status frame received until the ActualTwist output was sent
+  ESC_STATUS_TO_TWIST,
+  // ImuService reading and averaging the FIFO
+  IMU_READ_FIFO,
+  // End of a GPS burst until it was parsed and the state callbacks ran
+  GPS_RX_TO_PARSED,
+  // EmergencyService::UpdateEmergency, including the status output
+  EMERGENCY_UPDATE,
+  // Emergency input edge until all motors got zero duty (fast path)
+  EMERGENCY_STOP,
+  COUNT
+};
+
+constexpr size_t SPAN_COUNT = static_cast<size_t>(Span::COUNT);
+constexpr const char* SPAN_NAMES[SPAN_COUNT] = {
+    "io_rx_dispatch", "twist_to_duty", "esc_to_twist", "imu_read_fifo", "gps_rx_parsed", "emergency_update",
+    "emergency_stop",
+};
+// Every span is also checked against the deadline of its role (xbot/deadlines.hpp)
+constexpr deadlines::Role SPAN_ROLES[SPAN_COUNT] = {
+    deadlines::Role::NETWORK, deadlines::Role::MOTOR_CONTROL, deadlines::Role::MOTOR_CONTROL, deadlines::Role::IMU,
+    deadlines::Role::GPS,     deadlines::Role::SAFETY,        deadlines::Role::SAFETY,
+};
+
+// Histogram bucket i counts durations below 2^i us, the last one everything above
+constexpr size_t HISTOGRAM_BUCKETS = 24;
+// Must be a power of two
+constexpr size_t RING_SIZE = 256;
+
+enum class Command : uint8_t {
+  STATISTICS = 0,
+  // Returns the statistics and starts new ones
+  STATISTICS_RESET = 1,
+  RING = 2,
+};
+
+#pragma pack(push, 1)
+struct SpanSnapshot {
+  uint8_t span;
+  // Zero terminated
+  char name[23];
+  uint32_t count;
+  uint32_t min_us;
+  uint32_t avg_us;
+  uint32_t max_us;
+  // Upper bound of the histogram bucket which contains the 99th percentile
+  uint32_t p99_us;
+};
+
+struct RingEntry {
+  uint8_t span;
+  uint8_t reserved[3];
+  // Low 32 bits of the start timestamp (xbot::timebase ticks)
+  uint32_t start_ticks;
+  uint32_t duration_us;
+};
+#pragma pack(pop)
+
+namespace detail {
+constexpr bool SpanNamesFit(size_t size) {
+  for (const char* name : SPAN_NAMES) {
+    size_t length = 0;
+    while (name[length] != '\0') length++;
+    if (length >= size) return false;
+  }
+  return true;
+}
+}  // namespace detail
+static_assert(detail::SpanNamesFit(sizeof(SpanSnapshot::name)), "Span name too long for SpanSnapshot::name");
+
+namespace detail {
+struct SpanStats {
+  std::atomic<uint32_t> count{0};
+  // 64 bit, 32 bit would wrap after ~72 minutes of a span that's always active. Guarded by the kernel lock,
+  // the M7 has no 64 bit atomics.
+  uint64_t sum_us = 0;
+  std::atomic<uint32_t> min_us{UINT32_MAX};
+  std::atomic<uint32_t> max_us{0};
+  std::atomic<uint32_t> histogram[HISTOGRAM_BUCKETS]{};
+};
+
+struct RingSlot {
+  std::atomic<uint32_t> span_and_sequence{0};
+  std::atomic<uint32_t> start_ticks{0};
+  std::atomic<uint32_t> duration_us{0};
+};
+
+inline SpanStats stats[SPAN_COUNT]{};
+inline RingSlot ring[RING_SIZE]{};
+inline std::atomic<uint32_t> ring_head{0};
+
+inline size_t BucketFor(uint32_t duration_us) {
+  size_t bucket = 0;
+  while (bucket < HISTOGRAM_BUCKETS - 1 && duration_us >= (1u << bucket)) {
+    bucket++;
+  }
+  return bucket;
+}
+}  // namespace detail
+
+/**
+ * Records a finished span. Callable from ISRs.
+ */
+inline void Record(Span span, uint64_t start_ticks, uint64_t end_ticks) {
+  const auto index = static_cast<size_t>(span);
+  if (index >= SPAN_COUNT || end_ticks < start_ticks) {
+    return;
+  }
+  const uint64_t duration = timebase::TicksToMicros(end_ticks - start_ticks);
+  const uint32_t duration_us = duration > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(duration);
+  deadlines::Check(SPAN_ROLES[index], duration_us);
+
+  detail::SpanStats& stats = detail::stats[index];
+  stats.count.fetch_add(1, std::memory_order_relaxed);
+  const syssts_t sts = chSysGetStatusAndLockX();
+  stats.sum_us += duration_us;
+  chSysRestoreStatusX(sts);
+  stats.histogram[detail::BucketFor(duration_us)].fetch_add(1, std::memory_order_relaxed);
+  uint32_t min = stats.min_us.load(std::memory_order_relaxed);
+  while (duration_us < min && !stats.min_us.compare_exchange_weak(min, duration_us, std::memory_order_relaxed)) {
+  }
+  uint32_t max = stats.max_us.load(std::memory_order_relaxed);
+  while (duration_us > max && !stats.max_us.compare_exchange_weak(max, duration_us, std::memory_order_relaxed)) {
+  }
+
+  // The sequence in the upper bits tells a reader whether the slot was written in this round
+  const uint32_t position = detail::ring_head.fetch_add(1, std::memory_order_relaxed);
+  detail::RingSlot& slot = detail::ring[position & (RING_SIZE - 1)];
+  slot.start_ticks.store(static_cast<uint32_t>(start_ticks), std::memory_order_relaxed);
+  slot.duration_us.store(duration_us, std::memory_order_relaxed);
+  slot.span_and_sequence.store((position << 8) | static_cast<uint8_t>(span), std::memory_order_release);
+}
+
+/**
+ * Records from its construction until it goes out of scope.
+ */
+class ScopedSpan {
+ public:
+  explicit ScopedSpan(Span span) : span_(span), start_ticks_(timebase::NowTicks()) {
+  }
+
+  ~ScopedSpan() {
+    Record(span_, start_ticks_, timebase::NowTicks());
+  }
+
+  ScopedSpan(const ScopedSpan&) = delete;
+  ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+ private:
+  Span span_;
+  uint64_t start_ticks_;
+};
+
+inline SpanSnapshot GetSnapshot(Span span, bool reset = false) {
+  const auto index = static_cast<size_t>(span);
+  detail::SpanStats& stats = detail::stats[index];
+  SpanSnapshot snapshot{};
+  snapshot.span = static_cast<uint8_t>(span);
+  for (size_t i = 0; i < sizeof(snapshot.name) - 1 && SPAN_NAMES[index][i] != '\0'; i++) {
+    snapshot.name[i] = SPAN_NAMES[index][i];
+  }
+  // Not taken atomically as a whole, a span recorded meanwhile may be missing in some of the fields
+  uint32_t histogram[HISTOGRAM_BUCKETS];
+  uint32_t histogram_total = 0;
+  for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    histogram[i] = reset ? stats.histogram[i].exchange(0) : stats.histogram[i].load();
+    histogram_total += histogram[i];
+  }
+  snapshot.count = reset ? stats.count.exchange(0) : stats.count.load();
+  const syssts_t sts = chSysGetStatusAndLockX();
+  const uint64_t sum_us = stats.sum_us;
+  if (reset) {
+    stats.sum_us = 0;
+  }
+  chSysRestoreStatusX(sts);
+  snapshot.min_us = reset ? stats.min_us.exchange(UINT32_MAX) : stats.min_us.load();
+  snapshot.max_us = reset ? stats.max_us.exchange(0) : stats.max_us.load();
+  if (snapshot.count == 0) {
+    snapshot.min_us = 0;
+    return snapshot;
+  }
+  snapshot.avg_us = static_cast<uint32_t>(sum_us / snapshot.count);
+  uint32_t cumulative = 0;
+  for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    cumulative += histogram[i];
+    if (static_cast<uint64_t>(cumulative) * 100 >= static_cast<uint64_t>(histogram_total) * 99) {
+      snapshot.p99_us = i < HISTOGRAM_BUCKETS - 1 ? (1u << i) : snapshot.max_us;
+      break;
+    }
+  }
+  return snapshot;
+}
+
+/**
+ * Copies the newest ring entries, oldest first.
+ * @return The number of entries
+ */
+inline size_t GetRing(RingEntry* entries, size_t max_count) {
+  const uint32_t head = detail::ring_head.load(std::memory_order_acquire);
+  size_t available = head < RING_SIZE ? head : RING_SIZE;
+  if (available > max_count) {
+    available = max_count;
+  }
+  size_t count = 0;
+  for (uint32_t position = head - available; position != head; position++) {
+    const detail::RingSlot& slot = detail::ring[position & (RING_SIZE - 1)];
+    const uint32_t span_and_sequence = slot.span_and_sequence.load(std::memory_order_acquire);
+    // Skip slots which were overwritten meanwhile or are still being written
+    if ((span_and_sequence >> 8) != (position & 0xFFFFFF)) {
+      continue;
+    }
+    RingEntry& entry = entries[count++];
+    entry = RingEntry{};
+    entry.span = static_cast<uint8_t>(span_and_sequence);
+    entry.start_ticks = slot.start_ticks.load(std::memory_order_relaxed);
+    entry.duration_us = slot.duration_us.load(std::memory_order_relaxed);
+  }
+  return count;
+}
+
+}  // namespace xbot::trace
+
+#endif  // TRACE_HPP
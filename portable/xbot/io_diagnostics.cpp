@@ -0,0 +1,82 @@
+//
+// Packet dispatch counters of the xbot IO thread, see xbot/io_diagnostics.hpp.
+//
+#include <xbot/io_diagnostics.hpp>
+
+#include "ch.h"
+
+namespace xbot::io_diagnostics {
+
+// Only written by the IO thread (tx_* with the system locked), single 32 bit fields can be read from anywhere
+static IoCounters io_counters_{};
+static ServiceCounters service_counters_[SERVICE_TABLE_SIZE]{};
+static bool registered_[SERVICE_TABLE_SIZE]{};
+// Counters of the service which is currently being given a packet by the IO thread
+static ServiceCounters* dispatch_counters_ = nullptr;
+static thread_t* dispatch_thread_ = nullptr;
+
+IoCounters GetIoCounters() {
+  chSysLock();
+  const IoCounters counters = io_counters_;
+  chSysUnlock();
+  return counters;
+}
+
+bool GetServiceCounters(uint16_t service_id, ServiceCounters* counters) {
+  if (service_id >= SERVICE_TABLE_SIZE || counters == nullptr) {
+    return false;
+  }
+  if (!registered_[service_id]) {
+    return false;
+  }
+  chSysLock();
+  *counters = service_counters_[service_id];
+  chSysUnlock();
+  return true;
+}
+
+void detail::OnQueuePush(bool blocked, bool posted, size_t fill) {
+  if (dispatch_counters_ == nullptr || chThdGetSelfX() != dispatch_thread_) {
+    return;
+  }
+  if (blocked) {
+    dispatch_counters_->queue_blocked++;
+  }
+  if (posted) {
+    dispatch_counters_->delivered++;
+  } else {
+    dispatch_counters_->dropped_queue_full++;
+  }
+  if (fill > dispatch_counters_->queue_high_water) {
+    dispatch_counters_->queue_high_water = static_cast<uint16_t>(fill);
+  }
+}
+
+IoCounters& detail::MutableIoCounters() {
+  return io_counters_;
+}
+
+ServiceCounters* detail::MutableServiceCounters(uint16_t service_id) {
+  return service_id < SERVICE_TABLE_SIZE ? &service_counters_[service_id] : nullptr;
+}
+
+void detail::RegisterService(uint16_t service_id) {
+  if (service_id < SERVICE_TABLE_SIZE) {
+    service_counters_[service_id].service_id = service_id;
+    registered_[service_id] = true;
+  }
+}
+
+void detail::SetDispatchThread() {
+  dispatch_thread_ = chThdGetSelfX();
+}
+
+bool detail::IsDispatchThread() {
+  return chThdGetSelfX() == dispatch_thread_;
+}
+
+void detail::SetDispatchCounters(ServiceCounters* counters) {
+  dispatch_counters_ = counters;
+}
+
+}  // namespace xbot::io_diagnostics
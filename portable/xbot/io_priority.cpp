@@ -0,0 +1,78 @@
+//
+// Priority lane and packet pool quotas for received xbot packets, see xbot/io_priority.hpp.
+//
+#include <xbot/datatypes/XbotHeader.hpp>
+#include <xbot/io_diagnostics.hpp>
+#include <xbot/io_priority.hpp>
+#include <xbot/timebase.hpp>
+
+#include "ch.h"
+
+namespace xbot::io_priority {
+
+using io_diagnostics::SERVICE_TABLE_SIZE;
+
+static bool priority_[SERVICE_TABLE_SIZE]{};
+static uint8_t quota_[SERVICE_TABLE_SIZE]{};
+// Set by the IO thread while it delivers to a bulk service
+static bool dispatching_bulk_ = false;
+
+void SetPriority(uint16_t service_id, bool priority) {
+  if (service_id < SERVICE_TABLE_SIZE) {
+    priority_[service_id] = priority;
+  }
+}
+
+void SetQuota(uint16_t service_id, uint8_t max_packets) {
+  if (service_id < SERVICE_TABLE_SIZE) {
+    quota_[service_id] = max_packets;
+  }
+}
+
+bool IsPriority(uint16_t service_id) {
+  return service_id < SERVICE_TABLE_SIZE && priority_[service_id];
+}
+
+uint8_t detail::GetQuota(uint16_t service_id) {
+  return quota_[service_id] != 0 ? quota_[service_id] : DEFAULT_QUOTA;
+}
+
+bool detail::IsPriorityDatagram(const uint8_t* data, size_t size) {
+  size_t offset = 0;
+  while (size - offset >= sizeof(datatypes::XbotHeader)) {
+    const auto header = reinterpret_cast<const datatypes::XbotHeader*>(data + offset);
+    if (IsPriority(header->service_id)) {
+      return true;
+    }
+    offset += sizeof(datatypes::XbotHeader) + header->payload_size;
+    if (offset > size) {
+      break;
+    }
+  }
+  return false;
+}
+
+void detail::SetDispatchingBulk(bool bulk) {
+  dispatching_bulk_ = bulk;
+}
+
+bool detail::QueueMayWait() {
+  return !(dispatching_bulk_ && io_diagnostics::detail::IsDispatchThread());
+}
+
+void detail::OnPacketDone(bool priority, uint64_t latency_ticks) {
+  const uint32_t latency_us = static_cast<uint32_t>(timebase::TicksToMicros(latency_ticks));
+  const syssts_t sts = chSysGetStatusAndLockX();
+  io_diagnostics::IoCounters& counters = io_diagnostics::detail::MutableIoCounters();
+  if (priority) {
+    counters.priority_latency_last_us = latency_us;
+    if (latency_us > counters.priority_latency_max_us) {
+      counters.priority_latency_max_us = latency_us;
+    }
+  } else if (latency_us > counters.bulk_latency_max_us) {
+    counters.bulk_latency_max_us = latency_us;
+  }
+  chSysRestoreStatusX(sts);
+}
+
+}  // namespace xbot::io_priority
@@ -0,0 +1,112 @@
+//
+// Output rates requested by the host, see xbot/output_subscriptions.hpp.
+//
+#include <cstring>
+#include <xbot/output_subscriptions.hpp>
+#include <xbot/timebase.hpp>
+
+#include "ch.h"
+
+namespace xbot::output_subscriptions {
+
+// Written by the IO thread, read by the services, always with the system locked
+static Subscription subscriptions_[MAX_SUBSCRIPTIONS]{};
+static size_t subscription_count_ = 0;
+static uint32_t generation_ = 0;
+
+static Subscription* FindI(uint16_t service_id, uint16_t output_id) {
+  for (size_t i = 0; i < subscription_count_; i++) {
+    if (subscriptions_[i].service_id == service_id && subscriptions_[i].output_id == output_id) {
+      return &subscriptions_[i];
+    }
+  }
+  return nullptr;
+}
+
+bool Subscribe(const Subscription& subscription) {
+  bool result = true;
+  chSysLock();
+  Subscription* existing = FindI(subscription.service_id, subscription.output_id);
+  if (subscription.policy == Policy::DEFAULT) {
+    if (existing != nullptr) {
+      *existing = subscriptions_[--subscription_count_];
+    }
+  } else if (existing != nullptr) {
+    *existing = subscription;
+  } else if (subscription_count_ < MAX_SUBSCRIPTIONS) {
+    subscriptions_[subscription_count_++] = subscription;
+  } else {
+    result = false;
+  }
+  generation_++;
+  chSysUnlock();
+  return result;
+}
+
+Policy GetPolicy(uint16_t service_id, uint16_t output_id, uint32_t* period_us) {
+  Policy policy = Policy::DEFAULT;
+  uint32_t period = 0;
+  chSysLock();
+  const Subscription* subscription = FindI(service_id, output_id);
+  if (subscription == nullptr) {
+    subscription = FindI(service_id, ALL_OUTPUTS);
+  }
+  if (subscription != nullptr) {
+    policy = subscription->policy;
+    period = subscription->period_us;
+  }
+  chSysUnlock();
+  if (period_us != nullptr) {
+    *period_us = period;
+  }
+  return policy;
+}
+
+uint32_t GetPeriodUs(uint16_t service_id, uint16_t output_id) {
+  uint32_t period_us = 0;
+  const Policy policy = GetPolicy(service_id, output_id, &period_us);
+  return policy == Policy::PERIODIC || policy == Policy::ON_CHANGE ? period_us : 0;
+}
+
+uint32_t GetGeneration() {
+  chSysLock();
+  const uint32_t generation = generation_;
+  chSysUnlock();
+  return generation;
+}
+
+size_t GetSubscriptions(Subscription* subscriptions, size_t max_count) {
+  chSysLock();
+  const size_t count = subscription_count_ < max_count ? subscription_count_ : max_count;
+  memcpy(subscriptions, subscriptions_, count * sizeof(Subscription));
+  chSysUnlock();
+  return count;
+}
+
+bool OutputGate::Due(uint64_t now_ticks, bool changed) {
+  uint32_t period_us = 0;
+  const Policy policy = GetPolicy(service_id_, output_id_, &period_us);
+  if (policy == Policy::DEFAULT) {
+    sent_ = false;
+    return true;
+  }
+  if (policy == Policy::OFF || (policy == Policy::ON_CHANGE && !changed)) {
+    return false;
+  }
+  const uint64_t period_ticks = static_cast<uint64_t>(period_us) * timebase::TICKS_PER_MICROSECOND;
+  const uint64_t elapsed = now_ticks - last_sent_ticks_;
+  // A schedule running slightly faster than the period (e.g. 4.8 ms for 5 ms) must not halve the rate
+  if (sent_ && elapsed + period_ticks / 8 < period_ticks) {
+    return false;
+  }
+  // Keep the average rate when the schedule doesn't divide the period, unless we're more than a period late
+  if (policy == Policy::PERIODIC && sent_ && elapsed < 2 * period_ticks) {
+    last_sent_ticks_ += period_ticks;
+  } else {
+    last_sent_ticks_ = now_ticks;
+  }
+  sent_ = true;
+  return true;
+}
+
+}  // namespace xbot::output_subscriptions
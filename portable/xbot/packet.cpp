@@ -7,20 +7,89 @@
 #include <cstring>
 #include <xbot-service/portable/packet.hpp>
 #include <xbot/config.hpp>
+#include <xbot/io_diagnostics.hpp>
+#include <xbot/io_priority.hpp>
+#include <xbot/packet_pool.hpp>
+#include <xbot/timebase.hpp>
 
 using namespace xbot::service::packet;
+using namespace xbot::packet_pool;
 
-#define XBOT_PACKET_POOL_SIZE 25
+#define XBOT_PACKET_POOL_SIZE xbot::packet_pool::POOL_SIZE
 
 LWIP_MEMPOOL_DECLARE(xbot_packet_pool, XBOT_PACKET_POOL_SIZE, sizeof(Packet), "xbot packets")
 SEMAPHORE_DECL(xbot_packet_sema, XBOT_PACKET_POOL_SIZE);
 
-PacketPtr xbot::service::packet::allocatePacket() {
-  chSemWait(&xbot_packet_sema);
+static_assert(xbot::io_priority::RESERVED_PACKETS < XBOT_PACKET_POOL_SIZE, "Priority reserve exceeds the pool");
+
+// Packets held per service (received, not yet freed), only accessed with the system locked
+static uint8_t held_by_service[xbot::io_diagnostics::SERVICE_TABLE_SIZE]{};
+
+// Pool statistics and the thread of each owner entry, only accessed with the system locked
+static PoolStats stats{POOL_SIZE, 0, 0, xbot::io_priority::RESERVED_PACKETS, 0, 0, 0, {}, {}};
+static thread_t *owner_threads[MAX_OWNERS]{};
+
+#ifndef HOSTSIM
+// Packets holding a reference to a received pbuf, only accessed with the system locked
+static size_t held_rx_pbufs = 0;
+
+static bool tryHoldRxPbuf() {
+  chSysLock();
+  const bool hold = held_rx_pbufs < MAX_HELD_RX_PBUFS;
+  if (hold) {
+    held_rx_pbufs++;
+  }
+  chSysUnlock();
+  return hold;
+}
+
+static void releaseRxPbuf(Packet *packet) {
+  if (packet->rx_pbuf == nullptr) {
+    return;
+  }
+  pbuf_free(packet->rx_pbuf);
+  packet->rx_pbuf = nullptr;
+  chSysLock();
+  held_rx_pbufs--;
+  chSysUnlock();
+}
+#endif
+
+static uint8_t ownerIndexI(thread_t *thread) {
+  for (uint8_t i = 0; i < MAX_OWNERS; i++) {
+    if (owner_threads[i] == thread) {
+      return i;
+    }
+    if (owner_threads[i] == nullptr) {
+      owner_threads[i] = thread;
+      return i;
+    }
+  }
+  return MAX_OWNERS - 1;
+}
+
+static void recordWaitI(bool got_packet, uint64_t wait_ticks) {
+  if (!got_packet) {
+    stats.failed++;
+    stats.wait_histogram[WAIT_BUCKETS - 1]++;
+    return;
+  }
+  const uint64_t wait_us = xbot::timebase::TicksToMicros(wait_ticks);
+  size_t bucket = 0;
+  while (bucket < sizeof(WAIT_BUCKET_LIMITS_US) / sizeof(WAIT_BUCKET_LIMITS_US[0]) &&
+         wait_us > WAIT_BUCKET_LIMITS_US[bucket]) {
+    bucket++;
+  }
+  stats.wait_histogram[bucket]++;
+}
+
+static PacketPtr takePacket() {
   auto buffer = static_cast<Packet *>(LWIP_MEMPOOL_ALLOC(xbot_packet_pool));
   if (!buffer) {
-    while (1)
-      ;
+    // The semaphore guarantees a free packet, so the pool is corrupt. Give the slot back.
+    chDbgAssert(false, "xbot packet pool corrupt");
+    chSemSignal(&xbot_packet_sema);
+    return nullptr;
   }
 #ifdef DEBUG_MEM
 #warning DEBUG_MEM enabled, disable for performance
@@ -29,19 +98,178 @@ PacketPtr xbot::service::packet::allocatePacket() {
   // Set used data to 0, because packet is empty (byte contents might be random
   // at this point though)
   buffer->used_data = 0;
+  buffer->data = buffer->buffer;
+  buffer->rx_pbuf = nullptr;
+  buffer->rx_ticks = 0;
+  buffer->priority = false;
+  buffer->owner_service = NO_SERVICE;
+
+  chSysLock();
+  buffer->pool_owner = ownerIndexI(chThdGetSelfX());
+  OwnerStats &owner = stats.owners[buffer->pool_owner];
+  owner.outstanding++;
+  if (owner.outstanding > owner.max_outstanding) {
+    owner.max_outstanding = owner.outstanding;
+  }
+  stats.in_use++;
+  if (stats.in_use > stats.high_water) {
+    stats.high_water = stats.in_use;
+  }
+  stats.allocations++;
+  chSysUnlock();
   return buffer;
 }
 
+PacketPtr xbot::service::packet::allocatePacket() {
+  return allocatePacketTimeout(ALLOC_TIMEOUT_MS);
+}
+
+Packet *xbot::service::packet::allocatePacketTimeout(uint32_t timeout_ms) {
+  // Fast path, no timing needed
+  if (chSemWaitTimeout(&xbot_packet_sema, TIME_IMMEDIATE) == MSG_OK) {
+    chSysLock();
+    recordWaitI(true, 0);
+    chSysUnlock();
+    return takePacket();
+  }
+
+  const uint64_t start = xbot::timebase::NowTicks();
+  const bool got_packet = chSemWaitTimeout(&xbot_packet_sema, TIME_MS2I(timeout_ms)) == MSG_OK;
+  const uint64_t wait_ticks = xbot::timebase::NowTicks() - start;
+  chSysLock();
+  stats.exhausted++;
+  recordWaitI(got_packet, wait_ticks);
+  chSysUnlock();
+  if (!got_packet) {
+    return nullptr;
+  }
+  return takePacket();
+}
+
+Packet *xbot::service::packet::tryAllocatePacket(bool priority) {
+  chSysLock();
+  const cnt_t available = chSemGetCounterI(&xbot_packet_sema);
+  const bool allowed = available > (priority ? 0 : static_cast<cnt_t>(xbot::io_priority::RESERVED_PACKETS));
+  if (allowed) {
+    // Can't block, the counter is positive
+    chSemFastWaitI(&xbot_packet_sema);
+  } else {
+    stats.exhausted++;
+  }
+  recordWaitI(allowed, 0);
+  chSysUnlock();
+  if (!allowed) {
+    return nullptr;
+  }
+  PacketPtr packet = takePacket();
+  if (packet != nullptr) {
+    packet->priority = priority;
+  }
+  return packet;
+}
+
+bool xbot::service::packet::packetChargeService(Packet *packet, uint16_t service_id, uint8_t quota) {
+  if (service_id >= xbot::io_diagnostics::SERVICE_TABLE_SIZE) {
+    return true;
+  }
+  chSysLock();
+  const bool allowed = held_by_service[service_id] < quota;
+  if (allowed) {
+    held_by_service[service_id]++;
+    packet->owner_service = service_id;
+  }
+  chSysUnlock();
+  return allowed;
+}
+
 void xbot::service::packet::freePacket(PacketPtr packet_ptr) {
+  if (packet_ptr == nullptr) {
+    return;
+  }
+  if (packet_ptr->owner_service != NO_SERVICE) {
+    // The service is done with a received packet
+    xbot::io_priority::detail::OnPacketDone(packet_ptr->priority, xbot::timebase::NowTicks() - packet_ptr->rx_ticks);
+    chSysLock();
+    held_by_service[packet_ptr->owner_service]--;
+    chSysUnlock();
+  }
+#ifndef HOSTSIM
+  releaseRxPbuf(packet_ptr);
+#endif
+  chSysLock();
+  stats.owners[packet_ptr->pool_owner].outstanding--;
+  stats.in_use--;
+  chSysUnlock();
   LWIP_MEMPOOL_FREE(xbot_packet_pool, packet_ptr);
   chSemSignal(&xbot_packet_sema);
 }
 
+PoolStats xbot::packet_pool::GetPoolStats() {
+  chSysLock();
+  PoolStats result = stats;
+  thread_t *threads[MAX_OWNERS];
+  memcpy(threads, owner_threads, sizeof(threads));
+  chSysUnlock();
+  for (size_t i = 0; i < MAX_OWNERS; i++) {
+    // Thread names are static strings
+    if (threads[i] != nullptr && threads[i]->name != nullptr) {
+      strncpy(result.owners[i].name, threads[i]->name, sizeof(result.owners[i].name));
+    }
+  }
+  return result;
+}
+
+void xbot::service::packet::packetMakeWritable(Packet *packet) {
+  if (packet->data == packet->buffer) {
+    return;
+  }
+  memcpy(packet->buffer, packet->data, packet->used_data);
+  packet->data = packet->buffer;
+#ifndef HOSTSIM
+  releaseRxPbuf(packet);
+#endif
+}
+
+#ifndef HOSTSIM
+bool xbot::service::packet::packetHoldRxPbuf(Packet *packet, struct pbuf *p) {
+  if (p->next != nullptr || !tryHoldRxPbuf()) {
+    return false;
+  }
+  packet->data = static_cast<uint8_t *>(p->payload);
+  packet->rx_pbuf = p;
+  return true;
+}
+#endif
+
+Packet *xbot::service::packet::packetSlice(const Packet *packet, size_t offset, size_t size) {
+  const PacketPtr slice = allocatePacket();
+  if (slice == nullptr) {
+    return nullptr;
+  }
+#ifndef HOSTSIM
+  if (packet->rx_pbuf != nullptr && tryHoldRxPbuf()) {
+    pbuf_ref(packet->rx_pbuf);
+    slice->rx_pbuf = packet->rx_pbuf;
+    slice->data = packet->data + offset;
+  } else
+#endif
+  {
+    memcpy(slice->buffer, packet->data + offset, size);
+  }
+  slice->used_data = size;
+  slice->source_ip = packet->source_ip;
+  slice->source_port = packet->source_port;
+  slice->rx_ticks = packet->rx_ticks;
+  slice->priority = packet->priority;
+  return slice;
+}
+
 bool xbot::service::packet::packetAppendData(PacketPtr packet, const void *buffer, size_t size) {
   if (packet == nullptr) return false;
   // Data won't fit.
   if (size + packet->used_data > config::max_packet_size) return false;
 
+  packetMakeWritable(packet);
   memcpy(packet->buffer + packet->used_data, buffer, size);
   packet->used_data += size;
 
@@ -50,7 +278,7 @@ bool xbot::service::packet::packetAppendData(PacketPtr packet, const void *buffe
 
 bool xbot::service::packet::packetGetData(PacketPtr packet, void **buffer, size_t *size) {
   if (packet == nullptr) return false;
-  *buffer = packet->buffer;
+  *buffer = packet->data;
   *size = packet->used_data;
   return true;
 }
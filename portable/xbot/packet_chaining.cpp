@@ -0,0 +1,40 @@
+//
+// Switch for the TX coalescing, see xbot/packet_chaining.hpp.
+//
+#include <ulog.h>
+
+#include <xbot/packet_chaining.hpp>
+
+namespace xbot::packet_chaining {
+
+// Written by the IO thread
+static bool tx_coalescing_ = false;
+// Sender of the last chained datagram, the host session which enabled coalescing
+static uint32_t peer_ip_ = 0;
+static uint16_t peer_port_ = 0;
+
+void SetTxCoalescing(bool enabled) {
+  tx_coalescing_ = enabled;
+  if (!enabled) {
+    detail::FlushTxFrame();
+  }
+}
+
+bool IsTxCoalescing() {
+  return tx_coalescing_;
+}
+
+void detail::OnChainedDatagram(uint32_t ip, uint16_t port) {
+  peer_ip_ = ip;
+  peer_port_ = port;
+  tx_coalescing_ = true;
+}
+
+void detail::OnServicePacket(uint32_t ip, uint16_t port) {
+  if (tx_coalescing_ && (ip != peer_ip_ || port != peer_port_)) {
+    ULOG_INFO("Service packet from another host endpoint, disabling TX coalescing");
+    SetTxCoalescing(false);
+  }
+}
+
+}  // namespace xbot::packet_chaining
@@ -2,6 +2,8 @@
 // Created by clemens on 3/21/24.
 //
 #include <xbot-service/portable/queue.hpp>
+#include <xbot/io_diagnostics.hpp>
+#include <xbot/io_priority.hpp>
 
 bool xbot::service::queue::initialize(QueuePtr queue, size_t queue_length, void* buffer, size_t buffer_size) {
   (void)queue_length;
@@ -19,7 +21,18 @@ bool xbot::service::queue::queuePopItem(QueuePtr queue, void** result, uint32_t
 }
 
 bool xbot::service::queue::queuePushItem(QueuePtr queue, void* item) {
-  return chMBPostTimeout(queue, reinterpret_cast<msg_t>(item), TIME_MS2I(10)) == MSG_OK;
+  // Try without waiting first, so a full queue shows up in the IO diagnostics.
+  // The IO thread doesn't wait for bulk services, that would hold back the priority lane.
+  const msg_t msg = reinterpret_cast<msg_t>(item);
+  const bool blocked = chMBPostTimeout(queue, msg, TIME_IMMEDIATE) != MSG_OK;
+  const bool posted =
+      !blocked || (io_priority::detail::QueueMayWait() && chMBPostTimeout(queue, msg, TIME_MS2I(10)) == MSG_OK);
+
+  chSysLock();
+  const size_t fill = chMBGetUsedCountI(queue);
+  chSysUnlock();
+  io_diagnostics::detail::OnQueuePush(blocked, posted, fill);
+  return posted;
 }
 
 void xbot::service::queue::deinitialize(QueuePtr queue) {
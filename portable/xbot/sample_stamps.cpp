@@ -0,0 +1,42 @@
+//
+// Capture times of the samples in service outputs, see xbot/sample_stamps.hpp.
+//
+#include <atomic>
+#include <xbot-service/Io.hpp>
+#include <xbot/datatypes/XbotHeader.hpp>
+#include <xbot/sample_stamps.hpp>
+#include <xbot/time_sync.hpp>
+#include <xbot/timebase.hpp>
+
+namespace xbot::sample_stamps {
+
+static std::atomic<uint32_t> sequence_[static_cast<size_t>(Source::COUNT)]{};
+
+bool Send(uint16_t service_id, Source source, uint64_t capture_ticks) {
+  const auto index = static_cast<size_t>(source);
+  uint32_t ip = 0;
+  uint16_t port = 0;
+  if (index >= static_cast<size_t>(Source::COUNT) || capture_ticks == 0 || !time_sync::GetHost(&ip, &port)) {
+    return false;
+  }
+  // Stamps are not worth waiting for, an output without one is still usable
+  service::packet::PacketPtr packet = service::packet::tryAllocatePacket(false);
+  if (packet == nullptr) {
+    return false;
+  }
+  const uint64_t host_ns = time_sync::ToHostNanos(capture_ticks);
+  const Stamp stamp{service_id,
+                    source,
+                    static_cast<uint8_t>(host_ns != 0),
+                    sequence_[index].fetch_add(1, std::memory_order_relaxed),
+                    timebase::TicksToNanos(capture_ticks),
+                    host_ns};
+  datatypes::XbotHeader header{};
+  header.service_id = SAMPLE_STAMP_SERVICE_ID;
+  header.payload_size = sizeof(stamp);
+  service::packet::packetAppendData(packet, &header, sizeof(header));
+  service::packet::packetAppendData(packet, &stamp, sizeof(stamp));
+  return service::Io::transmitPacket(packet, ip, port);
+}
+
+}  // namespace xbot::sample_stamps
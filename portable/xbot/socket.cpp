@@ -1,20 +1,34 @@
 //
 // Created by clemens on 3/21/24.
 //
+// On the target, sockets use the lwIP raw UDP API: large received pbufs are handed to the services without
+// copying (a few at a time, see MAX_HELD_RX_PBUFS), and packets are sent from their own buffer (the headers
+// go into the packet's headroom) and returned to the pool when lwIP is done with them.
+// The host simulation uses BSD sockets.
+//
+#ifdef HOSTSIM
 #include <lwip/sockets.h>
-#include <pthread.h>
-#include <sys/types.h>
-#include <unistd.h>
+#else
+#include <lwip/ip4_addr.h>
+#include <lwip/pbuf.h>
+#include <lwip/tcpip.h>
+#include <lwip/udp.h>
+#endif
 
+#include <cstddef>
 #include <cstdio>
 #include <cstring>
 #include <xbot-service/portable/socket.hpp>
 
 #include "xbot/config.hpp"
+#include "xbot/io_priority.hpp"
+#include "xbot/timebase.hpp"
 
 using namespace xbot::service::sock;
 using namespace xbot::service::packet;
 
+#ifdef HOSTSIM
+
 bool xbot::service::sock::initialize(SocketPtr socket_ptr, bool bind_multicast, const char* bind_address) {
   chDbgAssert(!bind_multicast, "Multicast is not supported on the MAC implementation");
   chDbgAssert(strcmp(bind_address, "0.0.0.0") == 0, "bind_address not supported on this platform");
@@ -69,17 +83,24 @@ bool xbot::service::sock::receivePacket(SocketPtr socket, PacketPtr* packet) {
     return false;
   }
   pkt->used_data = recvLen;
+  pkt->source_ip = ntohl(fromAddr.sin_addr.s_addr);
+  pkt->source_port = ntohs(fromAddr.sin_port);
+  pkt->rx_ticks = timebase::NowTicks();
+  pkt->priority = io_priority::detail::IsPriorityDatagram(pkt->data, pkt->used_data);
   *packet = pkt;
   return true;
 }
 
 bool xbot::service::sock::transmitPacket(SocketPtr socket, PacketPtr packet, uint32_t ip, uint16_t port) {
+  if (packet == nullptr) {
+    return false;
+  }
   sockaddr_in addr{};
   addr.sin_family = AF_INET;
   addr.sin_port = htons(port);
   addr.sin_addr.s_addr = htonl(ip);
 
-  sendto(*static_cast<int*>(socket), packet->buffer, packet->used_data, 0, reinterpret_cast<const sockaddr*>(&addr),
+  sendto(*static_cast<int*>(socket), packet->data, packet->used_data, 0, reinterpret_cast<const sockaddr*>(&addr),
          sizeof(addr));
 
   freePacket(packet);
@@ -116,3 +137,169 @@ bool xbot::service::sock::closeSocket(SocketPtr socket) {
   }
   return true;
 }
+#else
+
+static_assert(TX_HEADROOM >= LWIP_MEM_ALIGN_SIZE(PBUF_TRANSPORT), "Packet headroom too small for the lwIP headers");
+static_assert(LWIP_TCPIP_CORE_LOCKING, "Sockets call the raw API from the service threads");
+static_assert(LWIP_SUPPORT_CUSTOM_PBUF, "Sockets need custom pbufs");
+static_assert(MAX_HELD_RX_PBUFS <= PBUF_POOL_SIZE / 4, "Held RX pbufs would starve the MAC receive pool");
+
+// Smaller datagrams are copied, the pbuf goes straight back to the MAC
+static constexpr u16_t ZERO_COPY_MIN_SIZE = 256;
+
+// Called by the tcpip thread for every datagram
+static void onReceive(void* arg, udp_pcb* pcb, pbuf* p, const ip_addr_t* addr, u16_t port) {
+  (void)pcb;
+  auto* socket = static_cast<UdpSocket*>(arg);
+  const uint64_t rx_ticks = xbot::timebase::NowTicks();
+  const u16_t size = p->tot_len;
+
+  // Classify before allocating, bulk traffic can't take the packets reserved for the priority lane
+  const bool priority =
+      p->next == nullptr && xbot::io_priority::detail::IsPriorityDatagram(static_cast<uint8_t*>(p->payload), size);
+
+  // Don't block the tcpip thread if the services are behind, drop instead
+  const PacketPtr pkt = size <= xbot::config::max_packet_size ? tryAllocatePacket(priority) : nullptr;
+  if (pkt == nullptr) {
+    pbuf_free(p);
+    socket->rx_dropped++;
+    return;
+  }
+  // Hand out large datagrams in the pbuf itself, as long as enough pbufs are left for the MAC
+  if (size < ZERO_COPY_MIN_SIZE || !packetHoldRxPbuf(pkt, p)) {
+    pbuf_copy_partial(p, pkt->buffer, size, 0);
+    pbuf_free(p);
+  }
+  pkt->used_data = size;
+  pkt->source_ip = lwip_ntohl(ip4_addr_get_u32(ip_2_ip4(addr)));
+  pkt->source_port = port;
+  pkt->rx_ticks = rx_ticks;
+
+  mailbox_t* lane = priority ? &socket->rx_priority_mailbox : &socket->rx_mailbox;
+  if (chMBPostTimeout(lane, reinterpret_cast<msg_t>(pkt), TIME_IMMEDIATE) != MSG_OK) {
+    freePacket(pkt);
+    socket->rx_dropped++;
+    return;
+  }
+  chSemSignal(&socket->rx_available);
+}
+
+// Called by lwIP when the last reference to a sent packet is gone
+static void onTransmitDone(pbuf* p) {
+  auto* custom = reinterpret_cast<pbuf_custom*>(p);
+  freePacket(reinterpret_cast<PacketPtr>(reinterpret_cast<uint8_t*>(custom) - offsetof(Packet, tx_pbuf)));
+}
+
+bool xbot::service::sock::initialize(SocketPtr socket_ptr, bool bind_multicast, const char* bind_address) {
+  chDbgAssert(!bind_multicast, "Multicast is not supported on the MAC implementation");
+  chDbgAssert(strcmp(bind_address, "0.0.0.0") == 0, "bind_address not supported on this platform");
+  chMBObjectInit(&socket_ptr->rx_mailbox, socket_ptr->rx_mailbox_buffer, RX_QUEUE_LENGTH);
+  chMBObjectInit(&socket_ptr->rx_priority_mailbox, socket_ptr->rx_priority_mailbox_buffer, RX_PRIORITY_QUEUE_LENGTH);
+  chSemObjectInit(&socket_ptr->rx_available, 0);
+  socket_ptr->rx_dropped = 0;
+
+  LOCK_TCPIP_CORE();
+  udp_pcb* pcb = udp_new();
+  // Bind to an ephemeral port right away, so getEndpoint() knows it before the first packet is sent
+  if (pcb != nullptr && udp_bind(pcb, IP4_ADDR_ANY, 0) != ERR_OK) {
+    udp_remove(pcb);
+    pcb = nullptr;
+  }
+  if (pcb != nullptr) {
+    udp_recv(pcb, onReceive, socket_ptr);
+  }
+  UNLOCK_TCPIP_CORE();
+
+  socket_ptr->pcb = pcb;
+  return pcb != nullptr;
+}
+
+void xbot::service::sock::deinitialize(SocketPtr socket) {
+  closeSocket(socket);
+}
+
+bool xbot::service::sock::subscribeMulticast(SocketPtr socket, const char* ip) {
+  (void)socket;
+  (void)ip;
+  chDbgAssert(false, "multicast not supported");
+  return false;
+}
+
+bool xbot::service::sock::receivePacket(SocketPtr socket, PacketPtr* packet) {
+  // Same timeout as the former SO_RCVTIMEO, so the IO thread wakes up regularly
+  if (chSemWaitTimeout(&socket->rx_available, TIME_S2I(1)) != MSG_OK) {
+    return false;
+  }
+  msg_t msg;
+  if (chMBFetchTimeout(&socket->rx_priority_mailbox, &msg, TIME_IMMEDIATE) != MSG_OK &&
+      chMBFetchTimeout(&socket->rx_mailbox, &msg, TIME_IMMEDIATE) != MSG_OK) {
+    return false;
+  }
+  *packet = reinterpret_cast<PacketPtr>(msg);
+  return true;
+}
+
+bool xbot::service::sock::transmitPacket(SocketPtr socket, PacketPtr packet, uint32_t ip, uint16_t port) {
+  if (packet == nullptr) {
+    return false;
+  }
+  // Replies built in a received packet are copied out of the pbuf first
+  packetMakeWritable(packet);
+
+  packet->tx_pbuf.custom_free_function = onTransmitDone;
+  constexpr u16_t header_space = LWIP_MEM_ALIGN_SIZE(PBUF_TRANSPORT);
+  pbuf* p = pbuf_alloced_custom(PBUF_TRANSPORT, packet->used_data, PBUF_RAM, &packet->tx_pbuf,
+                                packet->buffer - header_space, header_space + packet->used_data);
+  if (p == nullptr) {
+    freePacket(packet);
+    return false;
+  }
+
+  ip_addr_t addr{};
+  ip_addr_set_ip4_u32(&addr, lwip_htonl(ip));
+  LOCK_TCPIP_CORE();
+  udp_sendto(socket->pcb, p, &addr, port);
+  // Frees the packet, unless lwIP still holds a reference (e.g. queued for ARP resolution)
+  pbuf_free(p);
+  UNLOCK_TCPIP_CORE();
+
+  return true;
+}
+
+bool xbot::service::sock::transmitPacket(SocketPtr socket, PacketPtr packet, const char* ip, uint16_t port) {
+  ip4_addr_t addr{};
+  if (!ip4addr_aton(ip, &addr)) {
+    freePacket(packet);
+    return false;
+  }
+  return transmitPacket(socket, packet, lwip_ntohl(ip4_addr_get_u32(&addr)), port);
+}
+
+bool xbot::service::sock::getEndpoint(SocketPtr socket, char* ip, size_t ip_len, uint16_t* port) {
+  if (socket == nullptr || socket->pcb == nullptr || ip == nullptr || port == nullptr) return false;
+
+  const char* addrStr = ip4addr_ntoa(netif_ip4_addr(netif_default));
+  if (strlen(addrStr) >= ip_len) return false;
+
+  strncpy(ip, addrStr, ip_len);
+
+  *port = socket->pcb->local_port;
+
+  return true;
+}
+
+bool xbot::service::sock::closeSocket(SocketPtr socket) {
+  if (socket == nullptr || socket->pcb == nullptr) return true;
+  LOCK_TCPIP_CORE();
+  udp_remove(socket->pcb);
+  UNLOCK_TCPIP_CORE();
+  socket->pcb = nullptr;
+  // Release what was received but not picked up
+  msg_t msg;
+  while (chMBFetchTimeout(&socket->rx_priority_mailbox, &msg, TIME_IMMEDIATE) == MSG_OK ||
+         chMBFetchTimeout(&socket->rx_mailbox, &msg, TIME_IMMEDIATE) == MSG_OK) {
+    freePacket(reinterpret_cast<PacketPtr>(msg));
+  }
+  return true;
+}
+#endif
@@ -13,6 +13,7 @@
 #include <xbot-service/portable/mutex.hpp>
 #include <xbot-service/portable/system.hpp>
 #include <xbot/packet_impl.hpp>
+#include <xbot/timebase.hpp>
 
 #include "ch.h"
 
@@ -69,7 +70,8 @@ void initSystem(uint32_t node_id) {
 }
 
 uint32_t getTimeMicros() {
-  return TIME_I2US(chVTGetSystemTimeX());
+  // Lower 32 bits of the 64-bit timebase, deltas stay valid across the wrap
+  return static_cast<uint32_t>(timebase::NowMicros());
 }
 
 bool getNodeId(uint8_t *id, size_t id_len) {
@@ -1,16 +1,31 @@
-
 #include <xbot-service/portable/thread.hpp>
+#include <xbot/deadlines.hpp>
 
 using namespace xbot::service::thread;
 
-bool xbot::service::thread::initialize(ThreadPtr thread, void (*threadfunc)(void*), void* arg, void* stackbuf,
-                                       size_t buflen, const char* name) {
-  // Create a multicast sender thread
-  *thread = chThdCreateStatic(stackbuf, buflen, NORMALPRIO, threadfunc, arg);
+// Role of a service thread, see xbot/deadlines.hpp
+static tprio_t priorityFor(void* arg) {
+  using namespace xbot::deadlines;
+  Role role;
+  if (FindAssignedThread(arg, &role)) {
+    return PriorityOf(role);
+  }
+  return NORMALPRIO;
+}
+
+bool xbot::service::thread::initializeWithPriority(thread_t** thread, void (*threadfunc)(void*), void* arg,
+                                                   void* stackbuf, size_t buflen, const char* name,
+                                                   tprio_t priority) {
+  *thread = chThdCreateStatic(stackbuf, buflen, priority, threadfunc, arg);
   (*thread)->name = name;
   return true;
 }
 
+bool xbot::service::thread::initialize(ThreadPtr thread, void (*threadfunc)(void*), void* arg, void* stackbuf,
+                                       size_t buflen, const char* name) {
+  return initializeWithPriority(thread, threadfunc, arg, stackbuf, buflen, name, priorityFor(arg));
+}
+
 void xbot::service::thread::deinitialize(ThreadPtr thread) {
   (void)thread;
   // Currently not implemented, since we should probably rather reset the MCU
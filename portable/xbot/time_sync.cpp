@@ -0,0 +1,115 @@
+//
+// Clock synchronization with the host, see xbot/time_sync.hpp.
+//
+#include <ulog.h>
+
+#include <xbot/time_sync.hpp>
+#include <xbot/timebase.hpp>
+
+#include "ch.h"
+
+namespace xbot::time_sync {
+
+// Exchanges which took this much longer than the best recent one were delayed by queuing, drop them
+static constexpr int64_t MAX_EXTRA_ROUND_TRIP_NS = 200'000;
+// Let the best round trip relax on every rejected exchange, so a permanently slower path is accepted again
+static constexpr int64_t ROUND_TRIP_RELAX_NS = 5'000;
+// An offset error larger than this (e.g. the host clock was set) restarts the estimate
+static constexpr int64_t MAX_OFFSET_STEP_NS = 10'000'000;
+// PI servo gains
+static constexpr double OFFSET_GAIN = 0.3;
+static constexpr double DRIFT_GAIN = 0.05;
+
+// Written by the IO thread, read by anyone with the system locked
+static Estimate estimate_{};
+static int64_t best_round_trip_ns_ = INT64_MAX;
+// Sender of the SYNC messages and their last sequence number
+static bool has_host_ = false;
+static uint32_t host_ip_ = 0;
+static uint16_t host_port_ = 0;
+static uint32_t last_sequence_ = 0;
+
+void detail::AddSample(uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4) {
+  const int64_t round_trip =
+      (static_cast<int64_t>(t4) - static_cast<int64_t>(t1)) - (static_cast<int64_t>(t3) - static_cast<int64_t>(t2));
+  const int64_t measured_offset =
+      ((static_cast<int64_t>(t1) - static_cast<int64_t>(t2)) + (static_cast<int64_t>(t4) - static_cast<int64_t>(t3))) /
+      2;
+  // Board time at which the offset was measured
+  const uint64_t board_ns = t2 + (t3 - t2) / 2;
+
+  Estimate estimate = GetEstimate();
+  const bool delayed = best_round_trip_ns_ != INT64_MAX && round_trip > best_round_trip_ns_ + MAX_EXTRA_ROUND_TRIP_NS;
+  if (round_trip < 0 || delayed) {
+    // Nothing to relax before the first accepted exchange
+    if (best_round_trip_ns_ != INT64_MAX) {
+      best_round_trip_ns_ += ROUND_TRIP_RELAX_NS;
+    }
+    estimate.rejected++;
+  } else {
+    if (round_trip < best_round_trip_ns_) {
+      best_round_trip_ns_ = round_trip;
+    }
+    const double elapsed = static_cast<double>(static_cast<int64_t>(board_ns - estimate.reference_ns));
+    const double predicted = static_cast<double>(estimate.offset_ns) + estimate.drift_ppb * 1e-9 * elapsed;
+    const double error = static_cast<double>(measured_offset) - predicted;
+    if (!estimate.valid || elapsed <= 0 || error > MAX_OFFSET_STEP_NS || error < -MAX_OFFSET_STEP_NS) {
+      if (estimate.valid) {
+        ULOG_WARNING("Time sync: offset step of %d us, restarting", static_cast<int>(error / 1000));
+      }
+      estimate.offset_ns = measured_offset;
+      estimate.drift_ppb = 0;
+      estimate.valid = true;
+    } else {
+      estimate.offset_ns = static_cast<int64_t>(predicted + OFFSET_GAIN * error);
+      estimate.drift_ppb += DRIFT_GAIN * error / elapsed * 1e9;
+    }
+    estimate.reference_ns = board_ns;
+    estimate.round_trip_ns = static_cast<uint32_t>(round_trip);
+    estimate.accepted++;
+  }
+
+  chSysLock();
+  estimate_ = estimate;
+  chSysUnlock();
+}
+
+Estimate GetEstimate() {
+  const syssts_t sts = chSysGetStatusAndLockX();
+  const Estimate estimate = estimate_;
+  chSysRestoreStatusX(sts);
+  return estimate;
+}
+
+uint64_t ToHostNanos(uint64_t board_ticks) {
+  const Estimate estimate = GetEstimate();
+  if (!estimate.valid) {
+    return 0;
+  }
+  const uint64_t board_ns = timebase::TicksToNanos(board_ticks);
+  const double elapsed = static_cast<double>(static_cast<int64_t>(board_ns - estimate.reference_ns));
+  return board_ns + estimate.offset_ns + static_cast<int64_t>(estimate.drift_ppb * 1e-9 * elapsed);
+}
+
+bool GetHost(uint32_t* ip, uint16_t* port) {
+  chSysLock();
+  const bool has_host = has_host_;
+  *ip = host_ip_;
+  *port = host_port_;
+  chSysUnlock();
+  return has_host;
+}
+
+bool detail::OnSync(uint32_t ip, uint16_t port, uint32_t sequence) {
+  // A restarted host starts counting again, another one sends from a different endpoint
+  const bool new_session = !has_host_ || ip != host_ip_ || port != host_port_ || sequence < last_sequence_;
+  chSysLock();
+  has_host_ = true;
+  host_ip_ = ip;
+  host_port_ = port;
+  last_sequence_ = sequence;
+  chSysUnlock();
+  return new_session;
+}
+
+}  // namespace xbot::time_sync
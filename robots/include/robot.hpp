@@ -9,6 +9,7 @@
 #include <debug/debug_tcp_interface.hpp>
 #include <drivers/charger/charger.hpp>
 #include <limits>
+#include <services/diff_drive_service/wheel_speed_controller.hpp>
 
 // Forward declare ProtocolType from GpsServiceBase.hpp
 enum class ProtocolType : uint8_t;
@@ -27,6 +28,23 @@ class Robot {
     return nullptr;
   }
 
+  /**
+   * Return the rate at which the drive ESCs are asked for their status, in Hz (100 - 200).
+   * Each answer closes the speed loop of its wheel, so this is also the odometry rate.
+   * Raise it only if the ESC link can carry that many status frames.
+   */
+  virtual uint32_t DiffDrive_GetStatusRateHz() {
+    return 100;
+  }
+
+  /**
+   * Return the gains of the wheel speed controllers (duty per m/s, see wheel_speed_controller.hpp).
+   * kp = ki = kd = 0 drives the wheels open-loop with the feed-forward gain only.
+   */
+  virtual WheelSpeedController::Gains DiffDrive_GetSpeedControllerGains() {
+    return WheelSpeedController::DEFAULT_GAINS;
+  }
+
   /**
    * Return the default battery full voltage (i.e. this is considered 100% battery)
    */
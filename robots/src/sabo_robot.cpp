@@ -79,7 +79,7 @@ void SaboRobot::RegisterAdc1Sensors() {
 
   // V-Charge sensor
   static const Adc1Sensor v_charge_sensors[] = {{.channel = ADC_CHANNEL_IN15, .sample_rate = ADC_SMPR_SMP_16P5}};
-  static adcsample_t v_charge_buffer[sizeof(v_charge_sensors) / sizeof(v_charge_sensors[0])];
+  CC_SECTION(".nocache") static adcsample_t v_charge_buffer[sizeof(v_charge_sensors) / sizeof(v_charge_sensors[0])];
   // Create ADC conversion group and place sensor(s)
   static Adc1ConversionGroup v_charge_cg = Adc1ConversionGroup::Create(
       Adc1ConversionId::V_CHARGER,                          // Conversion ID
@@ -102,7 +102,7 @@ void SaboRobot::RegisterAdc1Sensors() {
 
   // V-Battery sensor
   static const Adc1Sensor v_battery_sensors[] = {{.channel = ADC_CHANNEL_IN16, .sample_rate = ADC_SMPR_SMP_16P5}};
-  static adcsample_t v_battery_buffer[sizeof(v_battery_sensors) / sizeof(v_battery_sensors[0])];
+  CC_SECTION(".nocache") static adcsample_t v_battery_buffer[sizeof(v_battery_sensors) / sizeof(v_battery_sensors[0])];
   // Create ADC conversion group and place sensor(s)
   static Adc1ConversionGroup v_battery_cg = Adc1ConversionGroup::Create(
       Adc1ConversionId::V_BATTERY,                           // Conversion ID
@@ -126,7 +126,7 @@ void SaboRobot::RegisterAdc1Sensors() {
 
   // I-IN-DCDC sensor
   static const Adc1Sensor i_dcdc_sensors[] = {{.channel = ADC_CHANNEL_IN18, .sample_rate = ADC_SMPR_SMP_16P5}};
-  static adcsample_t i_dcdc_buffer[sizeof(i_dcdc_sensors) / sizeof(i_dcdc_sensors[0])];
+  CC_SECTION(".nocache") static adcsample_t i_dcdc_buffer[sizeof(i_dcdc_sensors) / sizeof(i_dcdc_sensors[0])];
   // Create ADC conversion group and place sensor(s)
   static Adc1ConversionGroup i_dcdc_cg = Adc1ConversionGroup::Create(
       Adc1ConversionId::I_IN_DCDC,                        // Conversion ID
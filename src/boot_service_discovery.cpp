@@ -14,6 +14,7 @@
 
 #include "chprintf.h"
 #include "lwip/sockets.h"
+#include "thread_priorities.h"
 static char boardAdvertisementBuffer[100];
 static char boardAdvertisementRequestBuffer[100];
 static THD_WORKING_AREA(waServiceDiscovery, 512);
@@ -97,6 +98,6 @@ void InitBootloaderServiceDiscovery() {
 
   // Create a multicast sender thread
   thread_t *threadPointer =
-      chThdCreateStatic(waServiceDiscovery, sizeof(waServiceDiscovery), NORMALPRIO, multicast_sender_thread, NULL);
+      chThdCreateStatic(waServiceDiscovery, sizeof(waServiceDiscovery), THD_PRIO_DEBUG, multicast_sender_thread, NULL);
   threadPointer->name = "Boot SD";
 }
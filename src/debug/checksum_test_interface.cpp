@@ -13,6 +13,7 @@
 #include <cstring>
 
 #include "lwip/sockets.h"
+#include "thread_priorities.h"
 #include "ulog.h"
 
 namespace {
@@ -152,6 +153,6 @@ void ChecksumTestThread(void *) {
 }  // namespace
 
 void InitChecksumTestInterface() {
-  thread_t *tp = chThdCreateStatic(waChecksumTest, sizeof(waChecksumTest), NORMALPRIO, ChecksumTestThread, nullptr);
+  thread_t *tp = chThdCreateStatic(waChecksumTest, sizeof(waChecksumTest), THD_PRIO_DEBUG, ChecksumTestThread, nullptr);
   tp->name = "ChecksumTest";
 }
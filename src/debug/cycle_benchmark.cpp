@@ -0,0 +1,40 @@
+//
+// Lightweight cycle-count benchmark for hot paths (parsers, display flush, ...).
+//
+
+#include "cycle_benchmark.hpp"
+
+#ifdef CYCLE_BENCHMARK
+
+#include <ulog.h>
+
+namespace xbot::debug {
+
+void CycleStats::Add(uint32_t cycles, size_t bytes) {
+  calls_++;
+  cycles_ += cycles;
+  bytes_ += bytes;
+  if (cycles > max_cycles_) max_cycles_ = cycles;
+
+  systime_t now = chVTGetSystemTimeX();
+  if (last_report_ == 0) {
+    last_report_ = now;
+    return;
+  }
+  if (chTimeDiffX(last_report_, now) < TIME_MS2I(REPORT_INTERVAL_MS)) {
+    return;
+  }
+
+  ULOG_INFO("bench:%s %u calls, %u bytes, avg %u cyc/call (max %u), %.2f cyc/byte", name_, calls_,
+            static_cast<uint32_t>(bytes_), static_cast<uint32_t>(cycles_ / calls_), max_cycles_,
+            bytes_ > 0 ? static_cast<float>(cycles_) / static_cast<float>(bytes_) : 0.0f);
+  calls_ = 0;
+  cycles_ = 0;
+  bytes_ = 0;
+  max_cycles_ = 0;
+  last_report_ = now;
+}
+
+}  // namespace xbot::debug
+
+#endif  // CYCLE_BENCHMARK
@@ -0,0 +1,74 @@
+//
+// Lightweight cycle-count benchmark for hot paths (parsers, display flush, ...).
+//
+// Uses the DWT cycle counter (chSysGetRealtimeCounterX(), enabled by the
+// ChibiOS port) and periodically logs calls, cycles/call and cycles/byte for
+// every instrumented path. Only compiled in with -DCYCLE_BENCHMARK=ON, all
+// macros are no-ops otherwise. Build once with and once without
+// -DDISABLE_DCACHE=ON to compare the effect of the D-Cache.
+//
+
+#ifndef CYCLE_BENCHMARK_HPP
+#define CYCLE_BENCHMARK_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ch.h"
+
+#ifdef CYCLE_BENCHMARK
+
+namespace xbot::debug {
+
+class CycleStats {
+ public:
+  explicit CycleStats(const char* name) : name_(name) {
+  }
+
+  // Accounts one call which took the given number of cycles and processed bytes.
+  // Logs and resets the statistics every report interval.
+  void Add(uint32_t cycles, size_t bytes);
+
+ private:
+  static constexpr uint32_t REPORT_INTERVAL_MS = 10000;
+
+  const char* name_;
+  uint32_t calls_ = 0;
+  uint64_t cycles_ = 0;
+  uint64_t bytes_ = 0;
+  uint32_t max_cycles_ = 0;
+  systime_t last_report_ = 0;
+};
+
+class CycleScope {
+ public:
+  CycleScope(CycleStats& stats, size_t bytes) : stats_(stats), bytes_(bytes), start_(chSysGetRealtimeCounterX()) {
+  }
+  ~CycleScope() {
+    stats_.Add(chSysGetRealtimeCounterX() - start_, bytes_);
+  }
+
+ private:
+  CycleStats& stats_;
+  size_t bytes_;
+  rtcnt_t start_;
+};
+
+}  // namespace xbot::debug
+
+// Declares a (static) statistics instance
+#define CYCLE_BENCHMARK_STATS(var, name) static xbot::debug::CycleStats var{name}
+// Accounts the cycles until the end of the current scope
+#define CYCLE_BENCHMARK_SCOPE(var, bytes) xbot::debug::CycleScope var##_scope_{var, bytes}
+// Accounts the cycles since start (a chSysGetRealtimeCounterX() value), for spans crossing threads/ISRs
+#define CYCLE_BENCHMARK_ADD(var, start, bytes) var.Add(chSysGetRealtimeCounterX() - (start), bytes)
+
+#else
+
+#define CYCLE_BENCHMARK_STATS(var, name)
+#define CYCLE_BENCHMARK_SCOPE(var, bytes)
+#define CYCLE_BENCHMARK_ADD(var, start, bytes)
+
+#endif  // CYCLE_BENCHMARK
+
+#endif  // CYCLE_BENCHMARK_HPP
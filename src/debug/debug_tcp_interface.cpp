@@ -7,6 +7,7 @@
 #include <cstddef>
 
 #include "lwip/sockets.h"
+#include "thread_priorities.h"
 
 DebugTCPInterface::DebugTCPInterface(uint16_t listen_port, DebuggableDriver *driver) {
   chDbgAssert(listen_port > 0, "port invalid");
@@ -19,7 +20,7 @@ void DebugTCPInterface::Start() {
   driver_->SetRawDataCallback(
       etl::delegate<void(const uint8_t *, size_t)>::create<DebugTCPInterface, &DebugTCPInterface::OnRawDriverData>(
           *this));
-  chThdCreateStatic(waThread, sizeof(waThread), NORMALPRIO, &ThreadFuncHelper, this);
+  chThdCreateStatic(waThread, sizeof(waThread), THD_PRIO_DEBUG, &ThreadFuncHelper, this);
 }
 
 void DebugTCPInterface::ThreadFunc() {
@@ -7,6 +7,7 @@
 #include <cstddef>
 
 #include "lwip/sockets.h"
+#include "thread_priorities.h"
 #include "ulog.h"
 
 DebugUDPInterface::DebugUDPInterface(uint16_t listen_port, DebuggableDriver *driver) {
@@ -20,7 +21,7 @@ void DebugUDPInterface::Start() {
   driver_->SetRawDataCallback(
       etl::delegate<void(const uint8_t *, size_t)>::create<DebugUDPInterface, &DebugUDPInterface::OnRawDriverData>(
           *this));
-  chThdCreateStatic(waThread, sizeof(waThread), NORMALPRIO, &ThreadFuncHelper, this);
+  chThdCreateStatic(waThread, sizeof(waThread), THD_PRIO_DEBUG, &ThreadFuncHelper, this);
 }
 
 void DebugUDPInterface::ThreadFunc() {
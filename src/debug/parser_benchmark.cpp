@@ -0,0 +1,429 @@
+//
+// Throughput benchmark for the wire-protocol parsers, see parser_benchmark.hpp.
+//
+
+#include "parser_benchmark.hpp"
+
+#include "ch.h"
+#include "hal.h"
+
+#ifdef PARSER_BENCHMARK
+
+#include <etl/crc16_ccitt.h>
+#include <ulog.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include "drivers/gps/nmea_gps_driver.h"
+#include "drivers/gps/ublox_gps_driver.h"
+#include "drivers/motor/vesc/VescDriver.h"
+#include "drivers/motor/vesc/buffer.h"
+#include "drivers/motor/vesc/crc.h"
+#include "drivers/motor/vesc/datatypes.h"
+#include "drivers/motor/yfr4esc/YFR4escDriver.h"
+#include "drivers/motor/yfr4esc/cobs.h"
+#include "drivers/motor/yfr4esc/crc16_hw.hpp"
+#ifndef HOSTSIM
+// The cover UI driver depends on the services / robot layer, which is not part of the HostSim build
+#include "drivers/ui/yf_cover_ui/yf_cover_ui.hpp"
+#endif
+
+namespace xbot::debug {
+
+using driver::gps::GpsDriver;
+using driver::gps::NmeaGpsDriver;
+using driver::gps::UbxGpsDriver;
+using driver::gps::UbxNavPvt;
+using driver::motor::MotorDriver;
+using driver::motor::VescDriver;
+using driver::motor::YFR4escDriver;
+
+namespace {
+// Parser instances, never started (no UART, no thread)
+UbxGpsDriver ubx_driver_{};
+NmeaGpsDriver nmea_driver_{};
+VescDriver vesc_driver_{};
+YFR4escDriver yfr4esc_driver_{};
+#ifndef HOSTSIM
+driver::ui::YFCoverUI yf_cover_ui_{};
+#endif
+bool initialized_ = false;
+
+uint32_t decoded_ = 0;
+
+// One pass of a synthetic stream, replayed until STREAM_TOTAL_BYTES were processed
+uint8_t stream_[8192];
+constexpr uint64_t STREAM_TOTAL_BYTES = 512 * 1024;
+constexpr size_t MAX_FRAGMENT_SIZE = 64;
+
+// Deterministic xorshift32, so that runs are comparable
+uint32_t rng_state_ = 0x12345678;
+uint32_t Random() {
+  rng_state_ ^= rng_state_ << 13;
+  rng_state_ ^= rng_state_ >> 17;
+  rng_state_ ^= rng_state_ << 5;
+  return rng_state_;
+}
+
+void OnGpsState(const GpsDriver::GpsState&) {
+  decoded_++;
+}
+
+void OnEscState(const MotorDriver::ESCState&) {
+  decoded_++;
+}
+
+size_t UbxFrame(uint32_t seq, uint8_t* out) {
+  UbxNavPvt pvt{};
+  pvt.iTOW = seq * 200;
+  pvt.fixType = UbxNavPvt::FIX_TYPE_3D;
+  pvt.flags = UbxNavPvt::FLAGS_GNSS_FIX_OK | UbxNavPvt::FLAGS_DIFF_SOLN | UbxNavPvt::CARRIER_PHASE_FIXED;
+  pvt.numSV = 24;
+  pvt.lat = 481173000 + static_cast<int32_t>(seq % 1000);
+  pvt.lon = 115167000 + static_cast<int32_t>(seq % 1000);
+  pvt.hMSL = 545400;
+  pvt.hAcc = 14;
+  pvt.vAcc = 20;
+  pvt.velN = 350;
+  pvt.velE = -120;
+  pvt.headMot = 9000000;
+  pvt.headAcc = 250000;
+
+  const uint16_t len = sizeof(UbxNavPvt);
+  out[0] = 0xB5;
+  out[1] = 0x62;
+  out[2] = UbxNavPvt::CLASS_ID;
+  out[3] = UbxNavPvt::MESSAGE_ID;
+  out[4] = len & 0xFF;
+  out[5] = len >> 8;
+  memcpy(&out[6], &pvt, len);
+  uint8_t ck_a = 0, ck_b = 0;
+  for (size_t i = 2; i < 6u + len; i++) {
+    ck_a += out[i];
+    ck_b += ck_a;
+  }
+  out[6 + len] = ck_a;
+  out[7 + len] = ck_b;
+  return len + 8;
+}
+
+size_t NmeaSentence(const char* body, uint8_t* out) {
+  uint8_t checksum = 0;
+  for (const char* c = body; *c != '\0'; c++) {
+    checksum ^= static_cast<uint8_t>(*c);
+  }
+  return snprintf(reinterpret_cast<char*>(out), 100, "$%s*%02X\r\n", body, checksum);
+}
+
+size_t NmeaFrame(uint32_t seq, uint8_t* out) {
+  char body[90];
+  const unsigned sec = seq % 60;
+  if (seq % 2 == 0) {
+    snprintf(body, sizeof(body), "GNGGA,1235%02u.00,4807.03812,N,01131.00012,E,4,24,0.6,545.4,M,46.9,M,1.0,0000",
+             sec);
+  } else {
+    snprintf(body, sizeof(body), "GNRMC,1235%02u.00,A,4807.03812,N,01131.00012,E,0.55,84.4,230394,,,R,V", sec);
+  }
+  return NmeaSentence(body, out);
+}
+
+size_t VescFrame(uint32_t seq, uint8_t* out) {
+  uint8_t payload[64];
+  int32_t index = 0;
+  payload[index++] = COMM_GET_VALUES;
+  buffer_append_float16(payload, 35.2f, 10.0f, &index);             // temp fet
+  buffer_append_float16(payload, 28.7f, 10.0f, &index);             // temp motor
+  buffer_append_float32(payload, 1.25f, 100.0f, &index);            // avg motor current
+  buffer_append_float32(payload, 0.85f, 100.0f, &index);            // avg input current
+  buffer_append_float32(payload, 0.0f, 100.0f, &index);             // avg id
+  buffer_append_float32(payload, 1.2f, 100.0f, &index);             // avg iq
+  buffer_append_float16(payload, 0.35f, 1000.0f, &index);           // duty
+  buffer_append_float32(payload, 1500.0f, 1.0f, &index);            // rpm
+  buffer_append_float16(payload, 28.4f, 10.0f, &index);             // v in
+  buffer_append_float32(payload, 0.1f, 10000.0f, &index);           // amp hours
+  buffer_append_float32(payload, 0.0f, 10000.0f, &index);           // amp hours charged
+  buffer_append_float32(payload, 2.5f, 10000.0f, &index);           // watt hours
+  buffer_append_float32(payload, 0.0f, 10000.0f, &index);           // watt hours charged
+  buffer_append_int32(payload, static_cast<int32_t>(seq), &index);  // tacho
+  buffer_append_int32(payload, static_cast<int32_t>(seq), &index);  // tacho abs
+  payload[index++] = 0;                                             // fault
+  buffer_append_int32(payload, 0, &index);                          // pid pos
+
+  size_t pos = 0;
+  out[pos++] = 0x02;
+  out[pos++] = static_cast<uint8_t>(index);
+  memcpy(&out[pos], payload, index);
+  pos += index;
+  const uint16_t crc = crc16(payload, index);
+  out[pos++] = crc >> 8;
+  out[pos++] = crc & 0xFF;
+  out[pos++] = 0x03;
+  return pos;
+}
+
+size_t Yfr4escFrame(uint32_t seq, uint8_t* out) {
+  driver::motor::yfr4esc::StatusPacket sp{};
+  sp.message_type = driver::motor::yfr4esc::MessageType::STATUS;
+  sp.seq = seq;
+  sp.fw_version_major = 1;
+  sp.fw_version_minor = 2;
+  sp.temperature_pcb = 31.5;
+  sp.current_input = 0.42;
+  sp.duty_cycle = 0.3;
+  sp.tacho = seq;
+  sp.tacho_absolute = seq;
+  sp.rpm = 1200;
+  sp.fault_code = 0;
+  sp.crc = yfr4esc_crc::crc16_ccitt_false(reinterpret_cast<const uint8_t*>(&sp), sizeof(sp) - sizeof(sp.crc));
+  size_t len = cobs_encode(reinterpret_cast<const uint8_t*>(&sp), sizeof(sp), out);
+  out[len++] = 0;
+  return len;
+}
+
+#ifndef HOSTSIM
+size_t YfCoverUiFrame(uint32_t seq, uint8_t* out) {
+  msg_get_version msg{};
+  msg.type = Get_Version;
+  msg.version = static_cast<uint16_t>(100 + seq % 10);
+  const auto* raw = reinterpret_cast<const uint8_t*>(&msg);
+  etl::crc16_ccitt crc;
+  crc.add(raw, raw + sizeof(msg) - sizeof(msg.crc));
+  msg.crc = crc.value();
+  size_t len = cobs_encode(raw, sizeof(msg), out);
+  out[len++] = 0;
+  return len;
+}
+#endif
+
+}  // namespace
+
+const char* ParserBenchmark::ParserName(Parser parser) {
+  switch (parser) {
+    case Parser::UBX: return "ubx";
+    case Parser::NMEA: return "nmea";
+    case Parser::VESC: return "vesc";
+    case Parser::YFR4ESC: return "yfr4esc";
+    case Parser::YF_COVER_UI: return "yf_ui";
+  }
+  return "?";
+}
+
+bool ParserBenchmark::IsAvailable(Parser parser) {
+#ifdef HOSTSIM
+  return parser != Parser::YF_COVER_UI;
+#else
+  (void)parser;
+  return true;
+#endif
+}
+
+size_t ParserBenchmark::DmaChunkSize(Parser parser) {
+  switch (parser) {
+    case Parser::UBX:
+    case Parser::NMEA: return GpsDriver::RECV_BUFFER_SIZE;
+    case Parser::VESC: return VescDriver::RECV_BUFFER_SIZE;
+    case Parser::YFR4ESC: return YFR4escDriver::DMA_RX_BUFFER_SIZE;
+#ifndef HOSTSIM
+    case Parser::YF_COVER_UI: return driver::ui::YFCoverUI::DMA_RX_BUFFER_SIZE;
+#else
+    case Parser::YF_COVER_UI: break;
+#endif
+  }
+  return MAX_FRAGMENT_SIZE;
+}
+
+uint32_t ParserBenchmark::CounterFrequency() {
+#ifdef HOSTSIM
+  // chSysGetRealtimeCounterX() counts nanoseconds on the host
+  return 1000000000;
+#else
+  return STM32_CORE_CK;
+#endif
+}
+
+const char* ParserBenchmark::CounterUnit() {
+#ifdef HOSTSIM
+  return "ns";
+#else
+  return "cyc";
+#endif
+}
+
+void ParserBenchmark::ResetParser(Parser parser) {
+  if (!initialized_) {
+    ubx_driver_.SetStateCallback(GpsDriver::StateCallback::create<OnGpsState>());
+    nmea_driver_.SetStateCallback(GpsDriver::StateCallback::create<OnGpsState>());
+    // The motor drivers only notify once started, only mark them as started (no UART, no thread)
+    vesc_driver_.SetStateCallback(MotorDriver::StateCallback::create<OnEscState>());
+    vesc_driver_.MotorDriver::Start();
+    yfr4esc_driver_.SetStateCallback(MotorDriver::StateCallback::create<OnEscState>());
+    yfr4esc_driver_.MotorDriver::Start();
+    initialized_ = true;
+  }
+  switch (parser) {
+    case Parser::UBX: static_cast<GpsDriver&>(ubx_driver_).ResetParserState(); break;
+    case Parser::NMEA: static_cast<GpsDriver&>(nmea_driver_).ResetParserState(); break;
+    case Parser::VESC: vesc_driver_.working_buffer_fill_ = 0; break;
+    case Parser::YFR4ESC: yfr4esc_driver_.cobs_rx_len_ = 0; break;
+#ifndef HOSTSIM
+    case Parser::YF_COVER_UI: yf_cover_ui_.rx_len_ = 0; break;
+#else
+    case Parser::YF_COVER_UI: break;
+#endif
+  }
+  decoded_ = 0;
+}
+
+void ParserBenchmark::Feed(Parser parser, const uint8_t* data, size_t len) {
+  switch (parser) {
+    case Parser::UBX: static_cast<GpsDriver&>(ubx_driver_).ProcessBytes(data, len); break;
+    case Parser::NMEA: static_cast<GpsDriver&>(nmea_driver_).ProcessBytes(data, len); break;
+    // The VESC parser only reads from the buffer, it's not const for historical reasons
+    case Parser::VESC: vesc_driver_.ProcessBytes(const_cast<uint8_t*>(data), len); break;
+    case Parser::YFR4ESC: yfr4esc_driver_.ProcessRxBytes(data, len); break;
+#ifndef HOSTSIM
+    case Parser::YF_COVER_UI: yf_cover_ui_.ProcessRxBytes(data, len); break;
+#else
+    case Parser::YF_COVER_UI: break;
+#endif
+  }
+}
+
+size_t ParserBenchmark::Generate(Parser parser, bool noise, uint8_t* buffer, size_t size, uint32_t& packets) {
+  // Large enough for the largest frame (NAV-PVT: 100 bytes) plus a noise burst
+  uint8_t frame[128];
+  size_t fill = 0;
+  packets = 0;
+  for (uint32_t seq = 0;; seq++) {
+    size_t len = 0;
+    switch (parser) {
+      case Parser::UBX: len = UbxFrame(seq, frame); break;
+      case Parser::NMEA: len = NmeaFrame(seq, frame); break;
+      case Parser::VESC: len = VescFrame(seq, frame); break;
+      case Parser::YFR4ESC: len = Yfr4escFrame(seq, frame); break;
+#ifndef HOSTSIM
+      case Parser::YF_COVER_UI: len = YfCoverUiFrame(seq, frame); break;
+#else
+      case Parser::YF_COVER_UI: return 0;
+#endif
+    }
+    bool valid = true;
+    if (noise) {
+      if (seq % 16 == 7) {
+        // Flip a bit in the body, the frame needs to be dropped by the CRC / framing check
+        frame[1 + Random() % (len - 2)] ^= 0x10;
+        valid = false;
+      }
+      if (seq % 4 == 3) {
+        // Line noise between two frames
+        const size_t garbage = 1 + Random() % 16;
+        for (size_t i = 0; i < garbage; i++) {
+          frame[len++] = static_cast<uint8_t>(Random());
+        }
+      }
+    }
+    if (fill + len > size) {
+      break;
+    }
+    memcpy(&buffer[fill], frame, len);
+    fill += len;
+    if (valid) {
+      packets++;
+    }
+  }
+  return fill;
+}
+
+ParserBenchmark::Result ParserBenchmark::Run(Parser parser, const char* scenario, const uint8_t* data, size_t len,
+                                             size_t chunk_size, uint32_t packets, uint32_t repeat) {
+  Result result{parser, scenario, 0, 0, 0, 0};
+  if (!IsAvailable(parser) || len == 0) {
+    return result;
+  }
+  ResetParser(parser);
+  for (uint32_t r = 0; r < repeat; r++) {
+    size_t pos = 0;
+    while (pos < len) {
+      size_t chunk = chunk_size > 0 ? chunk_size : 1 + Random() % MAX_FRAGMENT_SIZE;
+      if (chunk > len - pos) chunk = len - pos;
+      // Measure each call on its own, the 32 bit counter wraps after a few seconds
+      const rtcnt_t start = chSysGetRealtimeCounterX();
+      Feed(parser, &data[pos], chunk);
+      result.ticks += chSysGetRealtimeCounterX() - start;
+      pos += chunk;
+    }
+    result.bytes += len;
+  }
+  result.packets = packets > 0 ? packets * repeat : decoded_;
+  result.decoded = parser == Parser::YF_COVER_UI ? NOT_OBSERVABLE : decoded_;
+  return result;
+}
+
+void ParserBenchmark::RunAll(const ResultCallback& callback) {
+  static constexpr Parser PARSERS[] = {Parser::UBX, Parser::NMEA, Parser::VESC, Parser::YFR4ESC, Parser::YF_COVER_UI};
+  for (const Parser parser : PARSERS) {
+    if (!IsAvailable(parser)) {
+      continue;
+    }
+    uint32_t packets = 0;
+    size_t len = Generate(parser, false, stream_, sizeof(stream_), packets);
+    const uint32_t repeat = static_cast<uint32_t>((STREAM_TOTAL_BYTES + len - 1) / len);
+    callback(Run(parser, "clean", stream_, len, DmaChunkSize(parser), packets, repeat));
+    callback(Run(parser, "fragmented", stream_, len, 0, packets, repeat));
+    len = Generate(parser, true, stream_, sizeof(stream_), packets);
+    callback(Run(parser, "noise", stream_, len, DmaChunkSize(parser), packets, repeat));
+  }
+}
+
+void ParserBenchmark::LogResult(const Result& result) {
+  if (result.ticks == 0 || result.packets == 0) {
+    ULOG_WARNING("bench:%s %s: no data", ParserName(result.parser), result.scenario);
+    return;
+  }
+  const float seconds = static_cast<float>(result.ticks) / static_cast<float>(CounterFrequency());
+  const float mb_per_s = static_cast<float>(result.bytes) / seconds / 1e6f;
+  const float packets_per_s = static_cast<float>(result.packets) / seconds;
+  const auto ticks_per_packet = static_cast<uint32_t>(result.ticks / result.packets);
+  if (result.decoded == NOT_OBSERVABLE) {
+    ULOG_INFO("bench:%s %s: %.2f MB/s, %.0f pkt/s, %u %s/pkt", ParserName(result.parser), result.scenario, mb_per_s,
+              packets_per_s, static_cast<unsigned>(ticks_per_packet), CounterUnit());
+  } else {
+    ULOG_INFO("bench:%s %s: %.2f MB/s, %.0f pkt/s, %u %s/pkt (%u/%u decoded)", ParserName(result.parser),
+              result.scenario, mb_per_s, packets_per_s, static_cast<unsigned>(ticks_per_packet), CounterUnit(),
+              static_cast<unsigned>(result.decoded), static_cast<unsigned>(result.packets));
+  }
+}
+
+#ifndef HOSTSIM
+namespace {
+THD_WORKING_AREA(parser_benchmark_wa_, 2048);
+
+THD_FUNCTION(ParserBenchmarkThread, arg) {
+  (void)arg;
+  chRegSetThreadName("parser_bench");
+  // Let the system (and remote logging) settle first
+  chThdSleepSeconds(10);
+  ULOG_INFO("=== Parser benchmark (%u Hz counter) ===", static_cast<unsigned>(ParserBenchmark::CounterFrequency()));
+  ParserBenchmark::RunAll(ParserBenchmark::ResultCallback::create<&ParserBenchmark::LogResult>());
+}
+}  // namespace
+
+void InitParserBenchmark() {
+  chThdCreateStatic(parser_benchmark_wa_, sizeof(parser_benchmark_wa_), LOWPRIO, ParserBenchmarkThread, nullptr);
+}
+#else
+void InitParserBenchmark() {
+}
+#endif
+
+}  // namespace xbot::debug
+
+#else  // !PARSER_BENCHMARK
+
+namespace xbot::debug {
+void InitParserBenchmark() {
+}
+}  // namespace xbot::debug
+
+#endif  // PARSER_BENCHMARK
@@ -0,0 +1,80 @@
+//
+// Throughput benchmark for the wire-protocol parsers (UBX, NMEA, VESC, YFR4-ESC, YF Cover UI).
+//
+// Replays synthetic byte streams through each parser's ProcessBytes() in three
+// scenarios and reports MB/s, packets/s and counter ticks per packet:
+//  - clean:      back-to-back valid frames, fed in the driver's DMA buffer size
+//  - noise:      garbage between frames and corrupted frames, forcing resyncs
+//  - fragmented: the clean stream in random 1..64 byte chunks (idle/char-match wakeups)
+// Recorded streams can be replayed with Run() (see hostsim/parser_benchmark_main.cpp).
+//
+// The ticks come from chSysGetRealtimeCounterX(): CPU cycles (DWT CYCCNT) on
+// target, nanoseconds in the HostSim build. On target, build with
+// -DPARSER_BENCHMARK=ON; the results are logged via ULOG shortly after boot.
+//
+
+#ifndef PARSER_BENCHMARK_HPP
+#define PARSER_BENCHMARK_HPP
+
+#include <etl/delegate.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace xbot::debug {
+
+class ParserBenchmark {
+ public:
+  enum class Parser : uint8_t { UBX, NMEA, VESC, YFR4ESC, YF_COVER_UI };
+
+  struct Result {
+    Parser parser;
+    const char* scenario;
+    // Total bytes fed into the parser
+    uint64_t bytes;
+    // Valid frames contained in the stream
+    uint32_t packets;
+    // Frames which made it through the parser (state callbacks), NOT_OBSERVABLE if the parser has no callback
+    uint32_t decoded;
+    uint64_t ticks;
+  };
+
+  static constexpr uint32_t NOT_OBSERVABLE = UINT32_MAX;
+
+  typedef etl::delegate<void(const Result& result)> ResultCallback;
+
+  // Runs every available parser through all synthetic scenarios.
+  static void RunAll(const ResultCallback& callback);
+
+  /**
+   * Replays a stream repeat times through the given parser.
+   * @param chunk_size bytes per ProcessBytes() call, 0 for random 1..64 byte fragments
+   * @param packets valid frames in one pass of data, 0 if unknown (a recording)
+   */
+  static Result Run(Parser parser, const char* scenario, const uint8_t* data, size_t len, size_t chunk_size,
+                    uint32_t packets, uint32_t repeat);
+
+  static bool IsAvailable(Parser parser);
+  static const char* ParserName(Parser parser);
+  // DMA buffer size of the driver, used for the "clean" and "noise" scenarios
+  static size_t DmaChunkSize(Parser parser);
+
+  // Ticks per second of chSysGetRealtimeCounterX() and the unit used in reports ("cyc" or "ns")
+  static uint32_t CounterFrequency();
+  static const char* CounterUnit();
+
+  static void LogResult(const Result& result);
+
+ private:
+  static void ResetParser(Parser parser);
+  static void Feed(Parser parser, const uint8_t* data, size_t len);
+  static size_t Generate(Parser parser, bool noise, uint8_t* buffer, size_t size, uint32_t& packets);
+};
+
+// Starts a low priority thread which runs the benchmark once and logs the results.
+// No-op unless built with PARSER_BENCHMARK.
+void InitParserBenchmark();
+
+}  // namespace xbot::debug
+
+#endif  // PARSER_BENCHMARK_HPP
@@ -0,0 +1,85 @@
+//
+// Samples the run time, context switches, longest run slice and stack watermark of every ChibiOS thread.
+//
+
+#include "system_monitor.hpp"
+
+#include <cstring>
+#include <xbot/system_monitor.hpp>
+
+#include "ch.h"
+#include "hal.h"
+#include "thread_priorities.h"
+#include "thread_watermark.h"
+
+namespace xbot::debug {
+
+using xbot::system_monitor::MAX_THREADS;
+using xbot::system_monitor::ThreadStats;
+
+static THD_WORKING_AREA(waSystemMonitor, 1024);
+static ThreadStats threads_[MAX_THREADS]{};
+
+static uint32_t CyclesToMicros(uint64_t cycles) {
+  return static_cast<uint32_t>(cycles / (STM32_CORE_CK / 1'000'000));
+}
+
+static void Sample() {
+  // The counters only run since the last sample, so they are already the deltas for this interval
+  uint64_t cycles[MAX_THREADS]{};
+  uint64_t total_cycles = 0;
+  uint64_t idle_cycles = 0;
+  size_t count = 0;
+  for (thread_t* tp = chRegFirstThread(); tp != nullptr; tp = chRegNextThread(tp)) {
+    if (count == MAX_THREADS) {
+      // Keep walking, chRegNextThread() releases the references
+      continue;
+    }
+    ThreadStats& stats = threads_[count];
+    stats = ThreadStats{};
+    chSysLock();
+    cycles[count] = tp->monitor_cycles;
+    const rtcnt_t max_slice = tp->monitor_max_slice;
+    stats.switches = tp->monitor_switches;
+    tp->monitor_cycles = 0;
+    tp->monitor_max_slice = 0;
+    tp->monitor_switches = 0;
+    chSysUnlock();
+
+    const char* name = chRegGetThreadNameX(tp);
+    strncpy(stats.name, name != nullptr ? name : "<unnamed>", sizeof(stats.name) - 1);
+    stats.priority = static_cast<uint8_t>(tp->hdr.pqueue.prio);
+    stats.max_slice_us = CyclesToMicros(max_slice);
+    stats.stack_size = ThreadStackSize(tp);
+    stats.stack_used = stats.stack_size - ThreadFreeStack(tp);
+    total_cycles += cycles[count];
+    if (tp == chSysGetIdleThreadX()) {
+      idle_cycles = cycles[count];
+    }
+    count++;
+  }
+  if (total_cycles == 0) {
+    return;
+  }
+  for (size_t i = 0; i < count; i++) {
+    threads_[i].cpu_permille = static_cast<uint16_t>(cycles[i] * 1000 / total_cycles);
+  }
+  const auto cpu_load_permille = static_cast<uint16_t>(1000 - idle_cycles * 1000 / total_cycles);
+  xbot::system_monitor::PublishThreads(threads_, count, SYSTEM_MONITOR_INTERVAL_MS, cpu_load_permille);
+}
+
+static THD_FUNCTION(SystemMonitorThread, arg) {
+  (void)arg;
+  chRegSetThreadName("system-monitor");
+  systime_t next = chVTGetSystemTime();
+  while (true) {
+    next = chThdSleepUntilWindowed(next, chTimeAddX(next, TIME_MS2I(SYSTEM_MONITOR_INTERVAL_MS)));
+    Sample();
+  }
+}
+
+void InitSystemMonitor() {
+  chThdCreateStatic(waSystemMonitor, sizeof(waSystemMonitor), THD_PRIO_MONITOR, SystemMonitorThread, nullptr);
+}
+
+}  // namespace xbot::debug
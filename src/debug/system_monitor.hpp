@@ -0,0 +1,26 @@
+//
+// Samples the run time, context switches, longest run slice and stack watermark of every ChibiOS thread.
+//
+// The run time is accounted with the DWT cycle counter in the context switch hook (cfg/chconf.h), so it also
+// works in release builds. Time spent in ISRs is accounted to the interrupted thread. The results are served
+// to the host on a reserved service id, see xbot/system_monitor.hpp.
+//
+// With USE_SEGGER_SYSTEMVIEW the SystemView bindings define the CH_CFG_*_HOOK macros and call our
+// _CH_CFG_*_HOOK ones from them, so the accounting keeps working, every switch just takes a bit longer.
+//
+
+#ifndef SYSTEM_MONITOR_HPP_
+#define SYSTEM_MONITOR_HPP_
+
+#include <cstdint>
+
+namespace xbot::debug {
+
+constexpr uint32_t SYSTEM_MONITOR_INTERVAL_MS = 1000;
+
+// Starts the sampling thread
+void InitSystemMonitor();
+
+}  // namespace xbot::debug
+
+#endif  // SYSTEM_MONITOR_HPP_
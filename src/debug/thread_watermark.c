@@ -1,8 +1,9 @@
 //
 // Periodically logs the stack high-water mark (watermark) of every ChibiOS
-// thread. Only available in debug builds (requires CH_DBG_FILL_THREADS, which
-// fills each thread's working area with CH_DBG_STACK_FILL_VALUE on creation so
-// we can scan for the deepest stack usage).
+// thread. The log is only available in debug builds. The measurement requires
+// CH_DBG_FILL_THREADS, which fills each thread's working area with
+// CH_DBG_STACK_FILL_VALUE on creation so we can scan for the deepest stack
+// usage.
 //
 
 #include "thread_watermark.h"
@@ -10,26 +11,44 @@
 #include "ch.h"
 #include "chdebug.h"
 
-#ifdef DEBUG_BUILD
+// The main thread has no working area: its thread_t is part of the OS instance and it runs on the process stack
+// from the linker script, which the startup code fills with the same pattern.
+extern stkalign_t __main_thread_stack_base__, __main_thread_stack_end__;
 
-#include <ulog.h>
+static bool IsMainThread(const thread_t *tp) {
+  return tp == &ch0.mainthread;
+}
 
-// How often the watermark report is printed.
-#define WATERMARK_INTERVAL_MS 120000
+static const uint8_t *StackBase(const thread_t *tp) {
+  if (IsMainThread(tp)) {
+    return (const uint8_t *)&__main_thread_stack_base__;
+  }
+  const uint8_t *base = (const uint8_t *)chThdGetWorkingAreaX((thread_t *)tp);
+#if PORT_ENABLE_GUARD_PAGES == TRUE
+  base += PORT_GUARD_PAGE_SIZE; /* skip the no-access guard region */
+#endif
+  return base;
+}
 
-static THD_WORKING_AREA(watermark_wa, 512);
+// The thread_t structure lives at the top of the working area, so it marks
+// the end of the usable stack region.
+static const uint8_t *StackEnd(const thread_t *tp) {
+  if (IsMainThread(tp)) {
+    return (const uint8_t *)&__main_thread_stack_end__;
+  }
+  return (const uint8_t *)tp;
+}
+
+size_t ThreadStackSize(const thread_t *tp) {
+  return (size_t)(StackEnd(tp) - StackBase(tp));
+}
 
 // Returns the number of stack bytes that were never touched by the thread, by
 // counting the leading fill bytes from the bottom (low address) of the working
 // area. used = total - free.
-static size_t ThreadFreeStack(const thread_t *tp) {
-  const uint8_t *base = (const uint8_t *)chThdGetWorkingAreaX((thread_t *)tp);
-#if PORT_ENABLE_GUARD_PAGES == TRUE
-  base += PORT_GUARD_PAGE_SIZE; /* skip the no-access guard region */
-#endif
-  // The thread_t structure lives at the top of the working area, so it marks
-  // the end of the usable stack region.
-  const uint8_t *end = (const uint8_t *)tp;
+size_t ThreadFreeStack(const thread_t *tp) {
+  const uint8_t *base = StackBase(tp);
+  const uint8_t *end = StackEnd(tp);
   size_t free = 0;
   while (base + free < end && base[free] == CH_DBG_STACK_FILL_VALUE) {
     free++;
@@ -37,6 +56,15 @@ static size_t ThreadFreeStack(const thread_t *tp) {
   return free;
 }
 
+#ifdef DEBUG_BUILD
+
+#include <ulog.h>
+
+// How often the watermark report is printed.
+#define WATERMARK_INTERVAL_MS 120000
+
+static THD_WORKING_AREA(watermark_wa, 512);
+
 static THD_FUNCTION(WatermarkThread, arg) {
   (void)arg;
   chRegSetThreadName("watermark");
@@ -47,11 +75,7 @@ static THD_FUNCTION(WatermarkThread, arg) {
     ULOG_INFO("=== Thread stack watermark ===");
     thread_t *tp = chRegFirstThread();
     while (tp != NULL) {
-      const uint8_t *base = (const uint8_t *)chThdGetWorkingAreaX(tp);
-#if PORT_ENABLE_GUARD_PAGES == TRUE
-      base += PORT_GUARD_PAGE_SIZE; /* skip the no-access guard region */
-#endif
-      size_t total = (const uint8_t *)tp - base;
+      size_t total = ThreadStackSize(tp);
       size_t free = ThreadFreeStack(tp);
       const char *name = chRegGetThreadNameX(tp);
       ULOG_INFO("%-12s stack: %4u/%4u used, %4u free", name != NULL ? name : "<unnamed>", (unsigned)(total - free),
@@ -5,6 +5,11 @@
 
 #ifndef THREAD_WATERMARK_H
 #define THREAD_WATERMARK_H
+
+#include <stddef.h>
+
+#include "ch.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -13,6 +18,12 @@ extern "C" {
 // watermark. No-op unless built with DEBUG_BUILD.
 void InitThreadWatermark(void);
 
+// Size of the thread's stack region in bytes.
+size_t ThreadStackSize(const thread_t *tp);
+
+// Returns the number of stack bytes the thread never touched.
+size_t ThreadFreeStack(const thread_t *tp);
+
 #ifdef __cplusplus
 }
 #endif
@@ -5,8 +5,15 @@
 #include "gps_driver.h"
 
 #include <etl/algorithm.h>
+#include <ulog.h>
 
 #include <cmath>
+#include <xbot/timebase.hpp>
+#include <xbot/trace.hpp>
+
+#include "debug/cycle_benchmark.hpp"
+#include "nocache.hpp"
+#include "thread_priorities.h"
 
 namespace xbot::driver::gps {
 
@@ -21,9 +28,33 @@ bool GpsDriver::StartDriver(UARTDriver *uart, uint32_t baudrate) {
   if (!stopped_) {
     return false;
   }
+  if (recv_buffer_ == nullptr) {
+    recv_buffer_ = nocache::Alloc<uint8_t>(RECV_BUFFER_SIZE);
+  }
   this->uart_ = uart;
   uart_config_.speed = baudrate;
   uart_config_.context = this;
+  uart_config_.txend1_cb = [](UARTDriver *uartp) {
+    chSysLockFromISR();
+    GpsDriver *instance = reinterpret_cast<const UARTConfigEx *>(uartp->config)->context;
+    // DMA is done with the buffer, chain the next transfer
+    instance->tx_queue_.OnTxEndI();
+    chSysUnlockFromISR();
+  };
+  tx_queue_.Init(uart, TX_QUEUE_SIZE);
+  // Idle line after each burst: timestamp it and wake the thread to parse the complete burst
+  uart_config_.cr1 |= USART_CR1_IDLEIE;
+  uart_config_.timeout_cb = [](UARTDriver *uartp) {
+    chSysLockFromISR();
+    GpsDriver *instance = reinterpret_cast<const UARTConfigEx *>(uartp->config)->context;
+    instance->rx_idle_ticks_ = timebase::NowTicks();
+    instance->rx_idle_pos_ = instance->recv_wraps_ * RECV_BUFFER_SIZE + (RECV_BUFFER_SIZE - uartp->dmarx->stream->NDTR);
+    if (instance->processing_thread_) {
+      chEvtSignalI(instance->processing_thread_, EVT_RX_IDLE);
+    }
+    chSysUnlockFromISR();
+  };
+  rtcm_parser_.SetFrameCallback(Rtcm3Parser::FrameCallback::create<GpsDriver, &GpsDriver::OnRtcmFrame>(*this));
   bool uartStarted = uartStart(uart, &uart_config_) == MSG_OK;
   if (!uartStarted) {
     return false;
@@ -33,36 +64,26 @@ bool GpsDriver::StartDriver(UARTDriver *uart, uint32_t baudrate) {
     chSysLockFromISR();
     GpsDriver *instance = reinterpret_cast<const UARTConfigEx *>(uartp->config)->context;
     chDbgAssert(instance != nullptr, "instance cannot be null!");
-    if (!instance->processing_done_) {
-      // This is bad, processing is too slow to keep up with updates!
-      // We just read into the same buffer again
-      uint8_t *next_recv_buffer =
-          (instance->processing_buffer_ == instance->recv_buffer1_) ? instance->recv_buffer2_ : instance->recv_buffer1_;
-      uartStartReceiveI(uartp, RECV_BUFFER_SIZE, next_recv_buffer);
-    } else {
-      // Swap buffers and read into the next one
-      // Get the pointer to the receiving buffer (it's not the processing buffer)
-      uint8_t *next_recv_buffer = instance->processing_buffer_;
-      uartStartReceiveI(uartp, RECV_BUFFER_SIZE, next_recv_buffer);
-      instance->processing_buffer_ =
-          (instance->processing_buffer_ == instance->recv_buffer1_) ? instance->recv_buffer2_ : instance->recv_buffer1_;
-      instance->processing_buffer_len_ = RECV_BUFFER_SIZE;
-      instance->processing_done_ = false;
-      // Signal the processing thread
-      if (instance->processing_thread_) {
-        chEvtSignalI(instance->processing_thread_, 1);
-      }
+    // End of the ring reached. Re-arm DMA immediately to minimize the RX gap, the thread catches up by itself.
+    uartStartReceiveI(uartp, RECV_BUFFER_SIZE, instance->recv_buffer_);
+    instance->recv_wraps_ = instance->recv_wraps_ + 1;
+    if (instance->processing_thread_) {
+      chEvtSignalI(instance->processing_thread_, EVT_RX_WRAP);
     }
     chSysUnlockFromISR();
   };
 
+  // Arm RX before the thread starts, it takes the initial write position from the DMA stream
+  recv_wraps_ = 0;
+  read_pos_ = 0;
+  uartStartReceive(uart, RECV_BUFFER_SIZE, recv_buffer_);
+
   stopped_ = false;
-  processing_thread_ = chThdCreateStatic(&thd_wa_, sizeof(thd_wa_), NORMALPRIO, threadHelper, this);
+  processing_thread_ = chThdCreateStatic(&thd_wa_, sizeof(thd_wa_), THD_PRIO_GPS, threadHelper, this);
 #ifdef USE_SEGGER_SYSTEMVIEW
   processing_thread_->name = "GpsDriver";
 #endif
 
-  uartStartReceive(uart, RECV_BUFFER_SIZE, recv_buffer1_);
   return true;
 }
 
@@ -71,58 +92,69 @@ void GpsDriver::SetStateCallback(const GpsDriver::StateCallback &function) {
 }
 
 bool GpsDriver::send_raw(const void *data, size_t size) {
-  chMtxLock(&mutex_);
-  uartSendFullTimeout(uart_, &size, data, TIME_INFINITE);
-  chMtxUnlock(&mutex_);
-  return true;
+  // Copied into the non-cacheable TX ring, no cache maintenance needed
+  return tx_queue_.Send(data, size);
+}
+
+uint32_t GpsDriver::GetWritePos() {
+  // Read both under lock, so that a pending wrap ISR can't sit between them.
+  // If the DMA just finished (NDTR == 0) and the ISR hasn't run yet, this is the end of the current lap.
+  chSysLock();
+  const uint32_t ndtr = uart_->dmarx->stream->NDTR;
+  const uint32_t wraps = recv_wraps_;
+  chSysUnlock();
+  return wraps * RECV_BUFFER_SIZE + (RECV_BUFFER_SIZE - ndtr);
+}
+
+void GpsDriver::ProcessRing(uint32_t write_pos) {
+  CYCLE_BENCHMARK_STATS(parse_stats, "gps_parse");
+  uint32_t pending = write_pos - read_pos_;
+  if (pending > RECV_BUFFER_SIZE) {
+    // This is bad, processing is too slow to keep up with updates! The DMA has overwritten unparsed data.
+    ULOG_WARNING("GPS RX overrun, dropped %u bytes", static_cast<unsigned>(pending - RECV_BUFFER_SIZE));
+    ResetParserState();
+    read_pos_ = write_pos - RECV_BUFFER_SIZE;
+    pending = RECV_BUFFER_SIZE;
+  }
+  // At most two contiguous segments: up to the end of the ring and from the start of the ring.
+  // The parsers decode complete frames in place, only frames straddling the wrap get copied.
+  while (pending > 0) {
+    const size_t offset = read_pos_ & (RECV_BUFFER_SIZE - 1);
+    const size_t len = etl::min<size_t>(pending, RECV_BUFFER_SIZE - offset);
+    {
+      CYCLE_BENCHMARK_SCOPE(parse_stats, len);
+      ProcessBytes(recv_buffer_ + offset, len);
+    }
+    if (IsRawMode()) {
+      RawDataOutput(recv_buffer_ + offset, len);
+    }
+    read_pos_ += len;
+    pending -= len;
+  }
+  OnBurstProcessed();
 }
 
 void GpsDriver::threadFunc() {
-  uint32_t last_ndtr = 0;
+  uint32_t last_write_pos = GetWritePos();
   while (!stopped_) {
-    // Wait for data to arrive
-    bool timeout = chEvtWaitAnyTimeout(ALL_EVENTS, TIME_MS2I(RECV_TIMEOUT_MILLIS)) == 0;
-    if (timeout) {
-      // If there is still reception going on, wait for the timeout again
-      if (last_ndtr != uart_->dmarx->stream->NDTR) {
-        last_ndtr = uart_->dmarx->stream->NDTR;
-        continue;
-      }
-      // If timeout, we take the buffer and restart the reception
-      // Else, the ISR has already prepared the buffer for us
-      // Lock the core to prevent the RX interrupt from firing
-      chSysLock();
-      // Check, that processing_done_ is still true
-      // (in case ISR happened between the timeout and now, this will be set to false by ISR)
-      if (processing_done_) {
-        // Stop reception and get the partial received length
-        size_t not_received_len = uartStopReceiveI(uart_);
-        if (not_received_len != UART_ERR_NOT_ACTIVE) {
-          // Uart was still receiving, so the buffer length is not complete
-          processing_buffer_len_ = RECV_BUFFER_SIZE - not_received_len;
-        } else {
-          // Uart was not active.
-          // This should not happen, but could during debug when pausing the chip
-          // we ignore this buffer, but carry on as usual
-          processing_buffer_len_ = 0;
-        }
-        uint8_t *next_recv_buffer = processing_buffer_;
-        uartStartReceiveI(uart_, RECV_BUFFER_SIZE, next_recv_buffer);
-        processing_buffer_ = (processing_buffer_ == recv_buffer1_) ? recv_buffer2_ : recv_buffer1_;
-        processing_done_ = false;
-      }
-      // allow ISR again
-      chSysUnlock();
+    // Wait for the end of a burst (idle line), the DMA to wrap or the next poll interval
+    const eventmask_t events = chEvtWaitAnyTimeout(EVT_RX_WRAP | EVT_RX_IDLE, TIME_MS2I(RECV_POLL_MILLIS));
+    const uint32_t write_pos = GetWritePos();
+    const uint32_t pending = write_pos - read_pos_;
+    chSysLock();
+    const uint32_t idle_pos = rx_idle_pos_;
+    const uint64_t idle_ticks = rx_idle_ticks_;
+    chSysUnlock();
+    // Parse once the burst is over (idle interrupt or no new bytes since the last poll), so that frames are complete
+    // and contiguous. Don't wait longer than half a ring, in case the receiver streams without pause.
+    const bool idle = (events & EVT_RX_IDLE) || write_pos == last_write_pos;
+    last_write_pos = write_pos;
+    if (pending > 0 && (idle || pending >= RECV_BUFFER_SIZE / 2)) {
+      // If nothing arrived after the last idle line, the burst ended at the captured time. Otherwise fall back to now.
+      rx_capture_ticks_ = idle_pos == write_pos ? idle_ticks : timebase::NowTicks();
+      ProcessRing(write_pos);
+      trace::Record(trace::Span::GPS_RX_TO_PARSED, rx_capture_ticks_, timebase::NowTicks());
     }
-    if (processing_buffer_len_ > 0) {
-      ProcessBytes(processing_buffer_, processing_buffer_len_);
-      if (IsRawMode()) {
-        RawDataOutput(processing_buffer_, processing_buffer_len_);
-      }
-    }
-    last_ndtr = 0;
-    processing_buffer_len_ = 0;
-    processing_done_ = true;
   }
 }
 
@@ -132,11 +164,27 @@ void GpsDriver::threadHelper(void *instance) {
   gps_interface->threadFunc();
 }
 
-void GpsDriver::SendRTCM(const uint8_t *data, size_t size) {
-  send_raw(data, size);
+uint32_t GpsDriver::SendRTCM(const uint8_t *data, size_t size) {
+  rtcm_frames_forwarded_ = 0;
+  rtcm_parser_.Process(data, size);
+  if (rtcm_frames_forwarded_ > 0) {
+    last_rtcm_time_ = chVTGetSystemTimeX();
+    tx_queue_.Flush();
+  }
+  return rtcm_frames_forwarded_;
+}
+
+void GpsDriver::OnRtcmFrame(const uint8_t *frame, size_t size, uint16_t message_type) {
+  (void)message_type;
+  // Queue only, SendRTCM() starts one transfer for all frames
+  if (tx_queue_.Queue(frame, size)) {
+    rtcm_frames_forwarded_++;
+  }
 }
 
 void GpsDriver::TriggerStateCallback() {
+  gps_state_.capture_ticks = rx_capture_ticks_;
+  gps_state_.received_time = static_cast<uint32_t>(timebase::TicksToMicros(rx_capture_ticks_));
   if (state_callback_) {
     state_callback_(gps_state_);
   }
@@ -11,10 +11,19 @@
 
 #include "GpsServiceBase.hpp"
 #include "ch.h"
+#include "drivers/uart/uart_tx_queue.hpp"
 #include "hal.h"
+#include "rtcm3_parser.hpp"
+
+namespace xbot::debug {
+class ParserBenchmark;
+}  // namespace xbot::debug
 
 namespace xbot::driver::gps {
 class GpsDriver : public DebuggableDriver {
+  // Feeds synthetic streams directly into ProcessBytes()
+  friend class xbot::debug::ParserBenchmark;
+
  public:
   void RawDataInput(uint8_t *data, size_t size) override;
 
@@ -29,7 +38,11 @@ class GpsDriver : public DebuggableDriver {
     enum RTKType { RTK_NONE = 0, RTK_FLOAT = 1, RTK_FIX = 2 };
 
     uint32_t sensor_time;
+    // Reception time of the solution in the getTimeMicros() domain
     uint32_t received_time;
+    // Timebase ticks (xbot::timebase) when the UART went idle after the burst which completed this solution,
+    // i.e. captured in the ISR right after the last byte arrived
+    uint64_t capture_ticks;
 
     // Position
     bool position_valid;
@@ -55,6 +68,32 @@ class GpsDriver : public DebuggableDriver {
 
     // Number of satellites used in solution
     uint8_t num_sv;
+
+    // Dilution of precision, 0 if not reported
+    double pdop, hdop, vdop;
+
+    // Position of the rover antenna relative to the moving base / reference station in m (ENU).
+    // With a moving base, vehicle_heading is the heading of this vector.
+    bool relative_position_valid;
+    double relative_position[3];
+    double relative_position_accuracy[3];
+    double relative_position_length;
+
+    // Covariance of position (m^2) and velocity (m^2/s^2), ENU, 3x3 row-major
+    bool position_covariance_valid;
+    double position_covariance[9];
+    bool velocity_covariance_valid;
+    double velocity_covariance[9];
+
+    // RTCM correction messages as decoded by the receiver
+    struct RtcmStats {
+      uint32_t used;
+      uint32_t not_used;
+      uint32_t crc_failed;
+      uint16_t last_message_type;
+      // Time from forwarding the last RTCM data to the receiver until it reported the message, in ms
+      uint32_t last_latency_ms;
+    } rtcm;
   };
 
   enum Level { VERBOSE, INFO, WARN, ERROR };
@@ -65,7 +104,26 @@ class GpsDriver : public DebuggableDriver {
   bool StartDriver(UARTDriver *uart, uint32_t baudrate);
   void SetStateCallback(const GpsDriver::StateCallback &function);
 
-  void SendRTCM(const uint8_t *data, size_t size);
+  /**
+   * Forwards RTCM data (any chunking) to the receiver. Only frames with a valid CRC-24Q are sent,
+   * all frames of one call go out in one DMA transfer. Doesn't block on the UART.
+   * Not thread-safe, call from one thread only.
+   * @return number of valid frames forwarded
+   */
+  uint32_t SendRTCM(const uint8_t *data, size_t size);
+
+  const Rtcm3Parser::Stats &GetRtcmStats() const {
+    return rtcm_parser_.GetStats();
+  }
+
+  // Time of the last valid RTCM frame forwarded to the receiver, 0 if none yet
+  systime_t GetLastRtcmTime() const {
+    return last_rtcm_time_;
+  }
+
+  uart::UartTxQueue::Stats GetTxStats() const {
+    return tx_queue_.GetStats();
+  }
 
   /**
    * @brief Get current GPS state
@@ -98,10 +156,12 @@ class GpsDriver : public DebuggableDriver {
 
   bool gps_state_valid_{};
   GpsState gps_state_{};
+  // When the last RTCM data was forwarded to the receiver, for latency stats
+  systime_t last_rtcm_time_ = 0;
 
   /**
-   * Send a message to the GPS. This will just output to the serial port
-   * directly
+   * Send a message to the GPS. This will just queue the data for the serial port
+   * and return, false if the TX queue is full
    */
   bool send_raw(const void *data, size_t size);
 
@@ -110,32 +170,54 @@ class GpsDriver : public DebuggableDriver {
 
   virtual size_t ProcessBytes(const uint8_t *buffer, size_t len) = 0;
 
+  // Called after all data received so far has been passed to ProcessBytes()
+  virtual void OnBurstProcessed() {
+  }
+
  private:
   // Extend the config struct by a pointer to this instance, so that we can access it in callbacks.
   struct UARTConfigEx : UARTConfig {
     GpsDriver *context;
   };
 
-  static constexpr size_t RECV_BUFFER_SIZE = 512;
-  // 20Hz timeout for reception
-  static constexpr uint32_t RECV_TIMEOUT_MILLIS = 25;
-  // Keep two buffers for streaming data while doing processing
-  uint8_t recv_buffer1_[RECV_BUFFER_SIZE]{};
-  uint8_t recv_buffer2_[RECV_BUFFER_SIZE]{};
-  // We start by receiving into recv_buffer1, so processing_buffer is the 2 (but empty)
-  uint8_t *volatile processing_buffer_ = recv_buffer2_;
-  volatile size_t processing_buffer_len_ = 0;
+  // DMA ring buffer, the UART keeps receiving into it while the thread parses the bytes behind the write position.
+  // Must be a power of two, so that the absolute positions below stay consistent when they overflow.
+  static constexpr size_t RECV_BUFFER_SIZE = 2048;
+  static_assert((RECV_BUFFER_SIZE & (RECV_BUFFER_SIZE - 1)) == 0, "RECV_BUFFER_SIZE must be a power of two");
+  // Poll interval for new data. A burst is parsed once the line was idle for one interval.
+  static constexpr uint32_t RECV_POLL_MILLIS = 10;
+  static constexpr eventmask_t EVT_RX_WRAP = EVENT_MASK(0);
+  static constexpr eventmask_t EVT_RX_IDLE = EVENT_MASK(1);
+  // TX ring, holds a few RTCM bursts (frames are up to 1029 bytes)
+  static constexpr size_t TX_QUEUE_SIZE = 2048;
+  // DMA target, allocated from the non-cacheable region in StartDriver().
+  uint8_t *recv_buffer_ = nullptr;
+  // Number of times the DMA reached the end of the ring and was re-armed (incremented by the ISR)
+  volatile uint32_t recv_wraps_ = 0;
+  // Absolute position (bytes since start, modulo 2^32) up to which the thread has parsed the ring
+  uint32_t read_pos_ = 0;
+  // Write position and timebase ticks of the last idle line, captured by the ISR
+  volatile uint32_t rx_idle_pos_ = 0;
+  volatile uint64_t rx_idle_ticks_ = 0;
+  // Capture time of the data currently being parsed
+  uint64_t rx_capture_ticks_ = 0;
 
   UARTDriver *uart_{};
   UARTConfigEx uart_config_{};
+  uart::UartTxQueue tx_queue_{};
+
+  Rtcm3Parser rtcm_parser_{};
+  uint32_t rtcm_frames_forwarded_ = 0;
+  void OnRtcmFrame(const uint8_t *frame, size_t size, uint16_t message_type);
 
   THD_WORKING_AREA(thd_wa_, 1024){};
   thread_t *processing_thread_ = nullptr;
-  // This is reset by the receiving ISR and set by the thread to signal if it's safe to process more data.
-  volatile bool processing_done_ = true;
   bool stopped_ = true;
 
   void threadFunc();
+  // Absolute write position of the DMA in the ring
+  uint32_t GetWritePos();
+  void ProcessRing(uint32_t write_pos);
 
   static void threadHelper(void *instance);
 };
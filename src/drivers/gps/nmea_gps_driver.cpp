@@ -1,9 +1,33 @@
 #include "nmea_gps_driver.h"
 
+#include <cmath>
+
 #include "minmea.h"
 
 namespace xbot::driver::gps {
 
+namespace {
+constexpr uint32_t SentenceKey(const char *id) {
+  return static_cast<uint32_t>(id[0]) << 16 | static_cast<uint32_t>(id[1]) << 8 | static_cast<uint32_t>(id[2]);
+}
+
+int HexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+// Converts a heading in deg (clockwise from north) to rad, counter-clockwise from east in [0, 2pi)
+double HeadingToEnu(double heading_deg) {
+  double result = fmod(-heading_deg * (M_PI / 180.0) + M_PI_2, 2.0 * M_PI);
+  while (result < 0) {
+    result += M_PI * 2.0;
+  }
+  return result;
+}
+}  // namespace
+
 /**
  * parses the buffer and returns how many more bytes to read
  */
@@ -33,7 +57,7 @@ size_t NmeaGpsDriver::ProcessBytes(const uint8_t *buffer, size_t len) {
         memcpy(&line[line_len], buffer, bytes_to_take);
         line_len += bytes_to_take;
         line[line_len] = '\0';
-        if (ProcessLine(line)) {
+        if (ProcessLine(line, line_len)) {
           success++;
         } else {
           error++;
@@ -79,13 +103,81 @@ void NmeaGpsDriver::UpdateGpsStateValidity() {
   }
 }
 
-bool NmeaGpsDriver::ProcessLine(const char *line) {
-  switch (minmea_sentence_id(line, true)) {
-    case MINMEA_SENTENCE_GGA: {
+bool NmeaGpsDriver::ChecksumValid(const char *line, size_t len) {
+  // "$<data>*hh" followed by "\r\n" or "\n"
+  while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+    len--;
+  }
+  if (len < 4 || line[len - 3] != '*') {
+    return false;
+  }
+  const int high = HexValue(line[len - 2]);
+  const int low = HexValue(line[len - 1]);
+  if (high < 0 || low < 0) {
+    return false;
+  }
+  uint8_t checksum = 0;
+  for (size_t i = 1; i < len - 3; i++) {
+    checksum ^= static_cast<uint8_t>(line[i]);
+  }
+  return checksum == (high << 4 | low);
+}
+
+NmeaGpsDriver::Sentence NmeaGpsDriver::IdentifySentence(const char *line, size_t len) {
+  // "$GxSSS," GNSS talker (GP, GN, GL, GA, GB, ...) and the three character sentence ID
+  if (len < 7 || line[1] != 'G' || line[6] != ',') {
+    return Sentence::OTHER;
+  }
+  switch (SentenceKey(line + 3)) {
+    case SentenceKey("GGA"): return Sentence::GGA;
+    case SentenceKey("RMC"): return Sentence::RMC;
+    case SentenceKey("GSA"): return Sentence::GSA;
+    case SentenceKey("GST"): return Sentence::GST;
+    case SentenceKey("VTG"): return Sentence::VTG;
+    case SentenceKey("HDT"): return Sentence::HDT;
+    default: return Sentence::OTHER;
+  }
+}
+
+void NmeaGpsDriver::BeginEpoch(const minmea_time &time) {
+  // A new time stamp means the previous epoch is complete
+  if (time.hours == epoch_time_.hours && time.minutes == epoch_time_.minutes && time.seconds == epoch_time_.seconds &&
+      time.microseconds == epoch_time_.microseconds) {
+    return;
+  }
+  FinishEpoch();
+  epoch_time_ = time;
+}
+
+void NmeaGpsDriver::FinishEpoch() {
+  if (epoch_sentences_ == 0) {
+    return;
+  }
+  // The heading is only valid for the epoch which contained the HDT sentence
+  if (!(epoch_sentences_ & SentenceBit(Sentence::HDT))) {
+    gps_state_.vehicle_heading_valid = false;
+  }
+  epoch_sentences_ = 0;
+  TriggerStateCallback();
+}
+
+void NmeaGpsDriver::OnBurstProcessed() {
+  FinishEpoch();
+}
+
+bool NmeaGpsDriver::ProcessLine(const char *line, size_t len) {
+  // Cheap checks first: lines with a bad checksum or sentences we don't use never reach minmea
+  if (!ChecksumValid(line, len)) {
+    return false;
+  }
+  const Sentence sentence = IdentifySentence(line, len);
+  switch (sentence) {
+    case Sentence::GGA: {
       struct minmea_sentence_gga gga;
       if (!minmea_parse_gga(&gga, line)) {
         return false;
       }
+      BeginEpoch(gga.time);
 
       gps_state_.pos_lat = minmea_tocoord(&gga.latitude);
       gps_state_.pos_lon = minmea_tocoord(&gga.longitude);
@@ -103,11 +195,10 @@ bool NmeaGpsDriver::ProcessLine(const char *line) {
       gps_state_.num_sv = gga.satellites_tracked;
 
       UpdateGpsStateValidity();
-      TriggerStateCallback();
-      return true;
+      break;
     }
 
-    case MINMEA_SENTENCE_RMC: {
+    case Sentence::RMC: {
       struct minmea_sentence_rmc rmc;
       if (!minmea_parse_rmc(&rmc, line)) {
         return false;
@@ -117,26 +208,18 @@ bool NmeaGpsDriver::ProcessLine(const char *line) {
       if (minmea_gettime(&ts, &rmc.date, &rmc.time) != 0) {
         return false;
       }
+      BeginEpoch(rmc.time);
       gps_state_.sensor_time = ts.tv_sec;
-      gps_state_.received_time = ts.tv_sec;
 
       gps_state_.pos_lat = minmea_tocoord(&rmc.latitude);
       gps_state_.pos_lon = minmea_tocoord(&rmc.longitude);
       gps_state_.position_valid = true;
 
-      double speed = minmea_tofloat(&rmc.speed) * 0.514444;  // Convert knots to m/s
-      double angle_rad = minmea_tofloat(&rmc.course) * M_PI / 180.0;
-      gps_state_.vel_e = sin(angle_rad) * speed;
-      gps_state_.vel_n = cos(angle_rad) * speed;
-      gps_state_.vel_u = 0;
-      gps_state_.motion_heading_valid = true;
-      gps_state_.vehicle_heading_valid = false;
-
-      TriggerStateCallback();
-      return true;
+      SetMotion(minmea_tofloat(&rmc.speed) * 0.514444, minmea_tofloat(&rmc.course));  // Convert knots to m/s
+      break;
     }
 
-    case MINMEA_SENTENCE_GSA: {
+    case Sentence::GSA: {
       struct minmea_sentence_gsa gsa;
       if (!minmea_parse_gsa(&gsa, line)) {
         return false;
@@ -147,17 +230,20 @@ bool NmeaGpsDriver::ProcessLine(const char *line) {
         case MINMEA_GPGSA_FIX_3D: gps_state_.fix_type = GpsState::FIX_3D; break;
         default: gps_state_.fix_type = GpsState::NO_FIX; break;
       }
+      gps_state_.pdop = minmea_tofloat(&gsa.pdop);
+      gps_state_.hdop = minmea_tofloat(&gsa.hdop);
+      gps_state_.vdop = minmea_tofloat(&gsa.vdop);
 
       UpdateGpsStateValidity();
-      TriggerStateCallback();
-      return true;
+      break;
     }
 
-    case MINMEA_SENTENCE_GST: {
+    case Sentence::GST: {
       struct minmea_sentence_gst gst;
       if (!minmea_parse_gst(&gst, line)) {
         return false;
       }
+      BeginEpoch(gst.time);
 
       float lat_std = minmea_tofloat(&gst.latitude_error_deviation);
       float lon_std = minmea_tofloat(&gst.longitude_error_deviation);
@@ -165,23 +251,68 @@ bool NmeaGpsDriver::ProcessLine(const char *line) {
 
       gps_state_.position_h_accuracy = sqrt(lat_std * lat_std + lon_std * lon_std);
       gps_state_.position_v_accuracy = alt_std;
+      break;
+    }
 
-      TriggerStateCallback();
-      return true;
+    case Sentence::VTG: {
+      struct minmea_sentence_vtg vtg;
+      if (!minmea_parse_vtg(&vtg, line)) {
+        return false;
+      }
+      SetMotion(minmea_tofloat(&vtg.speed_kph) / 3.6, minmea_tofloat(&vtg.true_track_degrees));
+      break;
     }
 
-    case MINMEA_INVALID:
-      // Wrong line syntax.
-      return false;
+    case Sentence::HDT: {
+      // Not supported by minmea: "$GxHDT,<heading>,T*hh"
+      char type[6];
+      struct minmea_float heading;
+      char true_indicator;
+      if (!minmea_scan(line, "tfc", type, &heading, &true_indicator) || true_indicator != 'T') {
+        return false;
+      }
+      const float heading_deg = minmea_tofloat(&heading);
+      if (std::isnan(heading_deg)) {
+        return false;
+      }
+      gps_state_.vehicle_heading_valid = true;
+      gps_state_.vehicle_heading = HeadingToEnu(heading_deg);
+      break;
+    }
 
-    default:
+    case Sentence::OTHER:
       // Correct syntax, but we're not interested in this type.
       return true;
   }
+
+  epoch_sentences_ |= SentenceBit(sentence);
+  return true;
+}
+
+void NmeaGpsDriver::SetMotion(double speed, double course_deg) {
+  if (std::isnan(speed)) {
+    return;
+  }
+  if (std::isnan(course_deg)) {
+    // Receivers leave the course empty while standing still, don't keep the velocity of the last fix
+    gps_state_.vel_e = 0;
+    gps_state_.vel_n = 0;
+    gps_state_.vel_u = 0;
+    gps_state_.motion_heading_valid = false;
+    return;
+  }
+  const double angle_rad = course_deg * M_PI / 180.0;
+  gps_state_.vel_e = sin(angle_rad) * speed;
+  gps_state_.vel_n = cos(angle_rad) * speed;
+  gps_state_.vel_u = 0;
+  gps_state_.motion_heading_valid = true;
+  gps_state_.motion_heading = HeadingToEnu(course_deg);
 }
 
 void NmeaGpsDriver::ResetParserState() {
   line_len = 0;
+  epoch_sentences_ = 0;
+  epoch_time_ = {};
 }
 
 }  // namespace xbot::driver::gps
@@ -4,6 +4,7 @@
 #include <debug/debuggable_driver.hpp>
 
 #include "gps_driver.h"
+#include "minmea.h"
 
 namespace xbot::driver::gps {
 class NmeaGpsDriver : public GpsDriver {
@@ -14,19 +15,48 @@ class NmeaGpsDriver : public GpsDriver {
 
  protected:
   void ResetParserState() override;
+  void OnBurstProcessed() override;
 
  private:
+  enum class Sentence : uint8_t { OTHER, GGA, RMC, GSA, GST, VTG, HDT };
+
+  static constexpr uint8_t SentenceBit(Sentence sentence) {
+    return 1u << static_cast<uint8_t>(sentence);
+  }
+
   /**
    * Parses the rx buffer and looks for valid NMEA sentences
    */
   size_t ProcessBytes(const uint8_t* buffer, size_t len) override;
 
-  bool ProcessLine(const char* line);
+  /**
+   * Validates the "*hh" checksum of a complete line, before anything is handed to minmea
+   */
+  static bool ChecksumValid(const char* line, size_t len);
+
+  /**
+   * Returns the sentence type from the talker / sentence ID, OTHER for anything we don't parse
+   */
+  static Sentence IdentifySentence(const char* line, size_t len);
+
+  bool ProcessLine(const char* line, size_t len);
   void UpdateGpsStateValidity();
+  void SetMotion(double speed, double course_deg);
+
+  /**
+   * All sentences of an epoch are merged into one state update. The epoch is finished when a sentence
+   * with a different time stamp arrives or the received burst has been processed.
+   */
+  void BeginEpoch(const minmea_time& time);
+  void FinishEpoch();
 
   char line[512]{};
   size_t line_len = 0;
 
+  minmea_time epoch_time_{};
+  // SentenceBit()s of the sentences received in the current epoch
+  uint8_t epoch_sentences_ = 0;
+
   int fix_quality = 0;
 };
 }  // namespace xbot::driver::gps
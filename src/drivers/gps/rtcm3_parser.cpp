@@ -0,0 +1,162 @@
+//
+// RTCM 3 framing, see rtcm3_parser.hpp.
+//
+
+#include "rtcm3_parser.hpp"
+
+#include <etl/algorithm.h>
+
+#include <cstring>
+
+namespace xbot::driver::gps {
+
+namespace {
+// CRC-24Q (Qualcomm), polynomial 0x1864CFB, init 0
+struct Crc24qTable {
+  uint32_t values[256];
+
+  constexpr Crc24qTable() : values() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i << 16;
+      for (int bit = 0; bit < 8; bit++) {
+        crc <<= 1;
+        if (crc & 0x1000000) {
+          crc ^= 0x1864CFB;
+        }
+      }
+      values[i] = crc & 0xFFFFFF;
+    }
+  }
+};
+
+constexpr Crc24qTable CRC24Q_TABLE{};
+}  // namespace
+
+uint32_t Rtcm3Parser::Crc24q(const uint8_t *data, size_t len) {
+  uint32_t crc = 0;
+  for (size_t i = 0; i < len; i++) {
+    crc = ((crc << 8) & 0xFFFFFF) ^ CRC24Q_TABLE.values[(crc >> 16) ^ data[i]];
+  }
+  return crc;
+}
+
+void Rtcm3Parser::Process(const uint8_t *data, size_t len) {
+  while (len > 0) {
+    if (buffer_fill_ > 0) {
+      // Complete the frame which was started in a previous chunk
+      if (buffer_fill_ < HEADER_SIZE) {
+        const size_t bytes_to_take = etl::min(len, HEADER_SIZE - buffer_fill_);
+        memcpy(&buffer_[buffer_fill_], data, bytes_to_take);
+        buffer_fill_ += bytes_to_take;
+        data += bytes_to_take;
+        len -= bytes_to_take;
+        if (buffer_fill_ < HEADER_SIZE) {
+          return;
+        }
+        if (buffer_[1] & 0xFC) {
+          // Reserved bits set, this wasn't a preamble
+          ReparseBuffer();
+          continue;
+        }
+      }
+
+      const size_t total_length = FrameLength(buffer_);
+      const size_t bytes_to_take = etl::min(len, total_length - buffer_fill_);
+      memcpy(&buffer_[buffer_fill_], data, bytes_to_take);
+      buffer_fill_ += bytes_to_take;
+      data += bytes_to_take;
+      len -= bytes_to_take;
+      if (buffer_fill_ < total_length) {
+        return;
+      }
+
+      if (HandleFrame(buffer_, total_length)) {
+        buffer_fill_ = 0;
+      } else {
+        ReparseBuffer();
+      }
+      continue;
+    }
+
+    // Fast path: validate complete frames in place
+    const auto *frame_start = static_cast<const uint8_t *>(memchr(data, PREAMBLE, len));
+    if (frame_start == nullptr) {
+      stats_.skipped_bytes += len;
+      return;
+    }
+    stats_.skipped_bytes += frame_start - data;
+    len -= frame_start - data;
+    data = frame_start;
+
+    if (len >= 2 && (data[1] & 0xFC)) {
+      // Reserved bits set, this wasn't a preamble
+      stats_.skipped_bytes++;
+      data++;
+      len--;
+      continue;
+    }
+    if (len < HEADER_SIZE || len < FrameLength(data)) {
+      // The frame continues in the next chunk, keep the part we have (data might point into buffer_)
+      memmove(buffer_, data, len);
+      buffer_fill_ = len;
+      return;
+    }
+
+    const size_t total_length = FrameLength(data);
+    if (HandleFrame(data, total_length)) {
+      data += total_length;
+      len -= total_length;
+    } else {
+      // The preamble might have been payload, resync right after it
+      stats_.skipped_bytes++;
+      data++;
+      len--;
+    }
+  }
+}
+
+void Rtcm3Parser::ReparseBuffer() {
+  const size_t stale = buffer_fill_ - 1;
+  buffer_fill_ = 0;
+  stats_.skipped_bytes++;
+  Process(buffer_ + 1, stale);
+}
+
+bool Rtcm3Parser::HandleFrame(const uint8_t *frame, size_t size) {
+  const size_t crc_offset = size - CRC_SIZE;
+  const uint32_t crc = frame[crc_offset] << 16 | frame[crc_offset + 1] << 8 | frame[crc_offset + 2];
+  if (Crc24q(frame, crc_offset) != crc) {
+    stats_.crc_errors++;
+    return false;
+  }
+
+  // The message type are the first 12 bits of the payload
+  const uint16_t message_type = size >= HEADER_SIZE + 2 + CRC_SIZE ? (frame[3] << 4 | frame[4] >> 4) : 0;
+  stats_.frames++;
+  CountMessageType(message_type);
+  if (frame_callback_) {
+    frame_callback_(frame, size, message_type);
+  }
+  return true;
+}
+
+void Rtcm3Parser::CountMessageType(uint16_t message_type) {
+  for (auto &entry : stats_.types) {
+    if (entry.message_type == message_type && entry.count > 0) {
+      entry.count++;
+      return;
+    }
+    if (entry.count == 0) {
+      entry.message_type = message_type;
+      entry.count = 1;
+      return;
+    }
+  }
+  stats_.other_types++;
+}
+
+void Rtcm3Parser::Reset() {
+  buffer_fill_ = 0;
+}
+
+}  // namespace xbot::driver::gps
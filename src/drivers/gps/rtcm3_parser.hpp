@@ -0,0 +1,83 @@
+//
+// RTCM 3 framing: finds frames in an arbitrary chunked byte stream and validates their CRC-24Q.
+//
+// Frame: 0xD3, 6 reserved bits + 10 bit payload length, payload (message type in the
+// first 12 bits), CRC-24Q over everything before it.
+//
+
+#ifndef XBOT_DRIVER_GPS_RTCM3_PARSER_H
+#define XBOT_DRIVER_GPS_RTCM3_PARSER_H
+
+#include <etl/delegate.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace xbot::driver::gps {
+
+class Rtcm3Parser {
+ public:
+  static constexpr uint8_t PREAMBLE = 0xD3;
+  static constexpr size_t HEADER_SIZE = 3;
+  static constexpr size_t CRC_SIZE = 3;
+  static constexpr size_t MAX_PAYLOAD_SIZE = 1023;
+  static constexpr size_t MAX_FRAME_SIZE = HEADER_SIZE + MAX_PAYLOAD_SIZE + CRC_SIZE;
+  // Number of message types with their own counter, the rest is counted as "other"
+  static constexpr size_t MAX_MESSAGE_TYPES = 16;
+
+  struct MessageTypeCount {
+    uint16_t message_type;
+    uint32_t count;
+  };
+
+  struct Stats {
+    uint32_t frames;
+    uint32_t crc_errors;
+    // Bytes which didn't belong to a valid frame
+    uint32_t skipped_bytes;
+    uint32_t other_types;
+    MessageTypeCount types[MAX_MESSAGE_TYPES];
+  };
+
+  // Called for each valid frame (including header and CRC)
+  typedef etl::delegate<void(const uint8_t *frame, size_t size, uint16_t message_type)> FrameCallback;
+
+  void SetFrameCallback(const FrameCallback &callback) {
+    frame_callback_ = callback;
+  }
+
+  /**
+   * Feeds the next chunk of the stream. Complete frames are validated in place,
+   * only a frame continuing in the next chunk is buffered.
+   */
+  void Process(const uint8_t *data, size_t len);
+
+  void Reset();
+
+  const Stats &GetStats() const {
+    return stats_;
+  }
+
+  static uint32_t Crc24q(const uint8_t *data, size_t len);
+
+ private:
+  static size_t FrameLength(const uint8_t *header) {
+    return HEADER_SIZE + ((header[1] & 0x03) << 8 | header[2]) + CRC_SIZE;
+  }
+
+  // Validates and reports the frame, returns false on CRC error
+  bool HandleFrame(const uint8_t *frame, size_t size);
+  void CountMessageType(uint16_t message_type);
+  // Drops the first byte of the buffered frame and parses the rest again
+  void ReparseBuffer();
+
+  FrameCallback frame_callback_{};
+  Stats stats_{};
+
+  uint8_t buffer_[MAX_FRAME_SIZE]{};
+  size_t buffer_fill_ = 0;
+};
+
+}  // namespace xbot::driver::gps
+
+#endif  // XBOT_DRIVER_GPS_RTCM3_PARSER_H
@@ -36,75 +36,31 @@ size_t UbxGpsDriver::ProcessBytes(const uint8_t *buffer, size_t len) {
   static int error = 0;
   invocations++;
   while (len > 0) {
-    if (!found_header_) {
-      if (len == 0) {
+    if (gbuffer_fill > 0) {
+      // Complete the frame which was started at the end of the previous buffer (e.g. at the DMA ring wrap)
+      if (gbuffer_fill == 1 && buffer[0] != 0x62) {
+        // we had the 0xb5 but didn't get 0x62, look for the next header in the current buffer
+        gbuffer_fill = 0;
         continue;
       }
-      switch (gbuffer_fill) {
-        case 0: {
-          // buffer empty, looking for 0xb5
-          const auto header_start = static_cast<uint8_t *>(memchr(buffer, 0xb5, len));
-          if (header_start == nullptr) {
-            // reject the whole input, we don't have 0xb5
-            len = 0;
-            continue;
-          }
-          // Throw away all bytes before the header start
-          len -= (header_start - buffer);
-          buffer = header_start;
-          gbuffer_[gbuffer_fill++] = *buffer;
-          buffer++;
-          len--;
-        } break;
-        case 1:
-          // we have one byte, looking for 0x62
-          if (buffer[0] == 0x62) {
-            gbuffer_[gbuffer_fill++] = *buffer;
-            found_header_ = true;
-          } else {
-            // we had the 0xb5 but didn't get 0x62, reset to searching 0xb5
-            gbuffer_fill = 0;
-          }
-          buffer++;
-          len--;
-          if (found_header_ && len == 0) {
-            return 6 - gbuffer_fill;
-          }
-          break;
-        default:
-          // just skip the byte and reset the buffer
-          gbuffer_fill = 0;
-          buffer++;
-          len--;
-          break;
-      }
-      continue;
-    }
-
-    // need 6 bytes to determine the packet length
-    if (gbuffer_fill < 6) {
-      size_t bytes_to_take = etl::min(len, 6 - gbuffer_fill);
-      memcpy(&gbuffer_[gbuffer_fill], buffer, bytes_to_take);
-      gbuffer_fill += bytes_to_take;
-      buffer += bytes_to_take;
-      len -= bytes_to_take;
-      if (len == 0 && gbuffer_fill != 6) {
-        return 6 - gbuffer_fill;
+      const size_t header_bytes = etl::min(len, HEADER_SIZE - etl::min(gbuffer_fill, HEADER_SIZE));
+      memcpy(&gbuffer_[gbuffer_fill], buffer, header_bytes);
+      gbuffer_fill += header_bytes;
+      buffer += header_bytes;
+      len -= header_bytes;
+      if (gbuffer_fill < HEADER_SIZE) {
+        return HEADER_SIZE - gbuffer_fill;
       }
-    } else {
-      // get the length first to check, if we already got enough bytes
-      uint16_t payload_length = gbuffer_[5] << 8 | gbuffer_[4];
-      uint16_t total_length = payload_length + 8;
 
+      const size_t total_length = FrameLength(gbuffer_);
       if (total_length > sizeof(gbuffer_)) {
         // cannot read whole packet, so probably error in size, skip to next
-        found_header_ = false;
-        gbuffer_fill = 0;
+        ReparseBuffer();
         continue;
       }
 
       // Take remaining bytes up to the requested length
-      size_t bytes_to_take = etl::min(len, total_length - gbuffer_fill);
+      const size_t bytes_to_take = etl::min(len, total_length - gbuffer_fill);
       memcpy(&gbuffer_[gbuffer_fill], buffer, bytes_to_take);
       gbuffer_fill += bytes_to_take;
       buffer += bytes_to_take;
@@ -115,26 +71,72 @@ size_t UbxGpsDriver::ProcessBytes(const uint8_t *buffer, size_t len) {
         return total_length - gbuffer_fill;
       }
 
-      if (!ValidateChecksum(gbuffer_, total_length)) {
-        // invalid packet, reset header
-        found_header_ = false;
+      if (ValidateChecksum(gbuffer_, total_length)) {
+        ProcessUbxPacket(gbuffer_ + 2, total_length - 4);
+        success++;
         gbuffer_fill = 0;
+      } else {
         error++;
-        continue;
+        ReparseBuffer();
       }
+      continue;
+    }
 
-      ProcessUbxPacket(gbuffer_ + 2, gbuffer_fill - 4);
-      success++;
+    // Fast path: decode complete frames in place, without copying them out of the (DMA) buffer
+    const auto header_start = static_cast<const uint8_t *>(memchr(buffer, 0xb5, len));
+    if (header_start == nullptr) {
+      // reject the whole input, we don't have 0xb5
+      return 1;
+    }
+    // Throw away all bytes before the header start
+    len -= (header_start - buffer);
+    buffer = header_start;
+
+    if (len >= 2 && buffer[1] != 0x62) {
+      // we had the 0xb5 but didn't get 0x62, skip it
+      buffer++;
+      len--;
+      continue;
+    }
+    const size_t total_length = len >= HEADER_SIZE ? FrameLength(buffer) : 0;
+    if (total_length > sizeof(gbuffer_)) {
+      // cannot read whole packet, so probably error in size, skip to next
+      buffer++;
+      len--;
+      continue;
+    }
+    if (len < HEADER_SIZE || len < total_length) {
+      // The frame continues in the next buffer, keep the part we have (buffer might point into gbuffer_)
+      memmove(gbuffer_, buffer, len);
+      gbuffer_fill = len;
+      return (len < HEADER_SIZE ? HEADER_SIZE : total_length) - len;
+    }
 
-      found_header_ = false;
-      gbuffer_fill = 0;
+    if (!ValidateChecksum(buffer, total_length)) {
+      // invalid packet, the header might have been payload, resync right after it
+      error++;
+      buffer++;
+      len--;
+      continue;
     }
+    ProcessUbxPacket(buffer + 2, total_length - 4);
+    success++;
+    buffer += total_length;
+    len -= total_length;
   }
 
   // get the next byte
   return 1;
 }
 
+void UbxGpsDriver::ReparseBuffer() {
+  // The header was bogus (e.g. line noise), the following bytes may contain the start of a valid frame.
+  // Re-parse them from the fast path, which only keeps a trailing partial frame.
+  const size_t stale = gbuffer_fill - 1;
+  gbuffer_fill = 0;
+  ProcessBytes(gbuffer_ + 1, stale);
+}
+
 bool UbxGpsDriver::ValidateChecksum(const uint8_t *packet, size_t size) {
   uint8_t ck_a, ck_b;
   CalculateChecksum(packet + 2, size - 4, ck_a, ck_b);
@@ -148,18 +150,40 @@ bool UbxGpsDriver::ValidateChecksum(const uint8_t *packet, size_t size) {
   return valid;
 }
 
+constexpr UbxGpsDriver::MessageHandler UbxGpsDriver::MESSAGE_HANDLERS[] = {
+    Handle<UbxNavPvt, &UbxGpsDriver::HandleNavPvt>(),
+    Handle<UbxNavCov, &UbxGpsDriver::HandleNavCov>(),
+    Handle<UbxNavRelPosNed, &UbxGpsDriver::HandleNavRelPosNed>(),
+    Handle<UbxNavEoe, &UbxGpsDriver::HandleNavEoe>(),
+    Handle<UbxRxmRtcm, &UbxGpsDriver::HandleRxmRtcm>(),
+};
+
+namespace {
+template <size_t N>
+constexpr bool HasUniqueKeys(const UbxGpsDriver::MessageHandler (&handlers)[N]) {
+  for (size_t i = 0; i < N; i++) {
+    for (size_t j = i + 1; j < N; j++) {
+      if (handlers[i].key == handlers[j].key) return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
 void UbxGpsDriver::ProcessUbxPacket(const uint8_t *data, const size_t &size) {
   // data = no header bytes (starts with class) and stops before checksum
+  static_assert(HasUniqueKeys(MESSAGE_HANDLERS), "UBX message registered twice");
 
-  uint16_t packet_id = data[0] << 8 | data[1];
-  if (packet_id == (UbxNavPvt::CLASS_ID << 8 | UbxNavPvt::MESSAGE_ID)) {
+  const uint16_t key = UbxMessageKey(data[0], data[1]);
+  for (const auto &handler : MESSAGE_HANDLERS) {
+    if (handler.key != key) continue;
     // substract class, id and length
-    if (size - 4 == sizeof(UbxNavPvt)) {
-      const auto *msg = reinterpret_cast<const UbxNavPvt *>(data + 4);
-      HandleNavPvt(msg);
+    if (size - 4 == handler.payload_size) {
+      handler.handle(*this, data + 4);
     } else {
-      ULOG_WARNING("size mismatch for PVT message!");
+      ULOG_WARNING("size mismatch for UBX message 0x%04X!", key);
     }
+    return;
   }
 }
 
@@ -214,39 +238,125 @@ void UbxGpsDriver::HandleNavPvt(const UbxNavPvt *msg) {
 
   // Number of satellites used in the solution
   gps_state_.num_sv = msg->numSV;
+  gps_state_.pdop = msg->pDOP / 100.0;
 
   double headAcc = (msg->headAcc / 100000.0) * (M_PI / 180.0);
 
-  double hedVeh = msg->headVeh / 100000.0;
-  hedVeh = -hedVeh * (M_PI / 180.0);
-  hedVeh = fmod(hedVeh + (M_PI_2), 2.0 * M_PI);
-  while (hedVeh < 0) {
-    hedVeh += M_PI * 2.0;
-  }
-
-  double headMotion = msg->headMot / 100000.0;
-  headMotion = -headMotion * (M_PI / 180.0);
-  headMotion = fmod(headMotion + (M_PI_2), 2.0 * M_PI);
-  while (headMotion < 0) {
-    headMotion += M_PI * 2.0;
-  }
+  double hedVeh = HeadingToEnu(msg->headVeh);
+  double headMotion = HeadingToEnu(msg->headMot);
 
   // There's no flag for that. Assume it's good
   gps_state_.motion_heading_valid = true;
   gps_state_.motion_heading = headMotion;
   gps_state_.motion_heading_accuracy = headAcc;
 
-  // headAcc is the same for both
-  gps_state_.vehicle_heading_valid = (msg->flags & 0b100000) >> 5;
-  gps_state_.vehicle_heading_accuracy = headAcc;
-  gps_state_.vehicle_heading = hedVeh;
+  // headAcc is the same for both. With a moving base, NAV-RELPOSNED provides the vehicle heading.
+  if (!moving_base_) {
+    gps_state_.vehicle_heading_valid = (msg->flags & 0b100000) >> 5;
+    gps_state_.vehicle_heading_accuracy = headAcc;
+    gps_state_.vehicle_heading = hedVeh;
+  }
 
   gps_state_.sensor_time = msg->iTOW;
-  gps_state_.received_time = 0;
 
   gps_state_valid_ = true;
 
-  TriggerStateCallback();
+  if (!end_of_epoch_seen_) {
+    TriggerStateCallback();
+  }
+}
+
+void UbxGpsDriver::HandleNavRelPosNed(const UbxNavRelPosNed *msg) {
+  if (msg->version != 1) {
+    return;
+  }
+  gps_state_.relative_position_valid = (msg->flags & UbxNavRelPosNed::FLAGS_REL_POS_VALID) != 0;
+  if (gps_state_.relative_position_valid) {
+    // cm + 0.1 mm high precision part
+    const double n = msg->relPosN / 100.0 + msg->relPosHPN / 10000.0;
+    const double e = msg->relPosE / 100.0 + msg->relPosHPE / 10000.0;
+    const double d = msg->relPosD / 100.0 + msg->relPosHPD / 10000.0;
+    gps_state_.relative_position[0] = e;
+    gps_state_.relative_position[1] = n;
+    gps_state_.relative_position[2] = -d;
+    gps_state_.relative_position_accuracy[0] = msg->accE / 10000.0;
+    gps_state_.relative_position_accuracy[1] = msg->accN / 10000.0;
+    gps_state_.relative_position_accuracy[2] = msg->accD / 10000.0;
+    gps_state_.relative_position_length = msg->relPosLength / 100.0 + msg->relPosHPLength / 10000.0;
+  }
+
+  // With a fixed base, relPosHeading is the bearing from the base to the rover, not a heading.
+  // Leave the vehicle heading to NAV-PVT then.
+  moving_base_ = (msg->flags & UbxNavRelPosNed::FLAGS_IS_MOVING) != 0;
+  if (!moving_base_) {
+    return;
+  }
+
+  // True heading from the moving base, replaces the (sensor fusion) vehicle heading of NAV-PVT
+  gps_state_.vehicle_heading_valid = (msg->flags & UbxNavRelPosNed::FLAGS_REL_POS_HEADING_VALID) != 0;
+  if (gps_state_.vehicle_heading_valid) {
+    gps_state_.vehicle_heading = HeadingToEnu(msg->relPosHeading);
+    gps_state_.vehicle_heading_accuracy = (msg->accHeading / 100000.0) * (M_PI / 180.0);
+  }
+}
+
+void UbxGpsDriver::HandleNavCov(const UbxNavCov *msg) {
+  // NED -> ENU: swap north and east, negate the cross terms with down
+  gps_state_.position_covariance_valid = msg->posCovValid != 0;
+  if (gps_state_.position_covariance_valid) {
+    double *cov = gps_state_.position_covariance;
+    cov[0] = msg->posCovEE;
+    cov[1] = cov[3] = msg->posCovNE;
+    cov[2] = cov[6] = -msg->posCovED;
+    cov[4] = msg->posCovNN;
+    cov[5] = cov[7] = -msg->posCovND;
+    cov[8] = msg->posCovDD;
+  }
+  gps_state_.velocity_covariance_valid = msg->velCovValid != 0;
+  if (gps_state_.velocity_covariance_valid) {
+    double *cov = gps_state_.velocity_covariance;
+    cov[0] = msg->velCovEE;
+    cov[1] = cov[3] = msg->velCovNE;
+    cov[2] = cov[6] = -msg->velCovED;
+    cov[4] = msg->velCovNN;
+    cov[5] = cov[7] = -msg->velCovND;
+    cov[8] = msg->velCovDD;
+  }
+}
+
+void UbxGpsDriver::HandleNavEoe(const UbxNavEoe *msg) {
+  end_of_epoch_seen_ = true;
+  // Only report complete epochs, NAV-PVT is the one we can't do without
+  if (gps_state_valid_ && gps_state_.sensor_time == msg->iTOW) {
+    TriggerStateCallback();
+  }
+}
+
+void UbxGpsDriver::HandleRxmRtcm(const UbxRxmRtcm *msg) {
+  auto &rtcm = gps_state_.rtcm;
+  if (msg->flags & UbxRxmRtcm::FLAGS_CRC_FAILED) {
+    rtcm.crc_failed++;
+    return;
+  }
+  if ((msg->flags & UbxRxmRtcm::FLAGS_MSG_USED_MASK) == UbxRxmRtcm::MSG_USED_NOT_USED) {
+    rtcm.not_used++;
+  } else {
+    rtcm.used++;
+  }
+  rtcm.last_message_type = msg->msgType;
+  if (last_rtcm_time_ != 0) {
+    rtcm.last_latency_ms = TIME_I2MS(chVTTimeElapsedSinceX(last_rtcm_time_));
+  }
+}
+
+double UbxGpsDriver::HeadingToEnu(int32_t heading) {
+  double result = heading / 100000.0;
+  result = -result * (M_PI / 180.0);
+  result = fmod(result + (M_PI_2), 2.0 * M_PI);
+  while (result < 0) {
+    result += M_PI * 2.0;
+  }
+  return result;
 }
 
 void UbxGpsDriver::CalculateChecksum(const uint8_t *packet, size_t size, uint8_t &ck_a, uint8_t &ck_b) {
@@ -260,8 +370,9 @@ void UbxGpsDriver::CalculateChecksum(const uint8_t *packet, size_t size, uint8_t
 }
 
 void UbxGpsDriver::ResetParserState() {
-  found_header_ = false;
   gbuffer_fill = 0;
+  end_of_epoch_seen_ = false;
+  moving_base_ = false;
 }
 
 }  // namespace xbot::driver::gps
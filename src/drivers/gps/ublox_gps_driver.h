@@ -28,13 +28,45 @@ class UbxGpsDriver : public GpsDriver {
    */
   bool SendPacket(uint8_t *data, size_t size);
 
+  // sync chars, class, id, length
+  static constexpr size_t HEADER_SIZE = 6;
+  // Largest frame we can buffer (header, payload and checksum)
+  static constexpr size_t MAX_FRAME_SIZE = 512;
+
+  /**
+   * Entry of the message dispatch table: the handler is only called for frames with the exact payload size.
+   */
+  struct MessageHandler {
+    uint16_t key;
+    uint16_t payload_size;
+    void (*handle)(UbxGpsDriver &driver, const uint8_t *payload);
+  };
+
+  template <typename T, void (UbxGpsDriver::*Handler)(const T *)>
+  static constexpr MessageHandler Handle() {
+    static_assert(sizeof(T) + 8 <= MAX_FRAME_SIZE, "message doesn't fit into the frame buffer");
+    return {UbxMessageKey(T::CLASS_ID, T::MESSAGE_ID), sizeof(T), [](UbxGpsDriver &driver, const uint8_t *payload) {
+              (driver.*Handler)(reinterpret_cast<const T *>(payload));
+            }};
+  }
+
+  static const MessageHandler MESSAGE_HANDLERS[];
+
   /**
-   * Parses the rx buffer and looks for valid ubx messages
+   * Parses the rx buffer and looks for valid ubx messages.
+   * Frames which are completely contained in the buffer are decoded in place,
+   * only a frame which continues in the next buffer is copied to gbuffer_.
    */
   size_t ProcessBytes(const uint8_t *buffer, size_t len) override;
 
   /**
-   * Gets called with a valid ubx frame and switches to the handle_xxx functions
+   * Drops the partial frame in gbuffer_ after its header turned out to be invalid
+   * and parses the remaining bytes again
+   */
+  void ReparseBuffer();
+
+  /**
+   * Gets called with a valid ubx frame and dispatches it to the HandleXxx() functions via MESSAGE_HANDLERS
    */
   void ProcessUbxPacket(const uint8_t *data, const size_t &size);
 
@@ -49,12 +81,28 @@ class UbxGpsDriver : public GpsDriver {
   void CalculateChecksum(const uint8_t *packet, size_t size, uint8_t &ck_a, uint8_t &ck_b);
 
   void HandleNavPvt(const UbxNavPvt *msg);
+  void HandleNavRelPosNed(const UbxNavRelPosNed *msg);
+  void HandleNavCov(const UbxNavCov *msg);
+  void HandleNavEoe(const UbxNavEoe *msg);
+  void HandleRxmRtcm(const UbxRxmRtcm *msg);
+
+  // Converts a UBX heading (1e-5 deg, clockwise from north) to rad, counter-clockwise from east in [0, 2pi)
+  static double HeadingToEnu(int32_t heading);
+
+  // Total frame length (header, payload and checksum) from a header
+  static size_t FrameLength(const uint8_t *header) {
+    return (header[5] << 8 | header[4]) + 8;
+  }
 
-  uint8_t gbuffer_[512]{};
+  // Holds a partial frame until the rest arrives
+  uint8_t gbuffer_[MAX_FRAME_SIZE]{};
   size_t gbuffer_fill = 0;
 
-  // flag if we found the header for time tracking only
-  bool found_header_ = false;
+  // Once the receiver sends UBX-NAV-EOE, the state callback is deferred to the end of the epoch,
+  // so that it includes all messages of the epoch (NAV-COV, NAV-RELPOSNED follow NAV-PVT).
+  bool end_of_epoch_seen_ = false;
+  // Set while UBX-NAV-RELPOSNED reports a moving base, which then owns the vehicle heading
+  bool moving_base_ = false;
 };
 }  // namespace xbot::driver::gps
 
@@ -6,8 +6,15 @@
 #ifndef XBOT_DRIVER_GPS_UBX_DATATYPES_H
 #define XBOT_DRIVER_GPS_UBX_DATATYPES_H
 
+#include <cstdint>
+
 namespace xbot::driver::gps {
 
+// Class and message ID combined into one key, as used by the UBX dispatch table
+constexpr uint16_t UbxMessageKey(uint8_t class_id, uint8_t message_id) {
+  return static_cast<uint16_t>(class_id << 8 | message_id);
+}
+
 #pragma pack(push, 1)
 struct UbxNavPvt {
   enum {
@@ -76,7 +83,107 @@ struct UbxNavPvt {
   int16_t magDec;
   uint16_t magAcc;
 } __attribute__((packed));
+
+// Version 1 (F9 series)
+struct UbxNavRelPosNed {
+  enum {
+    CLASS_ID = 1u,
+    MESSAGE_ID = 0x3Cu,
+    FLAGS_GNSS_FIX_OK = 1u,
+    FLAGS_DIFF_SOLN = 2u,
+    FLAGS_REL_POS_VALID = 4u,
+    FLAGS_CARR_SOLN_MASK = 24u,
+    CARR_SOLN_FLOAT = 8u,
+    CARR_SOLN_FIXED = 16u,
+    FLAGS_IS_MOVING = 32u,
+    FLAGS_REF_POS_MISS = 64u,
+    FLAGS_REF_OBS_MISS = 128u,
+    FLAGS_REL_POS_HEADING_VALID = 256u,
+    FLAGS_REL_POS_NORMALIZED = 512u,
+  };
+
+  uint8_t version;
+  uint8_t reserved0;
+  uint16_t refStationId;
+  uint32_t iTOW;
+  int32_t relPosN;
+  int32_t relPosE;
+  int32_t relPosD;
+  int32_t relPosLength;
+  int32_t relPosHeading;
+  uint8_t reserved1[4];
+  int8_t relPosHPN;
+  int8_t relPosHPE;
+  int8_t relPosHPD;
+  int8_t relPosHPLength;
+  uint32_t accN;
+  uint32_t accE;
+  uint32_t accD;
+  uint32_t accLength;
+  uint32_t accHeading;
+  uint8_t reserved2[4];
+  uint32_t flags;
+} __attribute__((packed));
+
+struct UbxNavCov {
+  enum {
+    CLASS_ID = 1u,
+    MESSAGE_ID = 0x36u,
+  };
+
+  uint32_t iTOW;
+  uint8_t version;
+  uint8_t posCovValid;
+  uint8_t velCovValid;
+  uint8_t reserved0[9];
+  float posCovNN;
+  float posCovNE;
+  float posCovND;
+  float posCovEE;
+  float posCovED;
+  float posCovDD;
+  float velCovNN;
+  float velCovNE;
+  float velCovND;
+  float velCovEE;
+  float velCovED;
+  float velCovDD;
+} __attribute__((packed));
+
+struct UbxNavEoe {
+  enum {
+    CLASS_ID = 1u,
+    MESSAGE_ID = 0x61u,
+  };
+
+  uint32_t iTOW;
+} __attribute__((packed));
+
+struct UbxRxmRtcm {
+  enum {
+    CLASS_ID = 2u,
+    MESSAGE_ID = 0x32u,
+    FLAGS_CRC_FAILED = 1u,
+    FLAGS_MSG_USED_MASK = 6u,
+    MSG_USED_UNKNOWN = 0u,
+    MSG_USED_NOT_USED = 2u,
+    MSG_USED_USED = 4u,
+  };
+
+  uint8_t version;
+  uint8_t flags;
+  uint16_t subType;
+  uint16_t refStation;
+  uint16_t msgType;
+} __attribute__((packed));
 #pragma pack(pop)
+
+// Payload sizes from the interface description, the dispatch table only accepts frames of exactly this size
+static_assert(sizeof(UbxNavPvt) == 92, "UBX-NAV-PVT size mismatch");
+static_assert(sizeof(UbxNavRelPosNed) == 64, "UBX-NAV-RELPOSNED size mismatch");
+static_assert(sizeof(UbxNavCov) == 64, "UBX-NAV-COV size mismatch");
+static_assert(sizeof(UbxNavEoe) == 4, "UBX-NAV-EOE size mismatch");
+static_assert(sizeof(UbxRxmRtcm) == 8, "UBX-RXM-RTCM size mismatch");
 }  // namespace xbot::driver::gps
 
 #endif  // XBOT_DRIVER_GPS_UBX_DATATYPES_H
@@ -6,6 +6,7 @@
 #include <globals.hpp>
 #include <json_stream.hpp>
 #include <services.hpp>
+#include <services/emergency_service/emergency_stop.hpp>
 
 namespace xbot::driver::input {
 
@@ -35,18 +36,24 @@ bool GpioInputDriver::OnInputConfigValue(lwjson_stream_parser_t* jsp, const char
   return false;
 }
 
-static void LineCallback(void*) {
+static void LineCallback(void* arg) {
+  const auto* input = static_cast<const Input*>(arg);
+  // Latching emergencies without delay stop the motors right away, the input service only reports them
+  if ((input->emergency_reason & EmergencyReason::LATCH) && input->emergency_delay_ms == 0 &&
+      (palReadLine(input->gpio.line) == PAL_HIGH) != input->invert) {
+    xbot::emergency_stop::TriggerFromISR(input->emergency_reason);
+  }
   input_service.SendEvent(Events::GPIO_TRIGGERED);
 }
 
 bool GpioInputDriver::OnStart() {
-  for (const auto& input : Inputs()) {
+  for (auto& input : Inputs()) {
     palSetLineMode(input.gpio.line, PAL_MODE_INPUT);
 
     // We're limited with EXTI's -> Only go-on and enable interrupts
     // for inputs that have an emergency reason configured
     if (input.emergency_reason == 0) continue;
-    palSetLineCallback(input.gpio.line, LineCallback, nullptr);
+    palSetLineCallback(input.gpio.line, LineCallback, &input);
     palEnableLineEvent(input.gpio.line, PAL_EVENT_MODE_BOTH_EDGES);
   }
   return true;
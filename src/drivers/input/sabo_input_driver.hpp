@@ -95,8 +95,8 @@ class SaboInputDriver : public InputDriver {
 
   void Tick();
 
-  ServiceSchedule tick_schedule_{input_service, 20'000,
-                                 XBOT_FUNCTION_FOR_METHOD(SaboInputDriver, &SaboInputDriver::Tick, this)};
+  MonitoredSchedule tick_schedule_{input_service, 20'000,
+                                   XBOT_FUNCTION_FOR_METHOD(SaboInputDriver, &SaboInputDriver::Tick, this)};
 };
 
 }  // namespace xbot::driver::input
@@ -32,8 +32,8 @@ class WorxInputDriver : public InputDriver {
   bool ReadKeypad(KeypadResponse& response) const;
 
   void tick();
-  ServiceSchedule tick_schedule_{input_service, 20'000,
-                                 XBOT_FUNCTION_FOR_METHOD(WorxInputDriver, &WorxInputDriver::tick, this)};
+  MonitoredSchedule tick_schedule_{input_service, 20'000,
+                                   XBOT_FUNCTION_FOR_METHOD(WorxInputDriver, &WorxInputDriver::tick, this)};
 };
 }  // namespace xbot::driver::input
 
@@ -5,6 +5,7 @@
 #ifndef MOTOR_DRIVER_HPP
 #define MOTOR_DRIVER_HPP
 
+#include <ch.h>
 #include <etl/delegate.h>
 
 #include <cstdint>
@@ -35,6 +36,9 @@ class MotorDriver {
     float rpm;
 
     ESCStatus status;
+
+    // Timebase ticks (xbot::timebase) when the values were captured, i.e. when the status frame arrived
+    uint64_t capture_ticks;
   };
 
   typedef etl::delegate<void(const ESCState &new_state)> StateCallback;
@@ -42,7 +46,27 @@ class MotorDriver {
   virtual ~MotorDriver() = default;
 
   virtual void RequestStatus() = 0;
-  virtual void SetDuty(float duty) = 0;
+
+  // Sends zero instead while the driver is stopped (see Stop())
+  void SetDuty(float duty) {
+    chMtxLock(&duty_mutex_);
+    ApplyDuty(stopped_ ? 0 : duty);
+    chMtxUnlock(&duty_mutex_);
+  }
+
+  // Sends zero duty and latches it, so a SetDuty() racing with the stop can't start the motor again
+  void Stop() {
+    chMtxLock(&duty_mutex_);
+    stopped_ = true;
+    ApplyDuty(0);
+    chMtxUnlock(&duty_mutex_);
+  }
+
+  void ReleaseStop() {
+    chMtxLock(&duty_mutex_);
+    stopped_ = false;
+    chMtxUnlock(&duty_mutex_);
+  }
 
   virtual bool Start() {
     chDbgAssert(!started_, "Don't start twice");
@@ -72,8 +96,13 @@ class MotorDriver {
   }
   ESCState latest_state_{};
 
+  // Called by SetDuty() and Stop() with the duty mutex held
+  virtual void ApplyDuty(float duty) = 0;
+
  private:
   bool started_ = false;
+  MUTEX_DECL(duty_mutex_);
+  bool stopped_ = false;
   StateCallback state_callback_{};
 };
 }  // namespace xbot::driver::motor
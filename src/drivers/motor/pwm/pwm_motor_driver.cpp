@@ -6,6 +6,8 @@
 
 #include <ch.h>
 
+#include <xbot/timebase.hpp>
+
 namespace xbot::driver::motor {
 
 void PwmMotorDriver::SetPWM(PWMDriver* pwm, pwmchannel_t channel1, pwmchannel_t channel2) {
@@ -22,10 +24,11 @@ void PwmMotorDriver::RequestStatus() {
   chSysLock();
   latest_state_.tacho = tacho;
   latest_state_.tacho_absolute = tacho_abs;
+  latest_state_.capture_ticks = timebase::NowTicks();
   chSysUnlock();
   NotifyCallback();
 }
-void PwmMotorDriver::SetDuty(float duty) {
+void PwmMotorDriver::ApplyDuty(float duty) {
   if (duty > 0) {
     pwmEnableChannel(pwm_, channel_1_, (0xFFF * 4) * duty);
     pwmEnableChannel(pwm_, channel_2_, 0);
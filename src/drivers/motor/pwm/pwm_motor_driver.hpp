@@ -17,9 +17,11 @@ class PwmMotorDriver : public MotorDriver {
   void SetPWM(PWMDriver* pwm, pwmchannel_t channel1, pwmchannel_t channel2);
   void SetEncoder(uint32_t line_encoder_a, uint32_t line_encoder_b);
   void RequestStatus() override;
-  void SetDuty(float duty) override;
   bool Start() override;
 
+ protected:
+  void ApplyDuty(float duty) override;
+
  private:
   PWMDriver* pwm_ = nullptr;
   pwmchannel_t channel_1_ = 0, channel_2_ = 0;
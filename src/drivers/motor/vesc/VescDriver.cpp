@@ -4,9 +4,13 @@
 
 #include "VescDriver.h"
 
+#include <xbot/timebase.hpp>
+
 #include "buffer.h"
 #include "crc.h"
 #include "datatypes.h"
+#include "nocache.hpp"
+#include "thread_priorities.h"
 
 static constexpr uint32_t EVT_ID_RECEIVED = 1;
 static constexpr uint32_t EVT_ID_EXPECT_PACKET = 2;
@@ -25,6 +29,9 @@ bool VescDriver::SetUART(UARTDriver* uart, uint32_t baudrate) {
   this->uart_ = uart;
   uart_config_.speed = baudrate;
   uart_config_.context = this;
+  // Character match on the frame trailer, used to timestamp the frames
+  uart_config_.cr2 = (0x03 << USART_CR2_ADD_Pos);
+  uart_config_.cr1 |= USART_CR1_CMIE;
 
   return true;
 }
@@ -95,6 +102,9 @@ void VescDriver::ProcessPayload() {
                                  : ESCState::ESCStatus::ESC_STATUS_OK;
       index += 4;  // 4 bytes - mc_interface_get_pid_pos_now()
       latest_state_.direction = latest_state_.rpm < 0;
+      chSysLock();
+      latest_state_.capture_ticks = rx_frame_end_ticks_;
+      chSysUnlock();
       break;
     default:
       // ignore
@@ -176,7 +186,7 @@ void VescDriver::SendPacket() {
   payload_buffer_.payload[payload_buffer_.payload_length + 1] = static_cast<uint8_t>(crcPayload & 0xFF);
   payload_buffer_.payload[payload_buffer_.payload_length + 2] = 3;
   size_t total_size = payload_buffer_.payload_length + 5;
-  uartSendFullTimeout(uart_, &total_size, &payload_buffer_.prepend[3], TIME_INFINITE);
+  tx_queue_.Send(&payload_buffer_.prepend[3], total_size);
 }
 
 void VescDriver::RequestStatus() {
@@ -193,7 +203,7 @@ void VescDriver::RequestStatus() {
   chMtxUnlock(&mutex_);
 }
 
-void VescDriver::SetDuty(float duty) {
+void VescDriver::ApplyDuty(float duty) {
   if (IsRawMode()) {
     // ignore when a raw data stream is connected
     return;
@@ -215,9 +225,8 @@ void VescDriver::RawDataInput(uint8_t* data, size_t size) {
   if (!IsStarted()) {
     return;
   }
-  // Lock mutex so that during transmission we don't start a second one
   chMtxLock(&mutex_);
-  uartSendFullTimeout(uart_, &size, data, TIME_INFINITE);
+  tx_queue_.Send(data, size);
   // Signal that we are waiting for a response, so the receiving thread becomes active
   chEvtSignal(processing_thread_, EVT_ID_EXPECT_PACKET);
   chMtxUnlock(&mutex_);
@@ -227,6 +236,26 @@ bool VescDriver::Start() {
   if (IsStarted()) {
     return false;
   }
+  if (recv_buffer1_ == nullptr) {
+    recv_buffer1_ = nocache::Alloc<uint8_t>(RECV_BUFFER_SIZE);
+    recv_buffer2_ = nocache::Alloc<uint8_t>(RECV_BUFFER_SIZE);
+    processing_buffer_ = recv_buffer2_;
+  }
+  uart_config_.txend1_cb = [](UARTDriver* uartp) {
+    chSysLockFromISR();
+    VescDriver* instance = reinterpret_cast<const UARTConfigEx*>(uartp->config)->context;
+    chDbgAssert(instance != nullptr, "instance cannot be null!");
+    // DMA is done with the last transfer, chain the next one
+    instance->tx_queue_.OnTxEndI();
+    chSysUnlockFromISR();
+  };
+  tx_queue_.Init(uart_, TX_QUEUE_SIZE);
+  uart_config_.rx_cm_cb = [](UARTDriver* uartp) {
+    chSysLockFromISR();
+    VescDriver* instance = reinterpret_cast<const UARTConfigEx*>(uartp->config)->context;
+    instance->rx_frame_end_ticks_ = timebase::NowTicks();
+    chSysUnlockFromISR();
+  };
   bool uartStarted = uartStart(uart_, &uart_config_) == MSG_OK;
   if (!uartStarted) {
     return false;
@@ -259,7 +288,7 @@ bool VescDriver::Start() {
     chSysUnlockFromISR();
   };
 
-  processing_thread_ = chThdCreateStatic(&thd_wa_, sizeof(thd_wa_), NORMALPRIO, threadHelper, this);
+  processing_thread_ = chThdCreateStatic(&thd_wa_, sizeof(thd_wa_), THD_PRIO_MOTOR_CONTROL, threadHelper, this);
 #ifdef USE_SEGGER_SYSTEMVIEW
   processing_thread_->name = "VESCDriver";
 #endif
@@ -313,7 +342,7 @@ void VescDriver::threadFunc() {
       if (processing_done_) {
         // Stop reception and get the partial received length
         uint8_t* next_recv_buffer = processing_buffer_;
-        chDbgAssert(uart_->dmarx->stream->M0AR != (uint32_t)(next_recv_buffer), "invalid buffer");
+        chDbgAssert(uart_->dmarx->stream->M0AR != (uint32_t)(uintptr_t)(next_recv_buffer), "invalid buffer");
         size_t not_received_len = uartStopReceiveI(uart_);
         uartStartReceiveI(uart_, RECV_BUFFER_SIZE, next_recv_buffer);
         if (not_received_len != UART_ERR_NOT_ACTIVE) {
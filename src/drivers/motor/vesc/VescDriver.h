@@ -10,12 +10,20 @@
 #include <cstdint>
 #include <debug/debuggable_driver.hpp>
 #include <drivers/motor/motor_driver.hpp>
+#include <drivers/uart/uart_tx_queue.hpp>
 
 #include "ch.h"
 #include "hal.h"
 
+namespace xbot::debug {
+class ParserBenchmark;
+}  // namespace xbot::debug
+
 namespace xbot::driver::motor {
 class VescDriver : public DebuggableDriver, public MotorDriver {
+  // Feeds synthetic streams directly into ProcessBytes()
+  friend class xbot::debug::ParserBenchmark;
+
  public:
   VescDriver();
 
@@ -23,12 +31,18 @@ class VescDriver : public DebuggableDriver, public MotorDriver {
 
   bool SetUART(UARTDriver *uart, uint32_t baudrate);
   void RequestStatus() override;
-  void SetDuty(float duty) override;
 
   void RawDataInput(uint8_t *data, size_t size) override;
 
   bool Start() override;
 
+  uart::UartTxQueue::Stats GetTxStats() const {
+    return tx_queue_.GetStats();
+  }
+
+ protected:
+  void ApplyDuty(float duty) override;
+
  private:
 #pragma pack(push, 1)
   struct VescPayload {
@@ -46,6 +60,9 @@ class VescDriver : public DebuggableDriver, public MotorDriver {
   // A buffer to prepare the next payload, so that we don't need to allocate on the stack
   // make sure to lock mutex_ before using.
   VescPayload payload_buffer_{};
+  // Finished packets are copied here and sent by DMA, so callers never wait for the UART
+  static constexpr size_t TX_QUEUE_SIZE = 512;
+  uart::UartTxQueue tx_queue_{};
   THD_WORKING_AREA(thd_wa_, 1024){};
   // Milliseconds for automatic status requests. 0 to disable
   uint32_t status_request_millis_ = 0;
@@ -58,11 +75,12 @@ class VescDriver : public DebuggableDriver, public MotorDriver {
   static constexpr size_t RECV_BUFFER_SIZE = 260;
   uint32_t last_status_request_millis_ticks_ = 0;
 
-  // Keep two buffers for streaming data while doing processing
-  uint8_t recv_buffer1_[RECV_BUFFER_SIZE]{};
-  uint8_t recv_buffer2_[RECV_BUFFER_SIZE]{};
+  // Keep two buffers for streaming data while doing processing.
+  // DMA targets, allocated from the non-cacheable region in Start().
+  uint8_t *recv_buffer1_ = nullptr;
+  uint8_t *recv_buffer2_ = nullptr;
   // We start by receiving into recv_buffer1, so processing_buffer is the 2 (but empty)
-  uint8_t *volatile processing_buffer_ = recv_buffer2_;
+  uint8_t *volatile processing_buffer_ = nullptr;
   volatile size_t processing_buffer_len_ = 0;
 
   // working buffer for the receiving thread
@@ -71,6 +89,10 @@ class VescDriver : public DebuggableDriver, public MotorDriver {
   uint8_t working_buffer_[260];
   bool found_header_ = false;
 
+  // Timebase ticks of the last frame trailer byte (0x03), captured by the character match ISR.
+  // Payload bytes can match as well, but the last match before a complete frame is its trailer.
+  volatile uint64_t rx_frame_end_ticks_ = 0;
+
   UARTDriver *uart_{};
   UARTConfigEx uart_config_{};
   thread_t *processing_thread_ = nullptr;
@@ -6,9 +6,12 @@
 
 #include <cstdio>
 #include <cstring>
+#include <xbot/timebase.hpp>
 
 #include "cobs.h"
 #include "crc16_hw.hpp"
+#include "nocache.hpp"
+#include "thread_priorities.h"
 #define LOG_TAG_STR "YFR4esc"
 #include "ulog_rate_limit.hpp"
 
@@ -72,6 +75,9 @@ void YFR4escDriver::ProcessDecodedPacket(uint8_t* packet, size_t len) {
       latest_state_.tacho = sp.tacho;
       latest_state_.tacho_absolute = sp.tacho_absolute;
       latest_state_.rpm = static_cast<float>(sp.rpm);
+      chSysLock();
+      latest_state_.capture_ticks = rx_frame_end_ticks_;
+      chSysUnlock();
       latest_state_.status =
           sp.fault_code == 0 ? ESCState::ESCStatus::ESC_STATUS_OK : ESCState::ESCStatus::ESC_STATUS_ERROR;
 
@@ -119,7 +125,7 @@ void YFR4escDriver::ProcessRxBytes(const volatile uint8_t* data, size_t len) {
   }
 }
 
-void YFR4escDriver::SetDuty(float duty) {
+void YFR4escDriver::ApplyDuty(float duty) {
   if (!IsStarted() || IsRawMode()) return;
   last_duty_ = duty;
   SendControl(duty);
@@ -130,7 +136,7 @@ void YFR4escDriver::SendControl(float duty) {
   const uint8_t* payload = reinterpret_cast<const uint8_t*>(&cp);
   cp.crc = yfr4esc_crc::crc16_ccitt_false(payload, sizeof(ControlPacket) - sizeof(cp.crc));
 
-  chMtxLock(&mutex_);  // protect shared tx_buffer_ and send
+  chMtxLock(&mutex_);  // protect shared tx_buffer_
   size_t len = cobs_encode(reinterpret_cast<const uint8_t*>(&cp), sizeof(cp), tx_buffer_);
   if (len + 1 > TX_BUFFER_SIZE) {
     ULOGT_EVERY_MS(WARNING, 1000, "TX control frame too large: len=%u", (unsigned)len);
@@ -138,8 +144,9 @@ void YFR4escDriver::SendControl(float duty) {
     return;
   }
   tx_buffer_[len++] = 0;  // COBS end marker
-  uartSendFullTimeout(uart_, &len, tx_buffer_, TIME_INFINITE);
+  const bool queued = tx_queue_.Send(tx_buffer_, len);
   chMtxUnlock(&mutex_);
+  if (!queued) ULOGT_EVERY_MS(WARNING, 1000, "TX queue full, frame dropped");
 }
 
 void YFR4escDriver::SendSettings() {
@@ -154,7 +161,7 @@ void YFR4escDriver::SendSettings() {
   const uint8_t* payload = reinterpret_cast<const uint8_t*>(&sp);
   sp.crc = yfr4esc_crc::crc16_ccitt_false(payload, sizeof(SettingsPacket) - sizeof(sp.crc));
 
-  chMtxLock(&mutex_);  // protect shared tx_buffer_ and send
+  chMtxLock(&mutex_);  // protect shared tx_buffer_
   size_t len = cobs_encode(reinterpret_cast<const uint8_t*>(&sp), sizeof(SettingsPacket), tx_buffer_);
   if (len + 1 > TX_BUFFER_SIZE) {
     ULOGT_EVERY_MS(WARNING, 1000, "TX settings frame too large: len=%u", (unsigned)len);
@@ -162,23 +169,24 @@ void YFR4escDriver::SendSettings() {
     return;
   }
   tx_buffer_[len++] = 0;  // COBS end marker
-  uartSendFullTimeout(uart_, &len, tx_buffer_, TIME_INFINITE);
+  const bool queued = tx_queue_.Send(tx_buffer_, len);
   chMtxUnlock(&mutex_);
+  if (!queued) ULOGT_EVERY_MS(WARNING, 1000, "TX queue full, frame dropped");
 }
 
 void YFR4escDriver::RawDataInput(uint8_t* data, size_t size) {
   if (!IsRawMode() || !IsStarted()) return;
-  chMtxLock(&mutex_);
-  size_t len = size > TX_BUFFER_SIZE ? TX_BUFFER_SIZE : size;
-  memcpy(tx_buffer_, data, len);
-  uartSendFullTimeout(uart_, &len, tx_buffer_, TIME_INFINITE);
-  chMtxUnlock(&mutex_);
+  tx_queue_.Send(data, size);
 }
 
 bool YFR4escDriver::Start() {
   chDbgAssert(!IsStarted(), "don't start the driver twice");
   if (IsStarted()) return false;
 
+  if (dma_rx_buffer_ == nullptr) {
+    dma_rx_buffer_ = nocache::Alloc<uint8_t>(DMA_RX_BUFFER_SIZE);
+  }
+
   // Configure RX buffer-full (DMA wrap) callback
   uart_config_.rxend_cb = [](UARTDriver* uartp) {
     chSysLockFromISR();
@@ -196,17 +204,29 @@ bool YFR4escDriver::Start() {
     chSysLockFromISR();
     YFR4escDriver* instance = reinterpret_cast<const UARTConfigEx*>(uartp->config)->context;
     chDbgAssert(instance != nullptr, "instance cannot be null!");
+    // The delimiter is the last byte of the frame, so this is the frame's arrival time
+    instance->rx_frame_end_ticks_ = timebase::NowTicks();
     if (instance->processing_thread_) chEvtSignalI(instance->processing_thread_, EVT_RX_CHAR_MATCH);
     chSysUnlockFromISR();
   };
 
+  // TX complete: chain the next queued transfer
+  uart_config_.txend1_cb = [](UARTDriver* uartp) {
+    chSysLockFromISR();
+    YFR4escDriver* instance = reinterpret_cast<const UARTConfigEx*>(uartp->config)->context;
+    chDbgAssert(instance != nullptr, "instance cannot be null!");
+    instance->tx_queue_.OnTxEndI();
+    chSysUnlockFromISR();
+  };
+  tx_queue_.Init(uart_, TX_QUEUE_SIZE);
+
   if (!(uartStart(uart_, &uart_config_) == MSG_OK)) return false;
 
   // Set the started flag before launching the thread to avoid race where IsStarted() is false in threadFunc
   if (!MotorDriver::Start()) return false;
 
   // Now start the processing thread; IsStarted() should be true now and the thread will spin
-  processing_thread_ = chThdCreateStatic(&thd_wa_, sizeof(thd_wa_), NORMALPRIO, threadHelper, this);
+  processing_thread_ = chThdCreateStatic(&thd_wa_, sizeof(thd_wa_), THD_PRIO_MOTOR_CONTROL, threadHelper, this);
 #ifdef USE_SEGGER_SYSTEMVIEW
   processing_thread_->name = "YFR4escDriver";
 #endif
@@ -8,13 +8,21 @@
 #include <cstdint>
 #include <debug/debuggable_driver.hpp>
 #include <drivers/motor/motor_driver.hpp>
+#include <drivers/uart/uart_tx_queue.hpp>
 
 #include "ch.h"
 #include "datatypes.h"
 #include "hal.h"
 
+namespace xbot::debug {
+class ParserBenchmark;
+}  // namespace xbot::debug
+
 namespace xbot::driver::motor {
 class YFR4escDriver : public DebuggableDriver, public MotorDriver {
+  // Feeds synthetic streams directly into ProcessRxBytes()
+  friend class xbot::debug::ParserBenchmark;
+
  public:
   YFR4escDriver() {
     latest_state_.status = ESCState::ESCStatus::ESC_STATUS_DISCONNECTED;
@@ -24,11 +32,17 @@ class YFR4escDriver : public DebuggableDriver, public MotorDriver {
   bool SetUART(UARTDriver* uart, uint32_t baudrate);
 
   void RequestStatus() override{};  // No-op, ESC streams status periodically
-  void SetDuty(float duty) override;
   bool Start() override;
 
   void RawDataInput(uint8_t* data, size_t size) override;
 
+  uart::UartTxQueue::Stats GetTxStats() const {
+    return tx_queue_.GetStats();
+  }
+
+ protected:
+  void ApplyDuty(float duty) override;
+
  private:
   // Heartbeat: resend control regularly to satisfy ESC watchdog
   static constexpr systime_t HEARTBEAT_INTERVAL = TIME_MS2I(100);  // 10 Hz
@@ -43,9 +57,10 @@ class YFR4escDriver : public DebuggableDriver, public MotorDriver {
   static constexpr size_t RX_MAX_PKT_DECODED = sizeof(yfr4esc::StatusPacket);
   static constexpr size_t RX_MAX_PKT_CODED = RX_MAX_PKT_DECODED + (RX_MAX_PKT_DECODED / 254) + 1;  // COBS worst-case
 
-  // RX DMA buffer holds two full encoded frames + delimiter for wrap/delta comfort
+  // RX DMA buffer holds two full encoded frames + delimiter for wrap/delta comfort.
+  // Allocated from the non-cacheable region in Start().
   static constexpr size_t DMA_RX_BUFFER_SIZE = 2 * (RX_MAX_PKT_CODED + 1);
-  volatile uint8_t dma_rx_buffer_[DMA_RX_BUFFER_SIZE]{};
+  volatile uint8_t* dma_rx_buffer_ = nullptr;
 
   // COBS RX buffer (enough for one full encoded Status frame (without trailing 0))
   static constexpr size_t COBS_BUFFER_SIZE = RX_MAX_PKT_CODED;
@@ -53,7 +68,7 @@ class YFR4escDriver : public DebuggableDriver, public MotorDriver {
   // Decoded buffer holds one Status frame
   uint8_t cobs_decoded_[RX_MAX_PKT_DECODED]{};
 
-  // DMA-safe TX buffer (avoid sending from stack/DTCM)
+  // COBS encode buffer for TX frames, make sure to lock mutex_ before using
   static constexpr size_t TX_MAX_PKT_DECODED = (sizeof(yfr4esc::ControlPacket) > sizeof(yfr4esc::SettingsPacket))
                                                    ? sizeof(yfr4esc::ControlPacket)
                                                    : sizeof(yfr4esc::SettingsPacket);
@@ -61,6 +76,12 @@ class YFR4escDriver : public DebuggableDriver, public MotorDriver {
   // One full encoded TX frame including trailing 0
   static constexpr size_t TX_BUFFER_SIZE = TX_MAX_PKT_CODED + 1;
   uint8_t tx_buffer_[TX_BUFFER_SIZE]{};
+  // Frames are copied here and sent by DMA, so SetDuty() never waits for the UART
+  static constexpr size_t TX_QUEUE_SIZE = 128;
+  uart::UartTxQueue tx_queue_{};
+
+  // Timebase ticks of the last frame delimiter, captured by the character match ISR
+  volatile uint64_t rx_frame_end_ticks_ = 0;
 
   size_t cobs_rx_len_ = 0;
   size_t rx_seen_len_ = 0;  // Track how many bytes we already processed in the receiving DMA buffer
@@ -1,4 +1,4 @@
-// CRC16-CCITT-FALSE helper for YFR4 ESC (STM32H7 HW only)
+// CRC16-CCITT-FALSE helper for YFR4 ESC (STM32H7 HW, software fallback for the host build)
 // - Polynomial: 0x1021, Init: 0xFFFF, RefIn/RefOut: false, XorOut: 0x0000
 // - Feeds bytes MSB-first semantics via CRC peripheral with REV_IN/REV_OUT disabled.
 // - Thread-safety: guarded by a lightweight mutex (blocking). Not ISR-safe.
@@ -11,7 +11,12 @@
 #include "ch.h"
 #include "hal.h"
 
+#ifndef CRC
+#include <etl/crc16_ccitt.h>
+#endif
+
 namespace yfr4esc_crc {
+#ifdef CRC
 // HW CRC compute; assumes STM32H7 CRC peripheral
 static inline uint16_t crc16_ccitt_false_hw(const uint8_t* data, size_t len) {
   // Enable and configure CRC peripheral once
@@ -56,5 +61,11 @@ static inline uint16_t crc16_ccitt_false(const uint8_t* data, size_t len) {
   chMtxUnlock(&mtx);
   return out;
 }
+#else
+// No CRC peripheral (HostSim), etl's CRC16/CCITT uses the same parameters
+static inline uint16_t crc16_ccitt_false(const uint8_t* data, size_t len) {
+  return etl::crc16_ccitt(data, data + len).value();
+}
+#endif
 
 }  // namespace yfr4esc_crc
@@ -0,0 +1,100 @@
+//
+// Non-blocking UART transmit queue, see uart_tx_queue.hpp.
+//
+
+#include "uart_tx_queue.hpp"
+
+#include <etl/algorithm.h>
+
+#include <cstring>
+
+#include "nocache.hpp"
+
+namespace xbot::driver::uart {
+
+void UartTxQueue::Init(UARTDriver* uart, size_t size) {
+  chDbgAssert((size & (size - 1)) == 0, "size must be a power of two");
+  chMtxLock(&mutex_);
+  if (buffer_ == nullptr) {
+    buffer_ = nocache::Alloc<uint8_t>(size);
+    size_ = size;
+  }
+  uart_ = uart;
+  chMtxUnlock(&mutex_);
+}
+
+bool UartTxQueue::Queue(const void* data, size_t size) {
+  if (size == 0) {
+    return true;
+  }
+  if (buffer_ == nullptr) {
+    return false;
+  }
+  chMtxLock(&mutex_);
+
+  // The ISR only frees space, so the free space can only grow while we copy
+  const size_t fill = head_ - tail_;
+  if (size > size_ - fill) {
+    stats_.bytes_dropped += size;
+    chMtxUnlock(&mutex_);
+    return false;
+  }
+  stats_.max_fill = etl::max<uint32_t>(stats_.max_fill, fill + size);
+
+  // Copy in up to two parts (ring wrap), the region between head_ and tail_ is not touched by the DMA
+  const auto* src = static_cast<const uint8_t*>(data);
+  const size_t offset = head_ & (size_ - 1);
+  const size_t first = etl::min(size, size_ - offset);
+  memcpy(&buffer_[offset], src, first);
+  memcpy(buffer_, src + first, size - first);
+
+  chSysLock();
+  head_ = head_ + size;
+  chSysUnlock();
+
+  chMtxUnlock(&mutex_);
+  return true;
+}
+
+void UartTxQueue::Flush() {
+  if (buffer_ == nullptr) {
+    return;
+  }
+  chSysLock();
+  if (in_flight_ == 0) {
+    StartNextI();
+  }
+  chSysUnlock();
+}
+
+void UartTxQueue::OnTxEndI() {
+  tail_ = tail_ + in_flight_;
+  stats_.bytes_sent += in_flight_;
+  in_flight_ = 0;
+  StartNextI();
+}
+
+void UartTxQueue::StartNextI() {
+  const size_t pending = head_ - tail_;
+  if (pending == 0) {
+    return;
+  }
+  // One DMA transfer covers everything up to the end of the ring, the rest is chained from OnTxEndI()
+  const size_t offset = tail_ & (size_ - 1);
+  in_flight_ = etl::min(pending, size_ - offset);
+  stats_.transfers++;
+  uartStartSendI(uart_, in_flight_, &buffer_[offset]);
+}
+
+size_t UartTxQueue::Fill() const {
+  return head_ - tail_;
+}
+
+UartTxQueue::Stats UartTxQueue::GetStats() const {
+  chSysLock();
+  const Stats stats = stats_;
+  chSysUnlock();
+  return stats;
+}
+
+}  // namespace xbot::driver::uart
@@ -0,0 +1,80 @@
+//
+// Non-blocking UART transmit queue.
+//
+// Send() copies the data into a ring buffer in the non-cacheable region and returns.
+// The ring is transmitted by DMA; the driver owning the UART forwards its txend1_cb
+// to OnTxEndI(), which starts the next transfer. Everything queued while a transfer
+// is running goes out as one DMA transfer (up to the ring wrap).
+//
+
+#ifndef UART_TX_QUEUE_HPP
+#define UART_TX_QUEUE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ch.h"
+#include "hal.h"
+
+namespace xbot::driver::uart {
+
+class UartTxQueue {
+ public:
+  struct Stats {
+    uint32_t bytes_sent;
+    // Bytes rejected by Send() because the ring was full
+    uint32_t bytes_dropped;
+    uint32_t transfers;
+    // Highest ring fill level seen by Send()
+    uint32_t max_fill;
+  };
+
+  /**
+   * Allocates the ring (size must be a power of two) and binds the queue to the UART.
+   * The UART must be started before the first Send().
+   */
+  void Init(UARTDriver* uart, size_t size);
+
+  /**
+   * Queues data for transmission and starts the DMA if it's idle. Never blocks on the UART.
+   * @return false if the ring doesn't have enough space, nothing is queued then
+   */
+  bool Send(const void* data, size_t size) {
+    const bool queued = Queue(data, size);
+    Flush();
+    return queued;
+  }
+
+  // Like Send(), but doesn't start the DMA, so that several messages can go out in one transfer.
+  bool Queue(const void* data, size_t size);
+  // Starts the transmission of everything queued (if not already running)
+  void Flush();
+
+  // To be called from the UART's txend1_cb (with the system locked from ISR)
+  void OnTxEndI();
+
+  // Bytes currently queued or in flight
+  size_t Fill() const;
+  Stats GetStats() const;
+
+ private:
+  void StartNextI();
+
+  UARTDriver* uart_ = nullptr;
+  uint8_t* buffer_ = nullptr;
+  size_t size_ = 0;
+
+  // Absolute positions (modulo 2^32): Send() advances head_, OnTxEndI() advances tail_
+  volatile uint32_t head_ = 0;
+  volatile uint32_t tail_ = 0;
+  volatile size_t in_flight_ = 0;
+
+  Stats stats_{};
+
+  // Serializes writers, the ISR only touches tail_ and in_flight_
+  MUTEX_DECL(mutex_);
+};
+
+}  // namespace xbot::driver::uart
+
+#endif  // UART_TX_QUEUE_HPP
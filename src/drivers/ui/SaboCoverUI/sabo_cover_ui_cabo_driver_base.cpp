@@ -5,9 +5,15 @@
 
 #include <ulog.h>
 
+#include "nocache.hpp"
+
 namespace xbot::driver::ui {
 
 bool SaboCoverUICaboDriverBase::Init() {
+  if (spi_buf_ == nullptr) {
+    spi_buf_ = nocache::Alloc<uint8_t>(SPI_BUF_SIZE);
+  }
+
   spi_config_ = {
       .circular = false,
       .slave = false,
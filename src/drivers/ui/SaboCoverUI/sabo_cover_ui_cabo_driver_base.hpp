@@ -59,6 +59,8 @@ class SaboCoverUICaboDriverBase {
  protected:
   const xbot::driver::sabo::config::CoverUi* cover_ui_cfg_;
   SPIConfig spi_config_;
+  static constexpr size_t SPI_BUF_SIZE = 4;
+  uint8_t* spi_buf_ = nullptr;  // SPI DMA buffer, allocated from the non-cacheable region in Init()
   SaboCoverUISeriesInterface* series_ = nullptr;  // Series-I/II specific driver
 
   struct LEDState {
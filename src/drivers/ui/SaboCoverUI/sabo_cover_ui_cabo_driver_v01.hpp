@@ -51,8 +51,7 @@ class SaboCoverUICaboDriverV01 : public SaboCoverUICaboDriverBase {
   void LatchLoad() override {
     if (!series_) return;
 
-    uint8_t tx_data = current_led_mask_ | series_->GetButtonRowMask();
-    uint8_t rx_data;
+    spi_buf_[0] = current_led_mask_ | series_->GetButtonRowMask();
 
     // SPI transfer LEDs+ButtonRow and read button for previously set row
     spiAcquireBus(cover_ui_cfg_->spi.instance);
@@ -61,11 +60,12 @@ class SaboCoverUICaboDriverV01 : public SaboCoverUICaboDriverBase {
     // Enable HC165 shifting, but this will also set HEF4794BT latch open! = low-glowing LEDs
     palWriteLine(pins_.latch_load, PAL_HIGH);
     palWriteLine(pins_.btn_cs, PAL_LOW);
-    spiExchange(cover_ui_cfg_->spi.instance, 1, &tx_data, &rx_data);  // Full duplex send and receive
+    spiExchange(cover_ui_cfg_->spi.instance, 1, &spi_buf_[0], &spi_buf_[1]);  // Full duplex send and receive
     palWriteLine(pins_.btn_cs, PAL_HIGH);
     palWriteLine(pins_.latch_load, PAL_LOW);  // Close HEF4794BT latch (and /PL of HC165)
 
     spiReleaseBus(cover_ui_cfg_->spi.instance);
+    uint8_t rx_data = spi_buf_[1];
 
     // Buffer / Shift & buffer depending on current row, as well as advance to next row
     // FIXME: Use now DebounceRawButtons()
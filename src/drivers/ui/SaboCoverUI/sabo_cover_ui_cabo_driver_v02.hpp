@@ -19,6 +19,7 @@
 #include <ulog.h>
 
 #include <cassert>
+#include <cstring>
 
 #include "sabo_cover_ui_cabo_driver_base.hpp"
 #include "sabo_cover_ui_series1_v02.hpp"
@@ -116,7 +117,8 @@ class SaboCoverUICaboDriverV02 : public SaboCoverUICaboDriverBase {
     spiAcquireBus(cover_ui_cfg_->spi.instance);
 
     spiStart(cover_ui_cfg_->spi.instance, &spi_config_);
-    spiSend(cover_ui_cfg_->spi.instance, 1, &tx_data);  // Send tx_data to HEF4794
+    spi_buf_[0] = tx_data;
+    spiSend(cover_ui_cfg_->spi.instance, 1, spi_buf_);  // Send tx_data to HEF4794
     palWriteLine(pins_.s2_latch, PAL_HIGH);             // Latch HEF4794
     chThdSleepMicroseconds(1);
     palWriteLine(pins_.s2_latch, PAL_LOW);  // Close HEF4794 latch
@@ -129,7 +131,7 @@ class SaboCoverUICaboDriverV02 : public SaboCoverUICaboDriverBase {
    * It's required to do this in two steps, because HC595 get latched by rising edge of SH/PL of HC165
    */
   void LatchLoadSR() {
-    assert(sr_load_size_ <= sizeof(sr_load_buf_));
+    assert(sr_load_size_ <= sizeof(sr_load_buf_) && sr_load_size_ <= SPI_BUF_SIZE);
 
     spiAcquireBus(cover_ui_cfg_->spi.instance);
 
@@ -137,16 +139,18 @@ class SaboCoverUICaboDriverV02 : public SaboCoverUICaboDriverBase {
     palWriteLine(pins_.latch_load, PAL_LOW);  // HC165 /PL (parallel load) pulse, also blocks shifting
     if (sr_load_size_ == 3) palWriteLine(pins_.s2_load, PAL_LOW);  // S2- /PL
     chThdSleepMicroseconds(1);
-    spiSend(cover_ui_cfg_->spi.instance, 1, &cabo_sr_ctrl_mask_);  // Send data to HC595
+    spi_buf_[0] = cabo_sr_ctrl_mask_;
+    spiSend(cover_ui_cfg_->spi.instance, 1, spi_buf_);  // Send data to HC595
     chThdSleepMicroseconds(1);
     palWriteLine(pins_.latch_load, PAL_HIGH);  // HC165 shift enable & latch HC595 (RCLK rising edge)
     if (sr_load_size_ == 3) palWriteLine(pins_.s2_load, PAL_HIGH);  // S2- HC165 shift enable
     chThdSleepMicroseconds(1);
-    spiReceive(cover_ui_cfg_->spi.instance, sr_load_size_, sr_load_buf_);
+    spiReceive(cover_ui_cfg_->spi.instance, sr_load_size_, spi_buf_);
     palWriteLine(pins_.latch_load, PAL_LOW);                       // Need to block HC165 shifting again
     if (sr_load_size_ == 3) palWriteLine(pins_.s2_load, PAL_LOW);  // S2- /PL
 
     spiReleaseBus(cover_ui_cfg_->spi.instance);
+    memcpy(sr_load_buf_, spi_buf_, sr_load_size_);
 
     // Extract Cabo's sr_inp_mask_ out of the received bytes, which may differ dependent of the connected CoverUI
     // Series. If a Series-II is connected it shift its own HC165 byte first.
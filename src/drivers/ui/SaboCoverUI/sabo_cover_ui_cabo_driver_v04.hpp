@@ -108,7 +108,7 @@ class SaboCoverUICaboDriverV04 : public SaboCoverUICaboDriverBase {
    * @param tx_data
    */
   uint8_t Series2LatchLoad(uint8_t tx_data) {
-    uint8_t rx_data = 0;
+    spi_buf_[0] = tx_data;
 
     spiAcquireBus(cover_ui_cfg_->spi.instance);
 
@@ -117,7 +117,7 @@ class SaboCoverUICaboDriverV04 : public SaboCoverUICaboDriverBase {
     palWriteLine(pins_.s2_load, PAL_HIGH);  // Set S2-Load to high to enable HC165 shifting
 
     // Send LEDs (& button rows) and read button columns
-    spiExchange(cover_ui_cfg_->spi.instance, 1, &tx_data, &rx_data);
+    spiExchange(cover_ui_cfg_->spi.instance, 1, &spi_buf_[0], &spi_buf_[1]);
 
     palWriteLine(pins_.s2_latch, PAL_HIGH);  // Latch HEF4794
     palWriteLine(pins_.s2_load, PAL_LOW);    // Set S2-Load to low to block HC165 shifting
@@ -125,7 +125,7 @@ class SaboCoverUICaboDriverV04 : public SaboCoverUICaboDriverBase {
 
     spiReleaseBus(cover_ui_cfg_->spi.instance);
 
-    return rx_data;
+    return spi_buf_[1];
   }
 
   SaboCoverUISeriesInterface* GetSeriesDriver() override {
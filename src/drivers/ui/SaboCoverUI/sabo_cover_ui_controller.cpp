@@ -28,6 +28,7 @@
 #include "sabo_cover_ui_cabo_driver_v04.hpp"
 #include "sabo_cover_ui_cabo_driver_v05.hpp"
 #include "sabo_cover_ui_display.hpp"
+#include "thread_priorities.h"
 
 namespace xbot::driver::ui {
 
@@ -114,7 +115,7 @@ void SaboCoverUIController::Start() {
     }
   }
 
-  thread_ = chThdCreateStatic(&wa_, sizeof(wa_), NORMALPRIO, ThreadHelper, this);
+  thread_ = chThdCreateStatic(&wa_, sizeof(wa_), THD_PRIO_UI, ThreadHelper, this);
 #ifdef USE_SEGGER_SYSTEMVIEW
   thread_->name = "SaboCoverUIController";
 #endif
@@ -34,9 +34,17 @@
 
 #include <ulog.h>
 
+#include "debug/cycle_benchmark.hpp"
+#include "nocache.hpp"
+#include "thread_priorities.h"
+
 namespace xbot::driver::ui {
 
 bool SaboCoverUIDisplayDriverUC1698::Init() {
+  if (pending_flush_.buffer == nullptr) {
+    pending_flush_.buffer = nocache::Alloc<uint8_t>(buffer_size_);
+  }
+
   // Init SPI pins
   if (lcd_cfg_.spi.instance != nullptr) {
     palSetLineMode(lcd_cfg_.spi.pins.sck, PAL_MODE_ALTERNATE(5) | PAL_STM32_OSPEED_MID2);
@@ -86,7 +94,7 @@ void SaboCoverUIDisplayDriverUC1698::Start() {
     ULOG_WARNING("LCD settings file not found, using defaults");
   }
 
-  thread_ = chThdCreateStatic(&wa_, sizeof(wa_), NORMALPRIO, ThreadHelper, this);
+  thread_ = chThdCreateStatic(&wa_, sizeof(wa_), THD_PRIO_UI, ThreadHelper, this);
 #ifdef USE_SEGGER_SYSTEMVIEW
   thread_->name = "SaboCoverUIDisplayDriverUC1698";
 #endif
@@ -170,13 +178,18 @@ void SaboCoverUIDisplayDriverUC1698::LVGLFlushCB(lv_display_t* disp, const lv_ar
   (void)disp;
   auto& driver = SaboCoverUIDisplayDriverUC1698::Instance();
   uint8_t* buf = driver.pending_flush_.buffer;
-  // driver.profile_.flush_start = chVTGetSystemTimeX();
+#ifdef CYCLE_BENCHMARK
+  driver.flush_start_ = chSysGetRealtimeCounterX();
+#endif
 
   int width = area->x2 - area->x1 + 1;
   int height = area->y2 - area->y1 + 1;
   int total_pixels = width * height;
   int blocks = total_pixels / 24;
 
+  CYCLE_BENCHMARK_STATS(convert_stats, "lcd_convert");
+  CYCLE_BENCHMARK_SCOPE(convert_stats, total_pixels / 2);
+
   const uint8_t* src = px_map + 8;  // Skip 2*4 byte palette
 
   // Fill buffer with 2 pixels per byte
@@ -219,6 +232,7 @@ void SaboCoverUIDisplayDriverUC1698::SendCommand(const uint8_t cmd) {
   spiStart(lcd_cfg_.spi.instance, &spi_config_);
   spiSelect(lcd_cfg_.spi.instance);
   SetCmdMode();
+  nocache::FlushForDma(&cmd, 1);
   spiSend(lcd_cfg_.spi.instance, 1, &cmd);
   spiUnselect(lcd_cfg_.spi.instance);
   spiReleaseBus(lcd_cfg_.spi.instance);
@@ -229,6 +243,7 @@ void SaboCoverUIDisplayDriverUC1698::SendCommands(const uint8_t* data, size_t si
   spiStart(lcd_cfg_.spi.instance, &spi_config_);
   spiSelect(lcd_cfg_.spi.instance);
   SetCmdMode();
+  nocache::FlushForDma(data, size);
   spiSend(lcd_cfg_.spi.instance, size, data);
   spiUnselect(lcd_cfg_.spi.instance);
   spiReleaseBus(lcd_cfg_.spi.instance);
@@ -238,6 +253,7 @@ void SaboCoverUIDisplayDriverUC1698::SendData(const uint8_t* data, size_t size)
   spiAcquireBus(lcd_cfg_.spi.instance);
   // ClrCS();
   SetDataMode();
+  nocache::FlushForDma(data, size);
   spiSend(lcd_cfg_.spi.instance, size, data);
   // SetCS();
   spiReleaseBus(lcd_cfg_.spi.instance);
@@ -271,10 +287,12 @@ void SaboCoverUIDisplayDriverUC1698::SetWindowProgramAreaRaw(uint8_t t_x1, uint8
       (0xf6), (uint8_t)((int8_t)((t_x2 + 1) / 3) - 1),  // (32) Ending Column Address
       (uint8_t)(0xf8 | t_outside_mode)                  // Windows Program Mode (0 = inside, 1 = outside)
   };
+  nocache::FlushForDma(data, sizeof(data));
   spiSend(lcd_cfg_.spi.instance, sizeof(data), data);
 }
 
 void SaboCoverUIDisplayDriverUC1698::ThreadFunc() {
+  CYCLE_BENCHMARK_STATS(flush_stats, "lcd_flush");
   InitController();  // Initialize the LCD controller (loads settings and applies them)
 
   event_listener_t event_listener;
@@ -285,8 +303,6 @@ void SaboCoverUIDisplayDriverUC1698::ThreadFunc() {
     eventflags_t flags = chEvtGetAndClearFlags(&event_listener);
 
     if (flags & static_cast<eventmask_t>(TransferEvent::ASYNC_BUF_READY)) {
-      // profile_.spi_start = chVTGetSystemTimeX();
-
       spiAcquireBus(lcd_cfg_.spi.instance);
       transfer_state_ = TransferState::SYNC;
       spiStart(lcd_cfg_.spi.instance, &spi_config_);
@@ -306,10 +322,7 @@ void SaboCoverUIDisplayDriverUC1698::ThreadFunc() {
       spiUnselect(lcd_cfg_.spi.instance);
       spiReleaseBus(lcd_cfg_.spi.instance);
       transfer_state_ = TransferState::IDLE;
-      /*profile_.spi_end = chVTGetSystemTimeX();
-      ULOG_INFO("UC1698 (%d bytes): Flush->SPI %lu us, SPI %lu us, Flush total %lu us", pending_flush_.size,
-                TIME_I2US(profile_.spi_start - profile_.flush_start), TIME_I2US(profile_.spi_end - profile_.spi_start),
-                TIME_I2US(profile_.spi_end - profile_.flush_start));*/
+      CYCLE_BENCHMARK_ADD(flush_stats, flush_start_, pending_flush_.size);
     }
   }
 }
@@ -87,9 +87,9 @@ class SaboCoverUIDisplayDriverUC1698 {
   // With UC1698u RRRR-GGGG-BBBB, 4k-color mode, we send 2 pixels per byte (3 bytes per sextet)
   static constexpr size_t buffer_size_ = defs::LCD_WIDTH * defs::LCD_HEIGHT / defs::BUFFER_FRACTION / 2;
   struct AsyncFlush {
-    lv_area_t area;  // Area in buffer
-    uint8_t buffer[buffer_size_];
-    size_t size = 0;  // Size of buffer
+    lv_area_t area;             // Area in buffer
+    uint8_t* buffer = nullptr;  // SPI DMA source, allocated from the non-cacheable region in Init()
+    size_t size = 0;            // Size of buffer
   };
   AsyncFlush pending_flush_;
 
@@ -107,10 +107,9 @@ class SaboCoverUIDisplayDriverUC1698 {
     ASYNC_TX_DONE = EVENT_MASK(1),    // SPI-Transfer done. spiUnselect, spiRelease, inform lvgl
   };
 
-  // Some benchmarking vars
-  /*struct Profile {
-    systime_t flush_start, spi_start, spi_end;
-  } profile_;*/
+#ifdef CYCLE_BENCHMARK
+  rtcnt_t flush_start_ = 0;  // LVGLFlushCB() start, for measuring the whole flush incl. SPI transfer
+#endif
 
   // clang-format off
   // Reset (RST)
@@ -17,8 +17,11 @@
 #include <HighLevelServiceBase.hpp>
 #include <globals.hpp>
 #include <json_stream.hpp>
+#include <nocache.hpp>
 #include <services.hpp>
 
+#include "thread_priorities.h"
+
 namespace xbot::driver::ui {
 
 using namespace xbot::driver::input;
@@ -51,6 +54,10 @@ void YFCoverUI::Start(UARTDriver* uart) {
     return;
   }
 
+  if (dma_rx_buffer_ == nullptr) {
+    dma_rx_buffer_ = nocache::Alloc<uint8_t>(DMA_RX_BUFFER_SIZE);
+  }
+
   uart_ = uart;
   uart_config_.speed = 115200;  // 8N1 by default (cr1/cr2/cr3 left at 0 apart from char-match below)
   uart_config_.context = this;
@@ -79,13 +86,23 @@ void YFCoverUI::Start(UARTDriver* uart) {
     chSysUnlockFromISR();
   };
 
+  // TX complete callback: chain the next queued transfer.
+  uart_config_.txend1_cb = [](UARTDriver* uartp) {
+    chSysLockFromISR();
+    YFCoverUI* instance = reinterpret_cast<const UARTConfigEx*>(uartp->config)->context;
+    chDbgAssert(instance != nullptr, "instance cannot be null!");
+    instance->tx_queue_.OnTxEndI();
+    chSysUnlockFromISR();
+  };
+  tx_queue_.Init(uart_, TX_QUEUE_SIZE);
+
   if (uartStart(uart_, &uart_config_) != MSG_OK) {
     ULOG_ERROR("YFCoverUI: uartStart() failed!");
     uart_ = nullptr;
     return;
   }
 
-  thread_ = chThdCreateStatic(&wa_, sizeof(wa_), NORMALPRIO - 1, ThreadHelper, this);
+  thread_ = chThdCreateStatic(&wa_, sizeof(wa_), THD_PRIO_UI, ThreadHelper, this);
 #ifdef USE_SEGGER_SYSTEMVIEW
   thread_->name = "YFCoverUI";
 #endif
@@ -322,7 +339,9 @@ void YFCoverUI::SendMessage(const void* msg, size_t size) {
   size_t enc_len = CobsEncode(static_cast<const uint8_t*>(msg), size, tx_buf_);
   tx_buf_[enc_len++] = 0x00;  // COBS packet delimiter
 
-  uartSendFullTimeout(uart_, &enc_len, tx_buf_, TIME_INFINITE);
+  if (!tx_queue_.Send(tx_buf_, enc_len)) {
+    ULOG_WARNING("YFCoverUI: TX queue full, frame dropped");
+  }
 }
 
 void YFCoverUI::SendVersionRequest() {
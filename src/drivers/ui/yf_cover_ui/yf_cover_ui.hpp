@@ -30,9 +30,14 @@
 #include <lwjson/lwjson.h>
 
 #include <drivers/input/input_driver.hpp>
+#include <drivers/uart/uart_tx_queue.hpp>
 
 #include "yf_cover_ui_protocol.hpp"
 
+namespace xbot::debug {
+class ParserBenchmark;
+}  // namespace xbot::debug
+
 namespace xbot::driver::ui {
 
 using namespace xbot::driver::input;
@@ -71,6 +76,9 @@ constexpr uint8_t YFCoverUIChannelButtonId(uint8_t ch) {
 }
 
 class YFCoverUI : public InputDriver {
+  // Feeds synthetic streams directly into ProcessRxBytes()
+  friend class xbot::debug::ParserBenchmark;
+
  public:
   /**
    * @brief Start the YF Cover UI driver on the given UART port.
@@ -159,10 +167,11 @@ class YFCoverUI : public InputDriver {
   // queue incoming bytes, so we receive into a circular DMA buffer and process NDTR deltas
   // on the comms thread. Sized to hold two full encoded frames so a wrap never overruns
   // an in-flight frame. Largest received message is sizeof(msg_event_rain)=12 bytes.
+  // Allocated from the non-cacheable region in Start().
   static constexpr size_t RX_MAX_PKT_DECODED = sizeof(msg_event_rain);
   static constexpr size_t RX_MAX_PKT_CODED = RX_MAX_PKT_DECODED + (RX_MAX_PKT_DECODED / 254) + 1;  // COBS worst case
   static constexpr size_t DMA_RX_BUFFER_SIZE = 2 * (RX_MAX_PKT_CODED + 1);
-  volatile uint8_t dma_rx_buffer_[DMA_RX_BUFFER_SIZE]{};
+  volatile uint8_t* dma_rx_buffer_ = nullptr;
   size_t rx_seen_len_ = 0;  ///< how many bytes of dma_rx_buffer_ the thread has already consumed
 
   // COBS reassembly buffer (one encoded frame, delimiter excluded) and decoded payload buffer.
@@ -172,10 +181,13 @@ class YFCoverUI : public InputDriver {
   static constexpr size_t DECODE_BUF_SIZE = 24;
   uint8_t decode_buf_[DECODE_BUF_SIZE]{};
 
-  // DMA-safe TX buffer (avoid sending from the stack/DTCM). Only ever written/sent on the
-  // comms thread, so no locking is required. Largest sent message is sizeof(msg_set_leds)=12.
+  // COBS encode buffer. Only ever written on the comms thread, so no locking is required.
+  // Largest sent message is sizeof(msg_set_leds)=12.
   static constexpr size_t TX_BUF_SIZE = 32;
   uint8_t tx_buf_[TX_BUF_SIZE]{};
+  // Encoded frames are copied here and sent by DMA, so the comms thread never waits for the UART.
+  static constexpr size_t TX_QUEUE_SIZE = 128;
+  uart::UartTxQueue tx_queue_{};
 
   // Thread
   THD_WORKING_AREA(wa_, 2048);
@@ -201,10 +213,10 @@ class YFCoverUI : public InputDriver {
 
   // ---- Protocol TX ----
   /**
-   * @brief COBS-encode a raw message into tx_buf_ and write it to the UART.
+   * @brief COBS-encode a raw message into tx_buf_ and queue it for the UART.
    *
-   * Appends the 0x00 packet delimiter after the encoded payload. No-op if the
-   * UART is not configured. Must only be called from the comms thread (tx_buf_
+   * Appends the 0x00 packet delimiter after the encoded payload. Returns without
+   * waiting for the transmission. No-op if the UART is not configured. Must only be called from the comms thread (tx_buf_
    * is shared without locking).
    * @param msg   Pointer to the raw (unencoded) message bytes.
    * @param size  Number of bytes to send from @p msg.
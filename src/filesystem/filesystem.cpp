@@ -9,6 +9,8 @@
 #include "hal_serial_nor.h"
 #include "lfs.h"
 
+#include <cstring>
+
 static uint8_t lfs_read_buffer[FS_CACHE_SIZE];
 static uint8_t lfs_write_buffer[FS_CACHE_SIZE];
 static uint8_t lfs_lookahead_buffer[FS_LOOKAHEAD_SIZE];
@@ -24,25 +26,43 @@ const WSPIConfig WSPIcfg1 = {.end_cb = nullptr,
 
 static const SNORConfig snorcfg1 = {.busp = &WSPID1, .buscfg = &WSPIcfg1};
 static SNORDriver snor1;
-static snor_nocache_buffer_t snor_buffer;
+CC_SECTION(".nocache") static snor_nocache_buffer_t snor_buffer;
+// WSPI (MDMA) bounce buffer, so that littlefs can pass any (cacheable) buffer. Guarded by flash_mutex_.
+CC_SECTION(".nocache") static uint8_t flash_dma_buffer[FS_CACHE_SIZE];
 
 lfs_t lfs;
 
 static int read_flash(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size) {
-  if (snor_device_read(&snor1, block * c->block_size + off, size, static_cast<uint8_t *>(buffer)) == FLASH_NO_ERROR) {
-    return LFS_ERR_OK;
+  auto *dst = static_cast<uint8_t *>(buffer);
+  flash_offset_t addr = block * c->block_size + off;
+  while (size > 0) {
+    lfs_size_t chunk = size < sizeof(flash_dma_buffer) ? size : sizeof(flash_dma_buffer);
+    if (snor_device_read(&snor1, addr, chunk, flash_dma_buffer) != FLASH_NO_ERROR) {
+      return LFS_ERR_IO;
+    }
+    memcpy(dst, flash_dma_buffer, chunk);
+    dst += chunk;
+    addr += chunk;
+    size -= chunk;
   }
-  return LFS_ERR_IO;
+  return LFS_ERR_OK;
 }
 
 static int write_flash(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer,
                        lfs_size_t size) {
-  if (snor_device_program(&snor1, block * c->block_size + off, size, static_cast<const uint8_t *>(buffer)) ==
-      FLASH_NO_ERROR) {
-    return LFS_ERR_OK;
+  auto *src = static_cast<const uint8_t *>(buffer);
+  flash_offset_t addr = block * c->block_size + off;
+  while (size > 0) {
+    lfs_size_t chunk = size < sizeof(flash_dma_buffer) ? size : sizeof(flash_dma_buffer);
+    memcpy(flash_dma_buffer, src, chunk);
+    if (snor_device_program(&snor1, addr, chunk, flash_dma_buffer) != FLASH_NO_ERROR) {
+      return LFS_ERR_IO;
+    }
+    src += chunk;
+    addr += chunk;
+    size -= chunk;
   }
-
-  return LFS_ERR_IO;
+  return LFS_ERR_OK;
 }
 
 static int erase_flash(const struct lfs_config *c, lfs_block_t block) {
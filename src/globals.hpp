@@ -21,6 +21,9 @@ enum Events : eventid_t {
 
   // InputService
   GPIO_TRIGGERED,
+
+  // ImuService
+  IMU_FIFO_WATERMARK,
 };
 
 constexpr int ids_to_mask(std::initializer_list<eventid_t> ids) {
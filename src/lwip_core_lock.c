@@ -0,0 +1,13 @@
+#include "lwip_core_lock.h"
+
+#include "ch.h"
+
+static MUTEX_DECL(lwip_core_mutex);
+
+void lwip_core_lock(void) {
+  chMtxLock(&lwip_core_mutex);
+}
+
+void lwip_core_unlock(void) {
+  chMtxUnlock(&lwip_core_mutex);
+}
@@ -18,8 +18,11 @@
 #include <xbot-service/Io.hpp>
 #include <xbot-service/RemoteLogging.hpp>
 #include <xbot-service/portable/system.hpp>
+#include <xbot/timebase.hpp>
 
 #include "debug/checksum_test_interface.hpp"
+#include "debug/parser_benchmark.hpp"
+#include "debug/system_monitor.hpp"
 #include "debug/thread_watermark.h"
 #include "globals.hpp"
 #include "heartbeat.h"
@@ -39,8 +42,11 @@ int main() {
   MODIFY_REG(SYSCFG->UR2, SYSCFG_UR2_BOOT_ADD0, (0x8000000 >> 16) << SYSCFG_UR2_BOOT_ADD0_Pos);
 #endif
 
-  // Need to disable D-Cache for the Ethernet MAC to work properly
+#ifdef DISABLE_DCACHE
+  // DMA buffers live in the MPU non-cacheable region, so the D-Cache can stay enabled.
+  // Disabling it is only supported for benchmark comparisons.
   SCB_DisableDCache();
+#endif
   /*
    * System initializations.
    * - HAL initialization, this also initializes the configured device drivers
@@ -50,6 +56,8 @@ int main() {
    */
   halInit();
   chSysInit();
+  // Before anything asks for timestamps
+  xbot::timebase::Init();
 #ifdef USE_SEGGER_RTT
   rttInit();
 #endif
@@ -92,6 +100,8 @@ int main() {
   xbot::service::startRemoteLogging();
   // Debug-only: periodically log per-thread stack watermark (no-op in release).
   InitThreadWatermark();
+  // Per-thread CPU load and schedule jitter, served to the host
+  xbot::debug::InitSystemMonitor();
 
   // Try opening the filesystem, on error fail
   if (!InitFS()) {
@@ -127,6 +137,8 @@ int main() {
   robot->InitPlatform();
   xbot::service::Io::start();
   StartServices();
+  // Debug-only: benchmark the protocol parsers once (no-op unless built with PARSER_BENCHMARK).
+  xbot::debug::InitParserBenchmark();
   SetStatusLedColor(GREEN);
   DispatchEvents();
 }
@@ -0,0 +1,41 @@
+//
+// Allocator for DMA buffers in the MPU non-cacheable SRAM1 region (.nocache).
+//
+
+#include "nocache.hpp"
+
+#include <ulog.h>
+
+#include <cstring>
+
+#include "ch.h"
+
+static constexpr size_t kAlignment = 32;
+
+CC_SECTION(".nocache") CC_ALIGN_DATA(kAlignment) static uint8_t arena_[NOCACHE_ARENA_SIZE];
+static size_t used_ = 0;
+
+namespace nocache {
+
+void* Alloc(size_t size) {
+  chSysLock();
+  size_t offset = used_;
+  size_t aligned_size = (size + kAlignment - 1) & ~(kAlignment - 1);
+  if (offset + aligned_size > sizeof(arena_)) {
+    chSysUnlock();
+    ULOG_ERROR("Out of non-cacheable memory (requested %u, used %u of %u)", size, offset, sizeof(arena_));
+    chSysHalt("nocache arena exhausted");
+  }
+  used_ += aligned_size;
+  chSysUnlock();
+
+  uint8_t* ptr = &arena_[offset];
+  memset(ptr, 0, aligned_size);
+  return ptr;
+}
+
+size_t Used() {
+  return used_;
+}
+
+}  // namespace nocache
@@ -0,0 +1,48 @@
+//
+// Allocator for DMA buffers in the MPU non-cacheable SRAM1 region (.nocache).
+//
+// The D-Cache is enabled for the rest of the RAM, so every buffer that a DMA
+// stream reads from or writes to must either live here or be maintained with
+// cacheBufferFlush()/cacheBufferInvalidate(). Drivers are usually members of
+// heap allocated objects, so they can't place their buffers via CC_SECTION;
+// they request them from this arena instead. Allocations are never freed.
+//
+
+#ifndef NOCACHE_HPP
+#define NOCACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "hal.h"
+
+// Size of the arena, the remainder of SRAM1 is left for the static .nocache section.
+#ifndef NOCACHE_ARENA_SIZE
+#define NOCACHE_ARENA_SIZE 12288
+#endif
+
+namespace nocache {
+
+// Returns a 32-byte (cache line) aligned, zeroed buffer. Halts if the arena is exhausted.
+void* Alloc(size_t size);
+
+template <typename T>
+T* Alloc(size_t count = 1) {
+  return static_cast<T*>(Alloc(sizeof(T) * count));
+}
+
+// Number of arena bytes handed out so far.
+size_t Used();
+
+// Writes back the cache lines covering a cacheable buffer, so that a DMA stream reading it
+// (e.g. UART / SPI TX) sees the current data. Unlike cacheBufferFlush() this also handles
+// buffers which don't start on a cache line boundary.
+inline void FlushForDma(const void* data, size_t size) {
+  uintptr_t start = reinterpret_cast<uintptr_t>(data) & ~static_cast<uintptr_t>(CACHE_LINE_SIZE - 1);
+  uintptr_t end = reinterpret_cast<uintptr_t>(data) + size;
+  cacheBufferFlush(start, end - start);
+}
+
+}  // namespace nocache
+
+#endif  // NOCACHE_HPP
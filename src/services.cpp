@@ -2,7 +2,11 @@
 
 #include <service_ids.h>
 
+#include <xbot/deadlines.hpp>
+#include <xbot/io_priority.hpp>
+
 #include "drivers/input/gpio_input_driver.hpp"
+#include "services/emergency_service/emergency_stop.hpp"
 #ifdef DEBUG_BUILD
 #include "drivers/input/simulated_input_driver.hpp"
 #endif
@@ -19,6 +23,26 @@ InputService input_service{xbot::service_ids::INPUT};
 HighLevelService high_level_service{xbot::service_ids::HIGH_LEVEL};
 
 void StartServices() {
+  // Emergency and twist commands overtake bulk traffic, RTCM and input configs may only hold a few pool packets
+  xbot::io_priority::SetPriority(xbot::service_ids::EMERGENCY, true);
+  xbot::io_priority::SetPriority(xbot::service_ids::DIFF_DRIVE, true);
+  xbot::io_priority::SetQuota(xbot::service_ids::GPS, 6);
+  xbot::io_priority::SetQuota(xbot::service_ids::INPUT, 4);
+
+  // Thread priorities and deadlines, see cfg/thread_priorities.h
+  using xbot::deadlines::Role;
+  emergency_service.SetThreadRole(Role::SAFETY);
+  input_service.SetThreadRole(Role::SAFETY);
+  diff_drive.SetThreadRole(Role::MOTOR_CONTROL);
+  mower_service.SetThreadRole(Role::MOTOR_CONTROL);
+  imu_service.SetThreadRole(Role::IMU);
+  gps_service.SetThreadRole(Role::GPS);
+  power_service.SetThreadRole(Role::POWER);
+  bms_service.SetThreadRole(Role::POWER);
+  high_level_service.SetThreadRole(Role::POWER);
+  // Most services run above this thread now, don't let them preempt it before all of them were started
+  const tprio_t main_priority = chThdSetPriority(HIGHPRIO - 1);
+
 #define START_IF_NEEDED(service, id)                \
   if (robot->NeedsService(xbot::service_ids::id)) { \
     service.start();                                \
@@ -51,6 +75,8 @@ void StartServices() {
     emergency_service.RequireService(&power_service);
   }
 
+  // Motors were registered by the robot, stop them on emergency inputs before any service runs
+  xbot::emergency_stop::Start();
   START_IF_NEEDED(emergency_service, EMERGENCY)
   START_IF_NEEDED(imu_service, IMU)
   START_IF_NEEDED(power_service, POWER)
@@ -59,4 +85,5 @@ void StartServices() {
   START_IF_NEEDED(gps_service, GPS)
   START_IF_NEEDED(input_service, INPUT)
   START_IF_NEEDED(high_level_service, HIGH_LEVEL)
+  chThdSetPriority(main_priority);
 }
@@ -8,26 +8,45 @@
 #include "bms_service.hpp"
 
 #include <cstring>
+#include <xbot-service/portable/system.hpp>
 
 void BmsService::SetDriver(BmsDriver* bms_driver) {
   bms_ = bms_driver;
 }
 
+bool BmsService::OnStart() {
+  // The host may have lost the values, send all of them again
+  keyframe_timer_.Force();
+  return true;
+}
+
 void BmsService::service_tick_() {
   if (bms_data_ == nullptr) return;
 
+  OutputFrame frame{keyframe_timer_.Due(xbot::service::system::getTimeMicros())};
+  const bool send_voltage = frame.Update(voltage_output_, bms_data_->pack_voltage_v);
+  const bool send_current = frame.Update(current_output_, bms_data_->pack_current_a);
+  const bool send_soc = frame.Update(soc_output_, bms_data_->battery_soc);
+  const bool send_remaining = frame.Update(remaining_capacity_output_, bms_data_->remaining_capacity_ah);
+  const bool send_full = frame.Update(full_charge_capacity_output_, bms_data_->full_charge_capacity_ah);
+  const bool send_cycles = frame.Update(cycle_count_output_, bms_data_->cycle_count);
+  const bool send_temperature = frame.Update(temperature_output_, bms_data_->temperature_c);
+  const bool send_status = frame.Update(battery_status_output_, bms_data_->battery_status);
+  size_t extra_data_length = 0;
+  const bool send_extra_data =
+      bms_extra_data_ != nullptr && frame.Update(extra_data_output_, bms_extra_data_, &extra_data_length);
+  if (!frame.Any()) return;
+
   StartTransaction();
-  SendVoltage(bms_data_->pack_voltage_v);
-  SendCurrent(bms_data_->pack_current_a);
-  SendRelativeStateOfCharge(bms_data_->battery_soc);
-  SendRemainingCapacity(bms_data_->remaining_capacity_ah);
-  SendFullChargeCapacity(bms_data_->full_charge_capacity_ah);
-  SendCycleCount(bms_data_->cycle_count);
-  SendTemperature(bms_data_->temperature_c);
-  SendBatteryStatus(bms_data_->battery_status);
-  if (bms_extra_data_ != nullptr) {
-    SendExtraData(bms_extra_data_, (uint32_t)strlen(bms_extra_data_));
-  }
+  if (send_voltage) SendVoltage(bms_data_->pack_voltage_v);
+  if (send_current) SendCurrent(bms_data_->pack_current_a);
+  if (send_soc) SendRelativeStateOfCharge(bms_data_->battery_soc);
+  if (send_remaining) SendRemainingCapacity(bms_data_->remaining_capacity_ah);
+  if (send_full) SendFullChargeCapacity(bms_data_->full_charge_capacity_ah);
+  if (send_cycles) SendCycleCount(bms_data_->cycle_count);
+  if (send_temperature) SendTemperature(bms_data_->temperature_c);
+  if (send_status) SendBatteryStatus(bms_data_->battery_status);
+  if (send_extra_data) SendExtraData(bms_extra_data_, (uint32_t)extra_data_length);
   CommitTransaction();
 }
 
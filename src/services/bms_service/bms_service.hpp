@@ -12,6 +12,7 @@
 
 #include <BmsServiceBase.hpp>
 #include <drivers/bms/bms_driver.hpp>
+#include <services/output_cache.hpp>
 
 using namespace xbot::service;
 using namespace xbot::driver::bms;
@@ -23,18 +24,33 @@ class BmsService : public BmsServiceBase {
 
   void SetDriver(BmsDriver* bms_driver);
 
+ protected:
+  bool OnStart() override;
+
  private:
   void service_tick_();
   void driver_tick_();
 
-  ServiceSchedule tick_schedule_{*this, 1'000'000,
-                                 XBOT_FUNCTION_FOR_METHOD(BmsService, &BmsService::service_tick_, this)};
+  MonitoredSchedule tick_schedule_{*this, 1'000'000,
+                                   XBOT_FUNCTION_FOR_METHOD(BmsService, &BmsService::service_tick_, this)};
   Schedule driver_schedule_{scheduler_, true, 1'000'000,
                             XBOT_FUNCTION_FOR_METHOD(BmsService, &BmsService::driver_tick_, this)};
 
   BmsDriver* bms_ = nullptr;
   const Data* bms_data_ = nullptr;
   const char* bms_extra_data_ = nullptr;
+
+  // Values are only sent when they changed, with a keyframe every 10 s (see services/output_cache.hpp)
+  KeyframeTimer keyframe_timer_{10'000'000};
+  CachedOutput<float> voltage_output_{0.02f};
+  CachedOutput<float> current_output_{0.01f};
+  CachedOutput<float> soc_output_{0.002f};
+  CachedOutput<float> remaining_capacity_output_{0.01f};
+  CachedOutput<float> full_charge_capacity_output_{0.01f};
+  CachedOutput<uint16_t> cycle_count_output_{};
+  CachedOutput<float> temperature_output_{0.5f};
+  CachedOutput<uint16_t> battery_status_output_{};
+  CachedStringOutput extra_data_output_{};
   THD_WORKING_AREA(wa, 2048){};
 };
 
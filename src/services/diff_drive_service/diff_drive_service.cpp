@@ -4,11 +4,16 @@
 
 #include "diff_drive_service.hpp"
 
+#include <etl/algorithm.h>
 #include <ulog.h>
 
 #include <drivers/motor/motor_driver.hpp>
 #include <services.hpp>
+#include <services/emergency_service/emergency_stop.hpp>
 #include <xbot-service/portable/system.hpp>
+#include <xbot/sample_stamps.hpp>
+#include <xbot/timebase.hpp>
+#include <xbot/trace.hpp>
 
 using namespace xbot::driver::motor;
 
@@ -19,15 +24,48 @@ void DiffDriveService::OnEmergencyChangedEvent() {
     return;
   }
   chMtxLock(&state_mutex_);
-  speed_l_ = 0;
-  speed_r_ = 0;
+  left_.target_speed = right_.target_speed = 0;
+  left_.duty = right_.duty = 0;
+  ResetSpeedControl();
   // Instantly send the 0 duty cycle
   SetDuty();
   chMtxUnlock(&state_mutex_);
 }
 void DiffDriveService::SetDrivers(MotorDriver* left_driver, MotorDriver* right_driver) {
-  left_esc_driver_ = left_driver;
-  right_esc_driver_ = right_driver;
+  left_.driver = left_driver;
+  right_.driver = right_driver;
+  xbot::emergency_stop::AddMotor(left_driver);
+  xbot::emergency_stop::AddMotor(right_driver);
+}
+
+void DiffDriveService::SetSpeedControllerGains(const WheelSpeedController::Gains& gains) {
+  chMtxLock(&state_mutex_);
+  left_.controller.SetGains(gains);
+  right_.controller.SetGains(gains);
+  chMtxUnlock(&state_mutex_);
+}
+
+void DiffDriveService::ResetSpeedControl() {
+  left_.controller.Reset();
+  right_.controller.Reset();
+}
+
+void DiffDriveService::ResetWheel(Wheel& wheel) {
+  wheel.target_speed = 0;
+  wheel.duty = 0;
+  wheel.controller.Reset();
+  wheel.requests_in_flight = 0;
+  ForgetFeedback(wheel);
+}
+
+void DiffDriveService::ForgetFeedback(Wheel& wheel) {
+  wheel.state_valid = false;
+  wheel.last_tacho_valid = false;
+  wheel.measured = false;
+  // Send all values again once it's back
+  wheel.status_output.Invalidate();
+  wheel.temperature_output.Invalidate();
+  wheel.current_output.Invalidate();
 }
 
 bool DiffDriveService::OnStart() {
@@ -42,30 +80,48 @@ bool DiffDriveService::OnStart() {
     return false;
   }
 
-  speed_l_ = speed_r_ = 0;
-  last_ticks_valid = false;
+  const uint32_t status_rate_hz =
+      etl::clamp(robot->DiffDrive_GetStatusRateHz(), MIN_STATUS_RATE_HZ, MAX_STATUS_RATE_HZ);
+  status_interval_micros_ = 1'000'000 / status_rate_hz;
+  next_status_request_micros_ = xbot::service::system::getTimeMicros();
+
+  WheelSpeedController::Gains gains = robot->DiffDrive_GetSpeedControllerGains();
+  if (!(gains.kff >= 0 && gains.kp >= 0 && gains.ki >= 0 && gains.kd >= 0 && gains.integral_limit >= 0)) {
+    ULOG_ARG_WARNING(&service_id_, "Invalid speed controller gains, using the defaults");
+    gains = WheelSpeedController::DEFAULT_GAINS;
+  }
+  SetSpeedControllerGains(gains);
+
+  chMtxLock(&state_mutex_);
+  ResetWheel(left_);
+  ResetWheel(right_);
+  keyframe_timer_.Force();
+  odometry_sent_moving_ = true;
+  chMtxUnlock(&state_mutex_);
   return true;
 }
 
 void DiffDriveService::OnCreate() {
-  chDbgAssert(left_esc_driver_ != nullptr, "Left Motor Driver cannot be null!");
-  chDbgAssert(right_esc_driver_ != nullptr, "Right Motor Driver cannot be null!");
+  chDbgAssert(left_.driver != nullptr, "Left Motor Driver cannot be null!");
+  chDbgAssert(right_.driver != nullptr, "Right Motor Driver cannot be null!");
 
   // Register callbacks
-  left_esc_driver_->SetStateCallback(
+  left_.driver->SetStateCallback(
       etl::delegate<void(const MotorDriver::ESCState&)>::create<DiffDriveService, &DiffDriveService::LeftESCCallback>(
           *this));
-  right_esc_driver_->SetStateCallback(
+  right_.driver->SetStateCallback(
       etl::delegate<void(const MotorDriver::ESCState&)>::create<DiffDriveService, &DiffDriveService::RightESCCallback>(
           *this));
 
-  left_esc_driver_->Start();
-  right_esc_driver_->Start();
+  left_.driver->Start();
+  right_.driver->Start();
 }
 
 void DiffDriveService::OnStop() {
-  speed_l_ = speed_r_ = 0;
-  last_ticks_valid = false;
+  chMtxLock(&state_mutex_);
+  ResetWheel(left_);
+  ResetWheel(right_);
+  chMtxUnlock(&state_mutex_);
   escs_connected_ = 0;
 }
 
@@ -73,133 +129,235 @@ void DiffDriveService::tick() {
   chMtxLock(&state_mutex_);
 
   // Check, if we recently received duty. If not, set to zero for safety
-  if (xbot::service::system::getTimeMicros() - last_duty_received_micros_ > 1'000'000) {
+  const uint32_t now = xbot::service::system::getTimeMicros();
+  if (now - last_duty_received_micros_ > 1'000'000) {
     // it's ok to set it here, because we know that duty_set_ is false (we're in a timeout after all)
-    speed_l_ = speed_r_ = 0;
+    left_.target_speed = right_.target_speed = 0;
+    left_.duty = right_.duty = 0;
+    ResetSpeedControl();
   }
 
-  if (!duty_sent_) {
-    SetDuty();
+  for (Wheel* wheel : {&left_, &right_}) {
+    if (!IsFeedbackFresh(*wheel, now)) {
+      // No wheel ticks to close the loop with, drive open-loop until the ESC reports again
+      wheel->controller.Reset();
+      wheel->duty = wheel->controller.FeedForward(wheel->target_speed);
+    }
+    if (!wheel->duty_sent) {
+      SetWheelDuty(*wheel);
+    }
+    wheel->duty_sent = false;
   }
 
-  left_esc_driver_->RequestStatus();
-  right_esc_driver_->RequestStatus();
-
   // Check, if we have received ESC status updates recently. If not, send a disconnected message
-  if (xbot::service::system::getTimeMicros() - last_valid_esc_state_micros_ > 1'000'000) {
+  const bool left_connected = left_.state_valid && now - left_.last_state_micros <= ESC_TIMEOUT_MICROS;
+  const bool right_connected = right_.state_valid && now - right_.last_state_micros <= ESC_TIMEOUT_MICROS;
+  if (!left_connected || !right_connected) {
+    const auto disconnected = static_cast<uint8_t>(MotorDriver::ESCState::ESCStatus::ESC_STATUS_DISCONNECTED);
     StartTransaction();
-    if (!left_esc_state_valid_) {
-      SendLeftESCStatus(static_cast<uint8_t>(MotorDriver::ESCState::ESCStatus::ESC_STATUS_DISCONNECTED));
+    if (!left_connected) {
+      SendLeftESCStatus(disconnected);
+      ForgetFeedback(left_);
     }
-    if (!right_esc_state_valid_) {
-      SendRightESCStatus(static_cast<uint8_t>(MotorDriver::ESCState::ESCStatus::ESC_STATUS_DISCONNECTED));
+    if (!right_connected) {
+      SendRightESCStatus(disconnected);
+      ForgetFeedback(right_);
     }
     CommitTransaction();
   }
 
-  duty_sent_ = false;
   chMtxUnlock(&state_mutex_);
 }
 
+bool DiffDriveService::ReserveRequest(Wheel& wheel, uint32_t now_micros) {
+  if (wheel.requests_in_flight >= MAX_REQUESTS_IN_FLIGHT) {
+    if (now_micros - wheel.last_request_micros < MAX_FEEDBACK_AGE_MICROS) {
+      return false;
+    }
+    // No answer for a while, consider the requests lost
+    wheel.requests_in_flight = 0;
+  }
+  wheel.requests_in_flight++;
+  wheel.last_request_micros = now_micros;
+  return true;
+}
+
+void DiffDriveService::requestStatus() {
+  // Runs at the maximum rate, the requests are due at the configured one
+  const uint32_t now = xbot::service::system::getTimeMicros();
+  if (static_cast<int32_t>(now - next_status_request_micros_) < 0) {
+    return;
+  }
+  next_status_request_micros_ += status_interval_micros_;
+  if (static_cast<int32_t>(now - next_status_request_micros_) >= 0) {
+    // More than one interval late, don't catch up with a burst of requests
+    next_status_request_micros_ = now + status_interval_micros_;
+  }
+
+  chMtxLock(&state_mutex_);
+  const bool request_left = ReserveRequest(left_, now);
+  const bool request_right = ReserveRequest(right_, now);
+  chMtxUnlock(&state_mutex_);
+
+  // Pipelined, the next request doesn't wait for the answer to this one.
+  // Each answer triggers ProcessWheelUpdate() for its wheel, some drivers answer right away (with the mutex free).
+  if (request_left) {
+    left_.driver->RequestStatus();
+  }
+  if (request_right) {
+    right_.driver->RequestStatus();
+  }
+}
+
 void DiffDriveService::SetDuty() {
-  // Get the current emergency state
-  bool emergency = emergency_service.GetEmergencyReasons() != 0;
+  SetWheelDuty(left_);
+  SetWheelDuty(right_);
+}
+
+void DiffDriveService::SetWheelDuty(Wheel& wheel) {
+  // Get the current emergency state, including one the fast path stopped the motors for
+  bool emergency = emergency_service.GetEmergencyReasons() != 0 || xbot::emergency_stop::IsPending();
   if (emergency) {
-    left_esc_driver_->SetDuty(0);
-    right_esc_driver_->SetDuty(0);
+    wheel.driver->SetDuty(0);
   } else {
-    left_esc_driver_->SetDuty(speed_l_);
-    right_esc_driver_->SetDuty(speed_r_);
+    wheel.driver->SetDuty(wheel.duty);
+    if (twist_received_ticks_ != 0) {
+      xbot::trace::Record(xbot::trace::Span::TWIST_TO_DUTY, twist_received_ticks_, xbot::timebase::NowTicks());
+    }
   }
-  duty_sent_ = true;
+  twist_received_ticks_ = 0;
+  wheel.duty_sent = true;
 }
 
 void DiffDriveService::LeftESCCallback(const MotorDriver::ESCState& state) {
   chMtxLock(&state_mutex_);
-  left_esc_state_ = state;
-  left_esc_state_valid_ = true;
   escs_connected_ |= ESC_LEFT;
-  if (right_esc_state_valid_) {
-    ProcessStatusUpdate();
-  }
+  ProcessWheelUpdate(left_, state);
   chMtxUnlock(&state_mutex_);
 }
 
 void DiffDriveService::RightESCCallback(const MotorDriver::ESCState& state) {
   chMtxLock(&state_mutex_);
-  right_esc_state_ = state;
-  right_esc_state_valid_ = true;
   escs_connected_ |= ESC_RIGHT;
-  if (left_esc_state_valid_) {
-    ProcessStatusUpdate();
-  }
+  ProcessWheelUpdate(right_, state);
   chMtxUnlock(&state_mutex_);
 }
 
-void DiffDriveService::ProcessStatusUpdate() {
-  uint32_t micros = xbot::service::system::getTimeMicros();
-  last_valid_esc_state_micros_ = micros;
+void DiffDriveService::ProcessWheelUpdate(Wheel& wheel, const MotorDriver::ESCState& state) {
+  wheel.state = state;
+  wheel.state_valid = true;
+  wheel.last_state_micros = xbot::service::system::getTimeMicros();
+  // One reply per request, unsolicited frames (e.g. after a reconnect) must not go below zero
+  if (wheel.requests_in_flight > 0) {
+    wheel.requests_in_flight--;
+  }
+
+  // Measure the wheel speed between the capture times of the ESC frames, not the times they were processed
+  const uint64_t capture_ticks = state.capture_ticks != 0 ? state.capture_ticks : xbot::timebase::NowTicks();
+  if (wheel.last_tacho_valid) {
+    if (capture_ticks == wheel.last_capture_ticks) {
+      // Not a new status frame (e.g. the answer to a firmware version request)
+      return;
+    }
+    const uint64_t dt_micros = xbot::timebase::TicksToMicros(capture_ticks - wheel.last_capture_ticks);
+    const float dt = static_cast<float>(dt_micros) / 1'000'000.0f;
+    const auto d_ticks = static_cast<int32_t>(state.tacho - wheel.last_tacho);
+    wheel.measured_speed = static_cast<float>(d_ticks) / (dt * static_cast<float>(WheelTicksPerMeter.value));
+    wheel.measured = true;
+
+    // Close the speed loop on the measured wheel speed (in its ESC's own direction)
+    if (dt_micros <= MAX_FEEDBACK_AGE_MICROS) {
+      wheel.duty = wheel.controller.Update(wheel.target_speed, wheel.measured_speed, dt);
+    } else {
+      wheel.controller.Reset();
+      wheel.duty = wheel.controller.FeedForward(wheel.target_speed);
+    }
+    SetWheelDuty(wheel);
+  }
+  wheel.last_tacho_valid = true;
+  wheel.last_tacho = state.tacho;
+  wheel.last_capture_ticks = capture_ticks;
+
+  // Odometry once both wheels have a new speed, each measured over its own interval
+  if (left_.measured && right_.measured) {
+    SendOdometry();
+  }
+}
+
+void DiffDriveService::SendOdometry() {
+  OutputFrame frame{keyframe_timer_.Due(xbot::service::system::getTimeMicros())};
+  const auto left_status = static_cast<uint8_t>(left_.state.status);
+  const auto right_status = static_cast<uint8_t>(right_.state.status);
+  const bool send_left_status = frame.Update(left_.status_output, left_status);
+  const bool send_left_temperature = frame.Update(left_.temperature_output, left_.state.temperature_pcb);
+  const bool send_left_current = frame.Update(left_.current_output, left_.state.current_input);
+  const bool send_right_status = frame.Update(right_.status_output, right_status);
+  const bool send_right_temperature = frame.Update(right_.temperature_output, right_.state.temperature_pcb);
+  const bool send_right_current = frame.Update(right_.current_output, right_.state.current_input);
+
+  const bool moving = left_.measured_speed != 0 || right_.measured_speed != 0;
+  const bool odometry_changed = moving || odometry_sent_moving_ || left_.state.tacho != odometry_sent_ticks_[0] ||
+                                right_.state.tacho != odometry_sent_ticks_[1];
+  const bool send_odometry = OutputDue(odometry_gate_, odometry_changed);
+  left_.measured = right_.measured = false;
+  if (!frame.Any() && !send_odometry) {
+    return;
+  }
+
   StartTransaction();
-  SendLeftESCTemperature(left_esc_state_.temperature_pcb);
-  SendLeftESCCurrent(left_esc_state_.current_input);
-  SendLeftESCStatus(static_cast<uint8_t>(left_esc_state_.status));
-
-  SendRightESCTemperature(right_esc_state_.temperature_pcb);
-  SendRightESCCurrent(right_esc_state_.current_input);
-  SendRightESCStatus(static_cast<uint8_t>(right_esc_state_.status));
-
-  // Calculate the twist according to wheel ticks
-  if (last_ticks_valid) {
-    float dt = static_cast<float>(micros - last_ticks_micros_) / 1'000'000.0f;
-    int32_t d_left = static_cast<int32_t>(left_esc_state_.tacho - last_ticks_left);
-    int32_t d_right = static_cast<int32_t>(right_esc_state_.tacho - last_ticks_right);
-    float vx = static_cast<float>(d_left - d_right) / (2.0f * dt * static_cast<float>(WheelTicksPerMeter.value));
-    float vr = -static_cast<float>(d_left + d_right) / (2.0f * dt * static_cast<float>(WheelTicksPerMeter.value));
+  if (send_left_temperature) SendLeftESCTemperature(left_.state.temperature_pcb);
+  if (send_left_current) SendLeftESCCurrent(left_.state.current_input);
+  if (send_left_status) SendLeftESCStatus(left_status);
+  if (send_right_temperature) SendRightESCTemperature(right_.state.temperature_pcb);
+  if (send_right_current) SendRightESCCurrent(right_.state.current_input);
+  if (send_right_status) SendRightESCStatus(right_status);
+
+  if (send_odometry) {
+    // Calculate the twist according to the wheel speeds
+    float vx = (left_.measured_speed - right_.measured_speed) / 2.0f;
+    float vr = -(left_.measured_speed + right_.measured_speed) / 2.0f;
     double data[6]{};
     data[0] = vx;
     data[5] = vr;
     SendActualTwist(data, 6);
-    uint32_t ticks[2];
-    ticks[0] = left_esc_state_.tacho;
-    ticks[1] = right_esc_state_.tacho;
-    SendWheelTicks(ticks, 2);
+    // From the older of the two frames
+    xbot::trace::Record(xbot::trace::Span::ESC_STATUS_TO_TWIST,
+                        etl::min(left_.last_capture_ticks, right_.last_capture_ticks), xbot::timebase::NowTicks());
+    odometry_sent_ticks_[0] = left_.state.tacho;
+    odometry_sent_ticks_[1] = right_.state.tacho;
+    odometry_sent_moving_ = moving;
+    SendWheelTicks(odometry_sent_ticks_, 2);
   }
-  last_ticks_valid = true;
-  last_ticks_left = left_esc_state_.tacho;
-  last_ticks_right = right_esc_state_.tacho;
-  last_ticks_micros_ = micros;
-
-  right_esc_state_valid_ = left_esc_state_valid_ = false;
-
   CommitTransaction();
+
+  if (send_odometry) {
+    // The ESC frames the wheel speeds were measured with
+    xbot::sample_stamps::Send(service_id_, xbot::sample_stamps::Source::LEFT_ESC, left_.last_capture_ticks);
+    xbot::sample_stamps::Send(service_id_, xbot::sample_stamps::Source::RIGHT_ESC, right_.last_capture_ticks);
+  }
 }
 
 void DiffDriveService::OnControlTwistChanged(const double* new_value, uint32_t length) {
   if (length != 6) return;
   chMtxLock(&state_mutex_);
   last_duty_received_micros_ = xbot::service::system::getTimeMicros();
+  twist_received_ticks_ = xbot::timebase::NowTicks();
   // we can only do forward and rotation around one axis
   const auto linear = static_cast<float>(new_value[0]);
   const auto angular = static_cast<float>(new_value[5]);
 
-  // TODO: update this to rad/s values and implement xESC speed control
-  speed_r_ = -(linear + 0.5f * static_cast<float>(WheelDistance.value) * angular);
-  speed_l_ = linear - 0.5f * static_cast<float>(WheelDistance.value) * angular;
+  right_.target_speed = -(linear + 0.5f * static_cast<float>(WheelDistance.value) * angular);
+  left_.target_speed = linear - 0.5f * static_cast<float>(WheelDistance.value) * angular;
 
-  if (speed_l_ >= 1.0) {
-    speed_l_ = 1.0;
-  } else if (speed_l_ <= -1.0) {
-    speed_l_ = -1.0;
-  }
-  if (speed_r_ >= 1.0) {
-    speed_r_ = 1.0;
-  } else if (speed_r_ <= -1.0) {
-    speed_r_ = -1.0;
-  }
-
-  // Limit comms frequency to once per tick()
-  if (!duty_sent_) {
-    SetDuty();
+  // With fresh wheel ticks the control loop picks up the new target on the wheel's next status update,
+  // otherwise drive open-loop. Limit comms frequency to once per tick() in that case.
+  for (Wheel* wheel : {&left_, &right_}) {
+    if (!IsFeedbackFresh(*wheel, last_duty_received_micros_)) {
+      wheel->duty = wheel->controller.FeedForward(wheel->target_speed);
+      if (!wheel->duty_sent) {
+        SetWheelDuty(*wheel);
+      }
+    }
   }
   chMtxUnlock(&state_mutex_);
 }
@@ -11,35 +11,80 @@
 #include <DiffDriveServiceBase.hpp>
 #include <drivers/motor/motor_driver.hpp>
 #include <globals.hpp>
+#include <services/output_cache.hpp>
 #include <xbot-service/portable/socket.hpp>
 
+#include "wheel_speed_controller.hpp"
+
 using namespace xbot::service;
 using namespace xbot::driver::motor;
 
 class DiffDriveService : public DiffDriveServiceBase {
  private:
   THD_WORKING_AREA(wa, 1024){};
-  MotorDriver *left_esc_driver_ = nullptr;
-  MotorDriver *right_esc_driver_ = nullptr;
-
-  MotorDriver::ESCState left_esc_state_{};
-  MotorDriver::ESCState right_esc_state_{};
-  bool left_esc_state_valid_ = false;
-  bool right_esc_state_valid_ = false;
-  uint32_t last_valid_esc_state_micros_ = 0;
+
+  // Each wheel is controlled on its own ESC's status frames, independent of the other wheel
+  struct Wheel {
+    MotorDriver *driver = nullptr;
+    WheelSpeedController controller{};
+    // Target speed in m/s and the duty cycle sent to the ESC, in the ESC's own direction
+    float target_speed = 0;
+    float duty = 0;
+
+    MotorDriver::ESCState state{};
+    // Received a status frame, cleared when the ESC disconnects
+    bool state_valid = false;
+    uint32_t last_state_micros = 0;
+    // Status requests not answered yet, capped at MAX_REQUESTS_IN_FLIGHT
+    uint8_t requests_in_flight = 0;
+    uint32_t last_request_micros = 0;
+    // Sent a duty cycle since the last tick()
+    bool duty_sent = false;
+
+    // Previous measurement, the speed is the tacho delta over the time between the two frames
+    bool last_tacho_valid = false;
+    uint32_t last_tacho = 0;
+    uint64_t last_capture_ticks = 0;
+    float measured_speed = 0;
+    // Measured since the last odometry output
+    bool measured = false;
+
+    // Values are only sent when they changed, with a keyframe every 5 s (see services/output_cache.hpp)
+    CachedOutput<uint8_t> status_output{};
+    CachedOutput<float> temperature_output{0.5f};
+    CachedOutput<float> current_output{0.05f};
+  };
+
+  Wheel left_{};
+  Wheel right_{};
   static constexpr uint8_t ESC_LEFT = 1 << 0;
   static constexpr uint8_t ESC_RIGHT = 1 << 1;
   etl::atomic<uint8_t> escs_connected_{0};
   uint32_t last_duty_received_micros_ = 0;
 
-  uint32_t last_ticks_left = 0;
-  uint32_t last_ticks_right = 0;
-  bool last_ticks_valid = false;
-  uint32_t last_ticks_micros_ = 0;
-
-  float speed_l_ = 0;
-  float speed_r_ = 0;
-  bool duty_sent_ = false;
+  // Status requests run at the robot's rate (Robot::DiffDrive_GetStatusRateHz()) within these limits.
+  // The schedule runs at the maximum rate and issues the requests when they are due.
+  static constexpr uint32_t MIN_STATUS_RATE_HZ = 100;
+  static constexpr uint32_t MAX_STATUS_RATE_HZ = 200;
+  static constexpr uint32_t STATUS_SCHEDULE_MICROS = 1'000'000 / MAX_STATUS_RATE_HZ;
+  uint32_t status_interval_micros_ = 1'000'000 / MIN_STATUS_RATE_HZ;
+  uint32_t next_status_request_micros_ = 0;
+  // Requests are sent without waiting for the previous answer, but an ESC that doesn't answer isn't flooded
+  static constexpr uint8_t MAX_REQUESTS_IN_FLIGHT = 2;
+  // Without an ESC update for this long, the wheel is driven open-loop (feed-forward only)
+  static constexpr uint32_t MAX_FEEDBACK_AGE_MICROS = 50'000;
+  // Without an ESC update for this long, the ESC is reported as disconnected
+  static constexpr uint32_t ESC_TIMEOUT_MICROS = 1'000'000;
+
+  // ControlTwist not yet turned into a duty cycle (xbot::timebase ticks, 0 if none), traced in SetWheelDuty()
+  uint64_t twist_received_ticks_ = 0;
+
+  KeyframeTimer keyframe_timer_{5'000'000};
+  // ActualTwist and WheelTicks, sent together, follow the service wide subscription.
+  // On change: the ticks moved, or the last sent twist wasn't zero yet.
+  xbot::output_subscriptions::OutputGate odometry_gate_{service_id_, xbot::output_subscriptions::ALL_OUTPUTS};
+  uint32_t odometry_sent_ticks_[2]{};
+  bool odometry_sent_moving_ = true;
 
  public:
   explicit DiffDriveService(uint16_t service_id) : DiffDriveServiceBase(service_id, wa, sizeof(wa)) {
@@ -49,6 +94,9 @@ class DiffDriveService : public DiffDriveServiceBase {
 
   void SetDrivers(MotorDriver *left_driver, MotorDriver *right_driver);
 
+  // Applies new gains to both wheel speed controllers (this resets their state)
+  void SetSpeedControllerGains(const WheelSpeedController::Gains &gains);
+
   bool IsHealthy() override {
     return IsRunning() && (escs_connected_.load() == (ESC_LEFT | ESC_RIGHT));
   }
@@ -60,14 +108,28 @@ class DiffDriveService : public DiffDriveServiceBase {
 
  private:
   void tick();
-  ServiceSchedule tick_schedule_{*this, 40'000,
-                                 XBOT_FUNCTION_FOR_METHOD(DiffDriveService, &DiffDriveService::tick, this)};
+  MonitoredSchedule tick_schedule_{*this, 40'000,
+                                   XBOT_FUNCTION_FOR_METHOD(DiffDriveService, &DiffDriveService::tick, this)};
+
+  void requestStatus();
+  bool ReserveRequest(Wheel &wheel, uint32_t now_micros);
+  MonitoredSchedule status_schedule_{
+      *this, STATUS_SCHEDULE_MICROS,
+      XBOT_FUNCTION_FOR_METHOD(DiffDriveService, &DiffDriveService::requestStatus, this)};
 
   void SetDuty();
+  void SetWheelDuty(Wheel &wheel);
+  void ResetSpeedControl();
+  void ResetWheel(Wheel &wheel);
+  void ForgetFeedback(Wheel &wheel);
+  static bool IsFeedbackFresh(const Wheel &wheel, uint32_t now_micros) {
+    return wheel.last_tacho_valid && now_micros - wheel.last_state_micros <= MAX_FEEDBACK_AGE_MICROS;
+  }
 
   void LeftESCCallback(const MotorDriver::ESCState &state);
   void RightESCCallback(const MotorDriver::ESCState &state);
-  void ProcessStatusUpdate();
+  void ProcessWheelUpdate(Wheel &wheel, const MotorDriver::ESCState &state);
+  void SendOdometry();
 
  protected:
   void OnControlTwistChanged(const double *new_value, uint32_t length) override;
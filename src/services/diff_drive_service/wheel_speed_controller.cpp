@@ -0,0 +1,44 @@
+//
+// Per-wheel velocity controller, see wheel_speed_controller.hpp.
+//
+
+#include "wheel_speed_controller.hpp"
+
+void WheelSpeedController::Reset() {
+  integral_ = 0;
+  last_measured_valid_ = false;
+}
+
+float WheelSpeedController::FeedForward(float target) const {
+  return Clamp(gains_.kff * target, MAX_DUTY);
+}
+
+float WheelSpeedController::Update(float target, float measured, float dt) {
+  if (target == 0) {
+    Reset();
+    return 0;
+  }
+  if (dt <= 0) {
+    return FeedForward(target);
+  }
+
+  const float error = target - measured;
+  float derivative = 0;
+  if (last_measured_valid_) {
+    derivative = (measured - last_measured_) / dt;
+  }
+  last_measured_ = measured;
+  last_measured_valid_ = true;
+
+  const float unsaturated = gains_.kff * target + gains_.kp * error + integral_ - gains_.kd * derivative;
+  const float output = Clamp(unsaturated, MAX_DUTY);
+
+  // Only integrate if that doesn't push the output further into saturation
+  const bool saturated_high = unsaturated > MAX_DUTY && error > 0;
+  const bool saturated_low = unsaturated < -MAX_DUTY && error < 0;
+  if (!saturated_high && !saturated_low) {
+    integral_ = Clamp(integral_ + gains_.ki * error * dt, gains_.integral_limit);
+  }
+
+  return output;
+}
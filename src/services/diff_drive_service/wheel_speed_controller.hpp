@@ -0,0 +1,68 @@
+//
+// Per-wheel velocity controller: maps a target wheel speed (m/s) to a duty cycle.
+//
+// duty = kff * target + kp * error + ki * integral(error) - kd * d(measured)/dt
+//
+// The derivative acts on the measurement, so setpoint steps don't kick the output.
+// Anti-windup: the integrator is clamped to +-integral_limit (in duty units) and
+// frozen while the output saturates in the direction of the error.
+//
+
+#ifndef WHEEL_SPEED_CONTROLLER_HPP
+#define WHEEL_SPEED_CONTROLLER_HPP
+
+class WheelSpeedController {
+ public:
+  struct Gains {
+    // Feed-forward, duty per m/s. With kp = ki = kd = 0 this is the plain open-loop mapping.
+    float kff;
+    float kp;
+    float ki;
+    float kd;
+    // Max. contribution of the integral term to the duty cycle
+    float integral_limit;
+  };
+
+  // Conservative PI around the open-loop mapping, stable for wheels doing 0.6 - 2 m/s at full duty (ESC lag up to
+  // 50 ms at 100 Hz). Robots far outside that override Robot::DiffDrive_GetSpeedControllerGains().
+  static constexpr Gains DEFAULT_GAINS{1.0f, 0.3f, 1.0f, 0.0f, 0.3f};
+  static constexpr float MAX_DUTY = 1.0f;
+
+  void SetGains(const Gains& gains) {
+    gains_ = gains;
+    Reset();
+  }
+
+  const Gains& GetGains() const {
+    return gains_;
+  }
+
+  // Clears the integrator and derivative history, e.g. after an emergency or when the feedback was stale
+  void Reset();
+
+  // Open-loop output, used while there is no feedback
+  float FeedForward(float target) const;
+
+  /**
+   * Runs one control step. A target of 0 stops the wheel (duty 0) and resets the controller,
+   * so a standing robot doesn't hum on the residual integral.
+   * @param target Desired wheel speed in m/s
+   * @param measured Wheel speed in m/s, derived from the tacho delta
+   * @param dt Seconds since the last measurement
+   * @return Duty cycle in [-MAX_DUTY, MAX_DUTY]
+   */
+  float Update(float target, float measured, float dt);
+
+ private:
+  static float Clamp(float value, float limit) {
+    return value > limit ? limit : (value < -limit ? -limit : value);
+  }
+
+  Gains gains_ = DEFAULT_GAINS;
+  // Integral term, already multiplied by ki
+  float integral_ = 0;
+  float last_measured_ = 0;
+  bool last_measured_valid_ = false;
+};
+
+#endif  // WHEEL_SPEED_CONTROLLER_HPP
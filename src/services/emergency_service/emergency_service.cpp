@@ -5,7 +5,9 @@
 #include "emergency_service.hpp"
 
 #include <xbot-service/Lock.hpp>
+#include <xbot/trace.hpp>
 
+#include "emergency_stop.hpp"
 #include "services.hpp"
 
 using xbot::service::Lock;
@@ -52,19 +54,29 @@ uint32_t EmergencyService::CheckTimeouts(uint32_t now) {
 }
 
 void EmergencyService::UpdateEmergency(uint16_t add, uint16_t clear) {
+  xbot::trace::ScopedSpan span{xbot::trace::Span::EMERGENCY_UPDATE};
   {
     Lock lk{&mtx_};
     uint16_t old_reason = reasons_;
     reasons_ &= ~clear;
     reasons_ |= add;
+    // Motors stopped by the fast path stay stopped because of reasons_ now
+    xbot::emergency_stop::Acknowledge(reasons_);
     if (reasons_ == old_reason) {
       return;
     }
+    if (reasons_ == 0) {
+      xbot::emergency_stop::Release();
+    }
   }
   chEvtBroadcastFlags(&mower_events, MowerEvents::EMERGENCY_CHANGED);
   SendStatus();
 }
 
+void EmergencyService::RaiseEmergency(uint16_t reasons) {
+  UpdateEmergency(reasons);
+}
+
 uint16_t EmergencyService::GetEmergencyReasons() {
   Lock lk{&mtx_};
   return reasons_;
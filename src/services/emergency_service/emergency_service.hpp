@@ -23,6 +23,8 @@ class EmergencyService : public EmergencyServiceBase {
   }
 
   uint16_t GetEmergencyReasons();
+  // Adds reasons from outside the service thread, e.g. the emergency stop fast path
+  void RaiseEmergency(uint16_t reasons);
   uint32_t CheckInputs(uint32_t now);
 
   void RequireService(ServiceExt* svc);
@@ -36,8 +38,8 @@ class EmergencyService : public EmergencyServiceBase {
   uint32_t CheckTimeouts(uint32_t now);
   uint32_t CheckRequiredServices();
   void SendStatus();
-  ServiceSchedule status_schedule_{*this, 1'000'000,
-                                   XBOT_FUNCTION_FOR_METHOD(EmergencyService, &EmergencyService::SendStatus, this)};
+  MonitoredSchedule status_schedule_{*this, 1'000'000,
+                                     XBOT_FUNCTION_FOR_METHOD(EmergencyService, &EmergencyService::SendStatus, this)};
 
   MUTEX_DECL(mtx_);
 
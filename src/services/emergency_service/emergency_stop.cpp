@@ -0,0 +1,130 @@
+//
+// Fast path from a latching emergency input to zero duty on all motors, see emergency_stop.hpp.
+//
+
+#include "emergency_stop.hpp"
+
+#include <ch.h>
+#include <etl/vector.h>
+#include <ulog.h>
+
+#include <services.hpp>
+#include <xbot/timebase.hpp>
+#include <xbot/trace.hpp>
+
+#include "thread_priorities.h"
+
+namespace xbot::emergency_stop {
+
+using driver::motor::MotorDriver;
+
+static etl::vector<MotorDriver*, MAX_MOTORS> motors_{};
+
+static THD_WORKING_AREA(waEmergencyStop, 1024);
+static thread_t* thread_ = nullptr;
+static constexpr eventmask_t EVT_TRIGGERED = EVENT_MASK(0);
+// Held while latching or releasing the motors, so a release can't undo part of a new stop
+static MUTEX_DECL(latch_mutex_);
+
+// Written with the system locked
+static uint16_t pending_reasons_ = 0;
+static uint64_t trigger_ticks_ = 0;
+static LatencyStats stats_{};
+
+static THD_FUNCTION(EmergencyStopThread, arg) {
+  (void)arg;
+  chRegSetThreadName("emergency-stop");
+  while (true) {
+    chEvtWaitAny(EVT_TRIGGERED);
+    chMtxLock(&latch_mutex_);
+    chSysLock();
+    const uint16_t reasons = pending_reasons_;
+    const uint64_t trigger_ticks = trigger_ticks_;
+    chSysUnlock();
+    if (reasons == 0) {
+      chMtxUnlock(&latch_mutex_);
+      continue;
+    }
+
+    // Latched in the drivers until Release(), a service which checked the emergency state just before can't
+    // overwrite the zero duty
+    for (auto* motor : motors_) {
+      if (motor->IsStarted()) {
+        motor->Stop();
+      }
+    }
+    chMtxUnlock(&latch_mutex_);
+    const uint64_t stopped_ticks = xbot::timebase::NowTicks();
+    xbot::trace::Record(xbot::trace::Span::EMERGENCY_STOP, trigger_ticks, stopped_ticks);
+    const auto latency_us = static_cast<uint32_t>(xbot::timebase::TicksToMicros(stopped_ticks - trigger_ticks));
+    chSysLock();
+    stats_.count++;
+    stats_.last_us = latency_us;
+    if (latency_us > stats_.max_us) {
+      stats_.max_us = latency_us;
+    }
+    const LatencyStats stats = stats_;
+    chSysUnlock();
+
+    // From here on, the regular path reports it and keeps the motors stopped
+    emergency_service.RaiseEmergency(reasons);
+    ULOG_INFO("Emergency fast path: motors stopped %lu us after the edge (max %lu us)", stats.last_us, stats.max_us);
+  }
+}
+
+void Start() {
+  // Above all services and drivers, so nothing can delay the zero duty
+  thread_ = chThdCreateStatic(waEmergencyStop, sizeof(waEmergencyStop), THD_PRIO_EMERGENCY_STOP, EmergencyStopThread,
+                              nullptr);
+}
+
+void AddMotor(MotorDriver* motor) {
+  if (motor != nullptr && !motors_.full()) {
+    motors_.push_back(motor);
+  }
+}
+
+void TriggerFromISR(uint16_t reasons) {
+  const uint64_t now = xbot::timebase::NowTicks();
+  chSysLockFromISR();
+  if (pending_reasons_ == 0) {
+    trigger_ticks_ = now;
+  }
+  pending_reasons_ |= reasons;
+  if (thread_ != nullptr) {
+    chEvtSignalI(thread_, EVT_TRIGGERED);
+  }
+  chSysUnlockFromISR();
+}
+
+bool IsPending() {
+  chSysLock();
+  const bool pending = pending_reasons_ != 0;
+  chSysUnlock();
+  return pending;
+}
+
+void Acknowledge(uint16_t reasons) {
+  chSysLock();
+  pending_reasons_ &= ~reasons;
+  chSysUnlock();
+}
+
+void Release() {
+  chMtxLock(&latch_mutex_);
+  if (!IsPending()) {
+    for (auto* motor : motors_) {
+      motor->ReleaseStop();
+    }
+  }
+  chMtxUnlock(&latch_mutex_);
+}
+
+LatencyStats GetLatencyStats() {
+  chSysLock();
+  const LatencyStats stats = stats_;
+  chSysUnlock();
+  return stats;
+}
+
+}  // namespace xbot::emergency_stop
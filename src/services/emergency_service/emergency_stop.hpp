@@ -0,0 +1,55 @@
+//
+// Fast path from a latching emergency input to zero duty on all motors.
+//
+// The regular chain (input driver -> InputService -> EmergencyService -> mower events -> DiffDriveService)
+// wakes up several threads before a motor is stopped. Latching emergency inputs without a delay trigger
+// this path straight from their EXTI callback instead: a thread above all services sends zero duty to every
+// registered motor and then raises the emergency in the EmergencyService, which only reports it from there.
+//
+// Until the EmergencyService has taken over, IsPending() is true and the services must not drive the motors.
+// The motor drivers latch the stop as well (MotorDriver::Stop()) and keep sending zero duty until Release().
+// The latency from the edge interrupt until the last zero duty frame was queued for transmission is measured.
+//
+
+#ifndef EMERGENCY_STOP_HPP
+#define EMERGENCY_STOP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <drivers/motor/motor_driver.hpp>
+
+namespace xbot::emergency_stop {
+
+constexpr size_t MAX_MOTORS = 4;
+
+struct LatencyStats {
+  uint32_t count;
+  // Edge interrupt until all motors got their zero duty
+  uint32_t last_us;
+  uint32_t max_us;
+};
+
+// Starts the thread, call before the services are started
+void Start();
+
+// Motors stopped by the fast path, call before Start()
+void AddMotor(driver::motor::MotorDriver* motor);
+
+// Called from the EXTI callback of a latching emergency input
+void TriggerFromISR(uint16_t reasons);
+
+// Motors were stopped, but the EmergencyService doesn't know yet
+bool IsPending();
+
+// Called by the EmergencyService with its current reasons, clears the pending reasons contained in them
+void Acknowledge(uint16_t reasons);
+
+// Called by the EmergencyService once all emergency reasons are cleared, lets the motors run again unless
+// another stop is pending
+void Release();
+
+LatencyStats GetLatencyStats();
+
+}  // namespace xbot::emergency_stop
+
+#endif  // EMERGENCY_STOP_HPP
@@ -8,6 +8,7 @@
 #include <board_utils.hpp>
 #include <cstdio>
 #include <globals.hpp>
+#include <xbot/sample_stamps.hpp>
 
 #include "debug/debug_udp_interface.hpp"
 
@@ -66,10 +67,13 @@ bool GpsService::OnStart() {
 }
 
 void GpsService::OnRTCMChanged(const uint8_t* new_value, uint32_t length) {
-  // Update NTRIP timestamp when RTCM data is received
-  last_ntrip_time_ = chVTGetSystemTimeX();
-
-  gps_driver_->SendRTCM(new_value, length);
+  if (gps_driver_ == nullptr) {
+    return;
+  }
+  // Update NTRIP timestamp when valid RTCM frames are received, corrupted ones are dropped by the driver
+  if (gps_driver_->SendRTCM(new_value, length) > 0) {
+    last_ntrip_time_ = chVTGetSystemTimeX();
+  }
 }
 
 void GpsService::GpsStateCallback(const GpsDriver::GpsState& state) {
@@ -86,6 +90,57 @@ void GpsService::GpsStateCallback(const GpsDriver::GpsState& state) {
   double vel[3] = {state.vel_e, state.vel_n, state.vel_u};
   SendMotionVectorENU(vel, 3);
   CommitTransaction();
+  xbot::sample_stamps::Send(service_id_, xbot::sample_stamps::Source::GPS_FIX, state.capture_ticks);
+}
+
+uint32_t GpsService::GetRtcmAgeMillis() const {
+  if (gps_driver_ == nullptr || gps_driver_->GetLastRtcmTime() == 0) {
+    return UINT32_MAX;
+  }
+  return TIME_I2MS(chVTTimeElapsedSinceX(gps_driver_->GetLastRtcmTime()));
+}
+
+void GpsService::PublishRtcmStats() {
+  if (gps_driver_ == nullptr) {
+    return;
+  }
+  const Rtcm3Parser::Stats& stats = gps_driver_->GetRtcmStats();
+  RtcmReport report{};
+  report.frames = stats.frames;
+  report.crc_errors = stats.crc_errors;
+  report.skipped_bytes = stats.skipped_bytes;
+  report.other_types = stats.other_types;
+  report.age_ms = GetRtcmAgeMillis();
+  report.tx_bytes_dropped = gps_driver_->GetTxStats().bytes_dropped;
+  for (size_t i = 0; i < Rtcm3Parser::MAX_MESSAGE_TYPES; i++) {
+    report.types[i].message_type = stats.types[i].message_type;
+    report.types[i].count = stats.types[i].count;
+  }
+  rtcm_report_.Publish(&report, sizeof(report));
+}
+
+void GpsService::LogRtcmStats() {
+  if (gps_driver_ == nullptr) {
+    return;
+  }
+  const Rtcm3Parser::Stats& stats = gps_driver_->GetRtcmStats();
+  if (stats.frames == last_rtcm_frames_ && stats.crc_errors == last_rtcm_crc_errors_) {
+    // No corrections, nothing to report
+    return;
+  }
+  const uint32_t frames = stats.frames - last_rtcm_frames_;
+  last_rtcm_frames_ = stats.frames;
+  last_rtcm_crc_errors_ = stats.crc_errors;
+
+  char msg[200]{};
+  int len = chsnprintf(msg, sizeof(msg), "RTCM: %u frames/s, %u CRC errors, age %u ms, %u TX bytes dropped, types:",
+                       frames / (RTCM_STATS_INTERVAL_MICROS / 1'000'000), stats.crc_errors, GetRtcmAgeMillis(),
+                       gps_driver_->GetTxStats().bytes_dropped);
+  for (const auto& type : stats.types) {
+    if (type.count == 0 || len >= static_cast<int>(sizeof(msg))) break;
+    len += chsnprintf(msg + len, sizeof(msg) - len, " %u:%u", type.message_type, type.count);
+  }
+  ULOG_ARG_INFO(&service_id_, msg);
 }
 
 uint32_t GpsService::GetSecondsSinceLastRtcmPacket() const {
@@ -5,6 +5,7 @@
 
 #include <cstring>
 #include <globals.hpp>
+#include <xbot/io_diagnostics.hpp>
 
 #include "GpsServiceBase.hpp"
 #include "debug/debug_tcp_interface.hpp"
@@ -12,6 +13,31 @@
 using namespace xbot::driver::gps;
 
 class GpsService : public GpsServiceBase {
+ public:
+  // ServiceReport type of the RTCM statistics
+  static constexpr uint8_t RTCM_REPORT_TYPE = 0;
+
+#pragma pack(push, 1)
+  struct RtcmTypeCount {
+    uint16_t message_type;
+    uint32_t count;
+  };
+
+  struct RtcmReport {
+    // Totals since the driver started
+    uint32_t frames;
+    uint32_t crc_errors;
+    uint32_t skipped_bytes;
+    uint32_t other_types;
+    // Age of corrections in ms, UINT32_MAX without any
+    uint32_t age_ms;
+    // Corrections which didn't fit the GPS TX queue
+    uint32_t tx_bytes_dropped;
+    RtcmTypeCount types[Rtcm3Parser::MAX_MESSAGE_TYPES];
+  };
+#pragma pack(pop)
+  static_assert(sizeof(RtcmReport) <= xbot::io_diagnostics::ServiceReport::MAX_SIZE, "RTCM report too large");
+
  private:
   THD_WORKING_AREA(wa, 1536){};
 
@@ -33,6 +59,12 @@ class GpsService : public GpsServiceBase {
    */
   uint32_t GetSecondsSinceLastRtcmPacket() const;
 
+  /**
+   * @brief Age of corrections: time since the last valid RTCM frame was forwarded to the receiver
+   * @return Age in ms, UINT32_MAX if no valid frame was forwarded yet
+   */
+  uint32_t GetRtcmAgeMillis() const;
+
   /**
    * @brief Load and start GPS driver instance.
    * Allows initializing the GPS driver before service OnStart(), enabling
@@ -60,6 +92,20 @@ class GpsService : public GpsServiceBase {
   GpsDriver::GpsState empty_gps_state_{};
 
   void GpsStateCallback(const GpsDriver::GpsState& state);
+
+  // RTCM frame counters and age of corrections. The service definition has no outputs for them, so they are
+  // served on the diagnostics channel (xbot/io_diagnostics.hpp) and logged.
+  static constexpr uint32_t RTCM_REPORT_INTERVAL_MICROS = 1'000'000;
+  static constexpr uint32_t RTCM_STATS_INTERVAL_MICROS = 10'000'000;
+  uint32_t last_rtcm_frames_ = 0;
+  uint32_t last_rtcm_crc_errors_ = 0;
+  xbot::io_diagnostics::ServiceReport rtcm_report_{service_id_, RTCM_REPORT_TYPE};
+  void PublishRtcmStats();
+  void LogRtcmStats();
+  MonitoredSchedule rtcm_report_schedule_{*this, RTCM_REPORT_INTERVAL_MICROS,
+                                          XBOT_FUNCTION_FOR_METHOD(GpsService, &GpsService::PublishRtcmStats, this)};
+  MonitoredSchedule rtcm_stats_schedule_{*this, RTCM_STATS_INTERVAL_MICROS,
+                                         XBOT_FUNCTION_FOR_METHOD(GpsService, &GpsService::LogRtcmStats, this)};
 };
 
 #endif
@@ -4,11 +4,17 @@
 
 #include "imu_service.hpp"
 
+#include <etl/algorithm.h>
 #include <etl/to_string.h>
 #include <lsm6ds3tr-c_reg.h>
 #include <ulog.h>
 
+#include <cstring>
+
+#include <services.hpp>
 #include <xbot-service/portable/system.hpp>
+#include <xbot/sample_stamps.hpp>
+#include <xbot/trace.hpp>
 
 static SPIConfig spi_config = {
     false,
@@ -22,20 +28,45 @@ static SPIConfig spi_config = {
 
 static stmdev_ctx_t dev_ctx{};
 
+// Sensitivity for the configured full scales (2 g, 2000 dps)
+static constexpr double MG_PER_LSB = 0.061;
+static constexpr double MDPS_PER_LSB = 70.0;
+
+static void FifoWatermarkCallback(void *) {
+  imu_service.OnFifoWatermark();
+}
+
+// SPI DMA bounce buffer in non-cacheable RAM. Register accesses are only done from the service thread.
+// Large enough for a full FIFO burst (16 samples of 12 bytes), so a burst is a single DMA transfer.
+static constexpr size_t SPI_BUFFER_SIZE = 192;
+CC_SECTION(".nocache") static uint8_t spi_buffer[SPI_BUFFER_SIZE];
+
 static constexpr auto write_reg_lambda = [](void *, uint8_t reg, const uint8_t *bufp, uint16_t len) {
   spiSelect(&SPID_IMU);
-  spiSend(&SPID_IMU, 1, &reg);
-  spiSend(&SPID_IMU, len, bufp);
+  spi_buffer[0] = reg;
+  spiSend(&SPID_IMU, 1, spi_buffer);
+  while (len > 0) {
+    uint16_t chunk = etl::min<uint16_t>(len, SPI_BUFFER_SIZE);
+    memcpy(spi_buffer, bufp, chunk);
+    spiSend(&SPID_IMU, chunk, spi_buffer);
+    bufp += chunk;
+    len -= chunk;
+  }
   spiUnselect(&SPID_IMU);
   return (int32_t)0;
 };
 
 static constexpr auto read_reg_lambda = [](void *, uint8_t reg, uint8_t *bufp, uint16_t len) {
-  reg |= 0x80;
-
   spiSelect(&SPID_IMU);
-  spiSend(&SPID_IMU, 1, &reg);
-  spiReceive(&SPID_IMU, len, bufp);
+  spi_buffer[0] = reg | 0x80;
+  spiSend(&SPID_IMU, 1, spi_buffer);
+  while (len > 0) {
+    uint16_t chunk = etl::min<uint16_t>(len, SPI_BUFFER_SIZE);
+    spiReceive(&SPID_IMU, chunk, spi_buffer);
+    memcpy(bufp, spi_buffer, chunk);
+    bufp += chunk;
+    len -= chunk;
+  }
   spiUnselect(&SPID_IMU);
   return (int32_t)0;
 };
@@ -95,6 +126,17 @@ void ImuService::OnCreate() {
   // lsm6ds3tr_c_xl_lp1_bandwidth_set(&dev_ctx, LSM6DS3TR_C_XL_LP1_ODR_DIV_4);
   /* Accelerometer - LPF1 + LPF2 path */
   lsm6ds3tr_c_xl_lp2_bandwidth_set(&dev_ctx, LSM6DS3TR_C_XL_LOW_NOISE_LP_ODR_DIV_100);
+  /* FIFO: batch gyro and accelerometer at the full ODR, keep the newest samples */
+  lsm6ds3tr_c_fifo_gy_batch_set(&dev_ctx, LSM6DS3TR_C_FIFO_GY_NO_DEC);
+  lsm6ds3tr_c_fifo_xl_batch_set(&dev_ctx, LSM6DS3TR_C_FIFO_XL_NO_DEC);
+  lsm6ds3tr_c_fifo_data_rate_set(&dev_ctx, LSM6DS3TR_C_FIFO_833Hz);
+  lsm6ds3tr_c_fifo_watermark_set(&dev_ctx, samples_per_output_ * WORDS_PER_SAMPLE);
+  lsm6ds3tr_c_fifo_mode_set(&dev_ctx, LSM6DS3TR_C_STREAM_MODE);
+  /* FIFO threshold interrupt on INT1 */
+  lsm6ds3tr_c_int1_route_t int1_route{};
+  lsm6ds3tr_c_pin_int1_route_get(&dev_ctx, &int1_route);
+  int1_route.int1_fth = PROPERTY_ENABLE;
+  lsm6ds3tr_c_pin_int1_route_set(&dev_ctx, int1_route);
   ULOG_ARG_INFO(&service_id_, "IMU configured successfully");
 }
 
@@ -111,9 +153,42 @@ bool ImuService::OnStart() {
     axis_remap_idx_[i] = abs(val) - 1;
   }
 
+  memset(sum_angular_rate_, 0, sizeof(sum_angular_rate_));
+  memset(sum_acceleration_, 0, sizeof(sum_acceleration_));
+  sum_count_ = 0;
+
+  if (imu_found) {
+    palSetLineCallback(LINE_IMU_INTERRUPT, FifoWatermarkCallback, nullptr);
+    palEnableLineEvent(LINE_IMU_INTERRUPT, PAL_EVENT_MODE_RISING_EDGE);
+  }
+
   return true;
 }
 
+void ImuService::OnStop() {
+  if (imu_found) {
+    palDisableLineEvent(LINE_IMU_INTERRUPT);
+  }
+}
+
+void ImuService::OnFifoWatermark() {
+  // Capture first, the service thread gets to the data much later
+  const uint64_t now = xbot::timebase::NowTicks();
+  syssts_t sts = chSysGetStatusAndLockX();
+  watermark_ticks_ = now;
+  watermark_pending_ = true;
+  chSysRestoreStatusX(sts);
+  SendEvent(Events::IMU_FIFO_WATERMARK);
+}
+
+uint32_t ImuService::OnLoop(uint32_t, uint32_t) {
+  eventmask_t events = chEvtGetAndClearEvents(Events::ids_to_mask({Events::IMU_FIFO_WATERMARK}));
+  if ((events & EVENT_MASK(Events::IMU_FIFO_WATERMARK)) && imu_found) {
+    ReadFifo();
+  }
+  return UINT32_MAX;
+}
+
 void ImuService::tick() {
   if (!imu_found) {
     static uint32_t last_log = 0;
@@ -124,37 +199,107 @@ void ImuService::tick() {
     }
     return;
   }
-  lsm6ds3tr_c_reg_t reg;
-  lsm6ds3tr_c_status_reg_get(&dev_ctx, &reg.status_reg);
-
-  if (reg.status_reg.xlda) {
-    /* Read magnetic field data */
-    memset(data_raw_acceleration, 0x00, 3 * sizeof(int16_t));
-    lsm6ds3tr_c_acceleration_raw_get(&dev_ctx, data_raw_acceleration);
-    axes[0] = axis_remap_sign_[0] * lsm6ds3tr_c_from_fs2g_to_mg(data_raw_acceleration[axis_remap_idx_[0]]) * 0.00980665;
-    axes[1] = axis_remap_sign_[1] * lsm6ds3tr_c_from_fs2g_to_mg(data_raw_acceleration[axis_remap_idx_[1]]) * 0.00980665;
-    axes[2] = axis_remap_sign_[2] * lsm6ds3tr_c_from_fs2g_to_mg(data_raw_acceleration[axis_remap_idx_[2]]) * 0.00980665;
-  }
-
-  if (reg.status_reg.gda) {
-    /* Read magnetic field data */
-    memset(data_raw_angular_rate, 0x00, 3 * sizeof(int16_t));
-    lsm6ds3tr_c_angular_rate_raw_get(&dev_ctx, data_raw_angular_rate);
-    axes[3] = axis_remap_sign_[0] * M_PI *
-              lsm6ds3tr_c_from_fs2000dps_to_mdps(data_raw_angular_rate[axis_remap_idx_[0]]) / 180000.0;
-    axes[4] = axis_remap_sign_[1] * M_PI *
-              lsm6ds3tr_c_from_fs2000dps_to_mdps(data_raw_angular_rate[axis_remap_idx_[1]]) / 180000.0;
-    axes[5] = axis_remap_sign_[2] * M_PI *
-              lsm6ds3tr_c_from_fs2000dps_to_mdps(data_raw_angular_rate[axis_remap_idx_[2]]) / 180000.0;
-  }
-
-  /*if (reg.status_reg.tda) {
-    // Read temperature data
-    memset(&data_raw_temperature, 0x00, sizeof(int16_t));
-    lsm6ds3tr_c_temperature_raw_get(&dev_ctx, &data_raw_temperature);
-    temperature_degC = lsm6ds3tr_c_from_lsb_to_celsius(
-                         data_raw_temperature );
-  }*/
-
-  SendAxes(axes, 9);
+  // The threshold interrupt is edge triggered. If an edge was missed, the line stays high
+  // and no further interrupt arrives until the FIFO was read.
+  ReadFifo();
+}
+
+void ImuService::UpdateOutputRate() {
+  const uint32_t generation = xbot::output_subscriptions::GetGeneration();
+  if (generation == subscription_generation_) {
+    return;
+  }
+  subscription_generation_ = generation;
+  const uint32_t period_us = xbot::output_subscriptions::GetPeriodUs(service_id_, axes_gate_.GetOutputId());
+  // Round down, the output gate drops the outputs which come too early
+  const uint32_t samples = period_us == 0 ? SAMPLES_PER_OUTPUT : period_us * ODR_HZ / 1'000'000;
+  const uint16_t samples_per_output = etl::clamp<uint32_t>(samples, MIN_SAMPLES_PER_OUTPUT, MAX_SAMPLES_PER_OUTPUT);
+  if (samples_per_output == samples_per_output_) {
+    return;
+  }
+  samples_per_output_ = samples_per_output;
+  lsm6ds3tr_c_fifo_watermark_set(&dev_ctx, samples_per_output_ * WORDS_PER_SAMPLE);
+  ULOG_ARG_INFO(&service_id_, "IMU output averages %d samples", samples_per_output_);
+}
+
+void ImuService::ReadFifo() {
+  xbot::trace::ScopedSpan span{xbot::trace::Span::IMU_READ_FIFO};
+  // FIFO_STATUS1..4: number of unread words, flags and the pattern index of the next word
+  uint8_t status[4];
+  lsm6ds3tr_c_read_reg(&dev_ctx, LSM6DS3TR_C_FIFO_STATUS1, status, sizeof(status));
+  uint16_t unread_words = status[0] | (status[1] & 0x07) << 8;
+  const bool over_run = status[1] & 0x40;
+  const uint16_t pattern = status[2] | (status[3] & 0x03) << 8;
+
+  // The FIFO was (almost) empty after the last read, so at the interrupt it held exactly the watermark.
+  // Without an interrupt (fallback read), continue from the previous timestamps.
+  chSysLock();
+  if (watermark_pending_) {
+    next_sample_ticks_ = watermark_ticks_ - (samples_per_output_ - 1) * SAMPLE_PERIOD_TICKS;
+    watermark_pending_ = false;
+  }
+  chSysUnlock();
+
+  if (over_run) {
+    fifo_overruns_++;
+    ULOG_ARG_WARNING(&service_id_, "IMU FIFO overrun, samples lost (%lu overruns)", fifo_overruns_);
+  }
+
+  // Skip the rest of a partially read sample so that each burst starts with gyro X
+  if (pattern != 0) {
+    const uint16_t skip = etl::min<uint16_t>(WORDS_PER_SAMPLE - pattern, unread_words);
+    lsm6ds3tr_c_read_reg(&dev_ctx, LSM6DS3TR_C_FIFO_DATA_OUT_L, reinterpret_cast<uint8_t *>(fifo_words_),
+                         skip * sizeof(int16_t));
+    unread_words -= skip;
+  }
+
+  // The FIFO output register rolls over, so a burst can read many samples in one transaction
+  uint16_t samples = unread_words / WORDS_PER_SAMPLE;
+  while (samples > 0) {
+    const uint16_t burst = etl::min(samples, SAMPLES_PER_BURST);
+    lsm6ds3tr_c_read_reg(&dev_ctx, LSM6DS3TR_C_FIFO_DATA_OUT_L, reinterpret_cast<uint8_t *>(fifo_words_),
+                         burst * WORDS_PER_SAMPLE * sizeof(int16_t));
+    for (uint16_t i = 0; i < burst; i++) {
+      AddSample(&fifo_words_[i * WORDS_PER_SAMPLE], next_sample_ticks_);
+      next_sample_ticks_ += SAMPLE_PERIOD_TICKS;
+    }
+    samples -= burst;
+  }
+
+  // After draining the FIFO, the timestamps above are based on the watermark which raised the interrupt
+  UpdateOutputRate();
+}
+
+void ImuService::AddSample(const int16_t *words, uint64_t ticks) {
+  if (sum_count_ == 0) {
+    window_start_ticks_ = ticks;
+  }
+  for (int i = 0; i < 3; i++) {
+    sum_angular_rate_[i] += words[i];
+    sum_acceleration_[i] += words[3 + i];
+  }
+  if (++sum_count_ >= samples_per_output_) {
+    SendAverage();
+  }
+}
+
+void ImuService::SendAverage() {
+  // Averaging over the output period acts as anti-aliasing filter for the decimation
+  for (int i = 0; i < 3; i++) {
+    const double acceleration = static_cast<double>(sum_acceleration_[axis_remap_idx_[i]]) / sum_count_;
+    const double angular_rate = static_cast<double>(sum_angular_rate_[axis_remap_idx_[i]]) / sum_count_;
+    axes[i] = axis_remap_sign_[i] * acceleration * MG_PER_LSB * 0.00980665;
+    axes[3 + i] = axis_remap_sign_[i] * M_PI * angular_rate * MDPS_PER_LSB / 180000.0;
+  }
+
+  last_output_ticks_ = window_start_ticks_ + (sum_count_ - 1) * SAMPLE_PERIOD_TICKS / 2;
+
+  memset(sum_angular_rate_, 0, sizeof(sum_angular_rate_));
+  memset(sum_acceleration_, 0, sizeof(sum_acceleration_));
+  sum_count_ = 0;
+
+  if (axes_gate_.Due(last_output_ticks_)) {
+    SendAxes(axes, 9);
+    xbot::sample_stamps::Send(service_id_, xbot::sample_stamps::Source::IMU_AXES, last_output_ticks_);
+  }
 }
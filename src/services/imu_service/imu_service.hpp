@@ -10,6 +10,7 @@
 #include <etl/string.h>
 
 #include <ImuServiceBase.hpp>
+#include <xbot/timebase.hpp>
 
 using namespace xbot::service;
 
@@ -29,26 +30,67 @@ class ImuService : public ImuServiceBase {
     return IsRunning() && imu_found;
   }
 
+  // Called from the INT1 (FIFO threshold) EXTI
+  void OnFifoWatermark();
+
  protected:
   void OnCreate() override;
   bool OnStart() override;
+  void OnStop() override;
+  uint32_t OnLoop(uint32_t now_micros, uint32_t last_tick_micros) override;
 
  private:
+  // The sensor batches gyro and accelerometer samples at the ODR (833 Hz) into its FIFO.
+  // One output is the average of this many samples (~104 Hz), the FIFO watermark interrupt
+  // fires once per output.
+  static constexpr uint16_t SAMPLES_PER_OUTPUT = 8;
+  // Range for host subscriptions (~208 Hz to ~26 Hz), slower ones are decimated by the output gate
+  static constexpr uint16_t MIN_SAMPLES_PER_OUTPUT = 4;
+  static constexpr uint16_t MAX_SAMPLES_PER_OUTPUT = 32;
+  static constexpr uint32_t ODR_HZ = 833;
+  // One FIFO data set: gyro X/Y/Z followed by accelerometer X/Y/Z, 16 bit each
+  static constexpr uint16_t WORDS_PER_SAMPLE = 6;
+  // Samples read per SPI burst
+  static constexpr uint16_t SAMPLES_PER_BURST = 16;
+  static constexpr uint32_t SAMPLE_PERIOD_TICKS = xbot::timebase::TICKS_PER_SECOND / ODR_HZ;
+
   etl::atomic<bool> imu_found{false};
   etl::string<255> error_message{};
 
-  int16_t data_raw_acceleration[3];
-  int16_t data_raw_angular_rate[3];
-  int16_t data_raw_temperature;
+  int16_t fifo_words_[SAMPLES_PER_BURST * WORDS_PER_SAMPLE]{};
+  int32_t sum_angular_rate_[3]{};
+  int32_t sum_acceleration_[3]{};
+  uint16_t sum_count_ = 0;
+  uint16_t samples_per_output_ = SAMPLES_PER_OUTPUT;
+  uint32_t fifo_overruns_ = 0;
+
+  // Capture time of the last threshold interrupt, the sample completing the watermark was written then
+  volatile uint64_t watermark_ticks_ = 0;
+  volatile bool watermark_pending_ = false;
+  // Timestamps, derived from the interrupt and the sample period
+  uint64_t next_sample_ticks_ = 0;
+  uint64_t window_start_ticks_ = 0;
+  uint64_t last_output_ticks_ = 0;
   double axes[9]{};
-  float temperature_degC;
+
+  // The IMU sends a single output, it follows the service wide subscription
+  xbot::output_subscriptions::OutputGate axes_gate_{service_id_, xbot::output_subscriptions::ALL_OUTPUTS};
+  uint32_t subscription_generation_ = 0;
 
   // Default (YardForce mainboard) mapping: +X-Y-Z
   etl::array<uint8_t, 3> axis_remap_idx_{1, 2, 3};
   etl::array<int8_t, 3> axis_remap_sign_{1, -1, -1};
 
+  // Averages over the subscribed output period, reprograms the FIFO watermark if it changed
+  void UpdateOutputRate();
+  // Reads all complete samples from the FIFO and sends an output for every samples_per_output_ of them
+  void ReadFifo();
+  void AddSample(const int16_t* words, uint64_t ticks);
+  void SendAverage();
+
+  // Normally the FIFO is read on the watermark interrupt, this catches a missed edge.
   void tick();
-  ServiceSchedule tick_schedule_{*this, 10'000, XBOT_FUNCTION_FOR_METHOD(ImuService, &ImuService::tick, this)};
+  MonitoredSchedule tick_schedule_{*this, 100'000, XBOT_FUNCTION_FOR_METHOD(ImuService, &ImuService::tick, this)};
 };
 
 #endif  // IMU_SERVICE_HPP
@@ -71,8 +71,8 @@ class InputService : public InputServiceBase {
 
   bool SendInputEventHelper(Input& input, InputEventType type);
   void SendStatus();
-  ServiceSchedule tick_schedule_{*this, 200'000,
-                                 XBOT_FUNCTION_FOR_METHOD(InputService, &InputService::SendStatus, this)};
+  MonitoredSchedule tick_schedule_{*this, 200'000,
+                                   XBOT_FUNCTION_FOR_METHOD(InputService, &InputService::SendStatus, this)};
 
   THD_WORKING_AREA(wa, 3072){};
 };
@@ -6,8 +6,10 @@
 
 #include <cmath>
 #include <xbot-service/portable/system.hpp>
+#include <xbot/sample_stamps.hpp>
 
 #include "services.hpp"
+#include "services/emergency_service/emergency_stop.hpp"
 
 void MowerService::OnCreate() {
   chDbgAssert(mower_driver_ != nullptr, "Mower Motor Driver cannot be null!");
@@ -18,6 +20,7 @@ void MowerService::OnCreate() {
 
 bool MowerService::OnStart() {
   mower_duty_ = 0;
+  keyframe_timer_.Force();
   return true;
 }
 
@@ -46,25 +49,50 @@ void MowerService::tick() {
   // TODO: actually detect some rain
   bool rain_detected = false;
 
-  StartTransaction();
-  SendRainDetected(rain_detected);
+  OutputFrame frame{keyframe_timer_.Due(xbot::service::system::getTimeMicros())};
+  const bool send_rain = frame.Update(rain_output_, rain_detected);
 
   // Check, if we have received ESC status updates recently. If not, send a disconnected message
-  if (xbot::service::system::getTimeMicros() - last_valid_esc_state_micros_ > 1'000'000 || !esc_state_valid_) {
+  const bool esc_connected =
+      xbot::service::system::getTimeMicros() - last_valid_esc_state_micros_ <= 1'000'000 && esc_state_valid_;
+  if (!esc_connected) {
     // No recent update received (or none at all)
     mower_duty_ = 0;
-    SendMowerStatus(static_cast<uint8_t>(MotorDriver::ESCState::ESCStatus::ESC_STATUS_DISCONNECTED));
-  } else {
-    // We got recent data, send it
+    // Send all values again once it's back
+    esc_temperature_output_.Invalidate();
+    current_output_.Invalidate();
+    motor_temperature_output_.Invalidate();
+    running_output_.Invalidate();
+    rpm_output_.Invalidate();
+  }
+  using ESCStatus = MotorDriver::ESCState::ESCStatus;
+  const auto status = static_cast<uint8_t>(esc_connected ? esc_state_.status : ESCStatus::ESC_STATUS_DISCONNECTED);
+  const bool send_status = frame.Update(status_output_, status);
+  // Only sent while we got recent data
+  bool send_esc_temperature = false, send_current = false, send_motor_temperature = false, send_running = false,
+       send_rpm = false;
+  if (esc_connected) {
+    send_esc_temperature = frame.Update(esc_temperature_output_, esc_state_.temperature_pcb);
+    send_current = frame.Update(current_output_, esc_state_.current_input);
+    send_motor_temperature = frame.Update(motor_temperature_output_, esc_state_.temperature_motor);
+    send_running = frame.Update(running_output_, std::fabs(esc_state_.rpm) > 0);
+    send_rpm = frame.Update(rpm_output_, esc_state_.rpm);
+  }
+
+  if (frame.Any()) {
     StartTransaction();
-    SendMowerESCTemperature(esc_state_.temperature_pcb);
-    SendMowerMotorCurrent(esc_state_.current_input);
-    SendMowerStatus(static_cast<uint8_t>(esc_state_.status));
-    SendMowerMotorTemperature(esc_state_.temperature_motor);
-    SendMowerRunning(std::fabs(esc_state_.rpm) > 0);
-    SendMowerMotorRPM(esc_state_.rpm);
+    if (send_rain) SendRainDetected(rain_detected);
+    if (send_esc_temperature) SendMowerESCTemperature(esc_state_.temperature_pcb);
+    if (send_current) SendMowerMotorCurrent(esc_state_.current_input);
+    if (send_status) SendMowerStatus(status);
+    if (send_motor_temperature) SendMowerMotorTemperature(esc_state_.temperature_motor);
+    if (send_running) SendMowerRunning(std::fabs(esc_state_.rpm) > 0);
+    if (send_rpm) SendMowerMotorRPM(esc_state_.rpm);
+    CommitTransaction();
+    if (send_esc_temperature || send_current || send_motor_temperature || send_running || send_rpm) {
+      xbot::sample_stamps::Send(service_id_, xbot::sample_stamps::Source::MOWER_ESC, esc_state_.capture_ticks);
+    }
   }
-  CommitTransaction();
 
   duty_sent_ = false;
   chMtxUnlock(&mtx);
@@ -80,8 +108,8 @@ void MowerService::ESCCallback(const MotorDriver::ESCState& state) {
 }
 
 void MowerService::SetDuty() {
-  // Get the current emergency state
-  bool emergency = emergency_service.GetEmergencyReasons() != 0;
+  // Get the current emergency state, including one the fast path stopped the motors for
+  bool emergency = emergency_service.GetEmergencyReasons() != 0 || xbot::emergency_stop::IsPending();
   if (emergency) {
     mower_driver_->SetDuty(0);
   } else {
@@ -106,6 +134,7 @@ void MowerService::OnMowerEnabledChanged(const uint8_t& new_value) {
 
 void MowerService::SetDriver(MotorDriver* motor_driver) {
   mower_driver_ = motor_driver;
+  xbot::emergency_stop::AddMotor(motor_driver);
 }
 void MowerService::OnEmergencyChangedEvent() {
   bool emergency = emergency_service.GetEmergencyReasons() != 0;
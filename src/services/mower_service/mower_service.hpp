@@ -12,6 +12,7 @@
 #include <debug/debug_tcp_interface.hpp>
 #include <drivers/motor/motor_driver.hpp>
 #include <globals.hpp>
+#include <services/output_cache.hpp>
 
 using namespace xbot::driver::motor;
 using namespace xbot::service;
@@ -40,7 +41,7 @@ class MowerService : public MowerServiceBase {
 
  private:
   void tick();
-  ServiceSchedule tick_schedule_{*this, 500'000, XBOT_FUNCTION_FOR_METHOD(MowerService, &MowerService::tick, this)};
+  MonitoredSchedule tick_schedule_{*this, 500'000, XBOT_FUNCTION_FOR_METHOD(MowerService, &MowerService::tick, this)};
 
   void SetDuty();
   MUTEX_DECL(mtx);
@@ -61,6 +62,16 @@ class MowerService : public MowerServiceBase {
   bool duty_sent_ = false;
   etl::atomic<bool> esc_ever_connected_{false};
   MotorDriver* mower_driver_ = nullptr;
+
+  // Values are only sent when they changed, with a keyframe every 5 s (see services/output_cache.hpp)
+  KeyframeTimer keyframe_timer_{5'000'000};
+  CachedOutput<bool> rain_output_{};
+  CachedOutput<uint8_t> status_output_{};
+  CachedOutput<float> esc_temperature_output_{0.5f};
+  CachedOutput<float> current_output_{0.05f};
+  CachedOutput<float> motor_temperature_output_{0.5f};
+  CachedOutput<bool> running_output_{};
+  CachedOutput<float> rpm_output_{20.0f};
 };
 
 #endif  // MOWER_SERVICE_HPP
@@ -0,0 +1,170 @@
+//
+// Delta telemetry for slowly varying service outputs.
+//
+// Each output remembers the value it was last sent with. A new value is only sent if it differs by more
+// than the output's deadband, or on a keyframe, when all outputs are sent so the host can't miss a value
+// for long (e.g. after it reconnected). The deadband is relative to the last sent value, so a slow drift
+// is still sent once it exceeds the deadband.
+//
+// Usage, once per service tick:
+//   OutputFrame frame{keyframe_timer_.Due(now)};
+//   const bool send_voltage = frame.Update(voltage_output_, voltage);
+//   ...
+//   if (frame.Any()) { StartTransaction(); if (send_voltage) SendVoltage(voltage); ... CommitTransaction(); }
+//
+
+#ifndef OUTPUT_CACHE_HPP
+#define OUTPUT_CACHE_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace xbot::service {
+
+template <typename T>
+class CachedOutput {
+ public:
+  explicit CachedOutput(T deadband = T{}) : deadband_(deadband) {
+  }
+
+  /**
+   * @return true if the value should be sent (changed beyond the deadband, first value or keyframe),
+   * it is then remembered as the last sent one
+   */
+  bool Update(const T& value, bool keyframe) {
+    if (!keyframe && valid_ && !Differs(value)) {
+      return false;
+    }
+    last_ = value;
+    valid_ = true;
+    return true;
+  }
+
+  void Invalidate() {
+    valid_ = false;
+  }
+
+ private:
+  bool Differs(const T& value) const {
+    if constexpr (std::is_floating_point_v<T>) {
+      // NaN means "not available", only a change to or from it counts
+      if (std::isnan(value) || std::isnan(last_)) {
+        return std::isnan(value) != std::isnan(last_);
+      }
+      return std::fabs(value - last_) > deadband_;
+    } else if constexpr (std::is_arithmetic_v<T>) {
+      return (value > last_ ? value - last_ : last_ - value) > deadband_;
+    } else {
+      return !(value == last_);
+    }
+  }
+
+  T deadband_;
+  T last_{};
+  bool valid_ = false;
+};
+
+/**
+ * Strings and blobs: only a hash and the length of the last sent data are kept.
+ */
+class CachedStringOutput {
+ public:
+  /**
+   * @param length Set to the string length, so the caller doesn't need another strlen()
+   */
+  bool Update(const char* value, size_t* length, bool keyframe) {
+    // FNV-1a, computed in the same pass as the length
+    uint32_t hash = 2166136261u;
+    size_t size = 0;
+    for (; value[size] != '\0'; size++) {
+      hash = (hash ^ static_cast<uint8_t>(value[size])) * 16777619u;
+    }
+    *length = size;
+    if (!keyframe && valid_ && hash == hash_ && size == length_) {
+      return false;
+    }
+    hash_ = hash;
+    length_ = size;
+    valid_ = true;
+    return true;
+  }
+
+  void Invalidate() {
+    valid_ = false;
+  }
+
+ private:
+  uint32_t hash_ = 0;
+  size_t length_ = 0;
+  bool valid_ = false;
+};
+
+/**
+ * Forces a keyframe every interval.
+ */
+class KeyframeTimer {
+ public:
+  explicit KeyframeTimer(uint32_t interval_micros) : interval_micros_(interval_micros) {
+  }
+
+  bool Due(uint32_t now_micros) {
+    if (pending_ || now_micros - last_micros_ >= interval_micros_) {
+      pending_ = false;
+      last_micros_ = now_micros;
+      return true;
+    }
+    return false;
+  }
+
+  // Makes the next call to Due() return true, e.g. when the service (re)starts
+  void Force() {
+    pending_ = true;
+  }
+
+  void SetInterval(uint32_t interval_micros) {
+    interval_micros_ = interval_micros;
+  }
+
+ private:
+  uint32_t interval_micros_;
+  uint32_t last_micros_ = 0;
+  bool pending_ = true;
+};
+
+/**
+ * Collects the send decisions of one service tick.
+ */
+class OutputFrame {
+ public:
+  explicit OutputFrame(bool keyframe) : keyframe_(keyframe) {
+  }
+
+  template <typename T>
+  bool Update(CachedOutput<T>& output, const T& value) {
+    return Track(output.Update(value, keyframe_));
+  }
+
+  bool Update(CachedStringOutput& output, const char* value, size_t* length) {
+    return Track(output.Update(value, length, keyframe_));
+  }
+
+  // At least one output has to be sent
+  bool Any() const {
+    return any_;
+  }
+
+ private:
+  bool Track(bool send) {
+    any_ |= send;
+    return send;
+  }
+
+  bool keyframe_;
+  bool any_ = false;
+};
+
+}  // namespace xbot::service
+
+#endif  // OUTPUT_CACHE_HPP
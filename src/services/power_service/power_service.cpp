@@ -9,6 +9,7 @@
 #include <cstdio>
 #include <cstring>
 #include <globals.hpp>
+#include <xbot-service/portable/system.hpp>
 
 #include "board.h"
 #include "drivers/adc/adc1.hpp"
@@ -27,6 +28,7 @@ void PowerService::SetDriver(ChargerDriver* charger_driver) {
 
 bool PowerService::OnStart() {
   charger_configured_ = false;
+  keyframe_timer_.Force();
   if (DangerouslyOverrideHardwareChargeCurrentLimit.valid && DangerouslyOverrideHardwareChargeCurrentLimit.value) {
     ULOG_ARG_WARNING(
         &service_id_,
@@ -37,18 +39,6 @@ bool PowerService::OnStart() {
 
 void PowerService::service_tick_() {
   xbot::service::Lock lk{&mtx_};
-  // Send the sensor values
-  StartTransaction();
-  if (charger_configured_) {
-    const char* status_text = ChargerDriver::statusToString(charger_status_);
-    SendChargingStatus(status_text, strlen(status_text));
-  } else {
-    SendChargingStatus(CHARGE_STATUS_NOT_FOUND_STR, strlen(CHARGE_STATUS_NOT_FOUND_STR));
-  }
-  SendBatteryVoltage(battery_volts_);
-  SendChargeVoltage(adapter_volts_);
-  SendChargeCurrent(charge_current_);
-  SendChargerEnabled(true);
   if (BatteryFullVoltage.valid && BatteryEmptyVoltage.valid) {
     battery_percent_ =
         (battery_volts_ - BatteryEmptyVoltage.value) / (BatteryFullVoltage.value - BatteryEmptyVoltage.value);
@@ -56,13 +46,45 @@ void PowerService::service_tick_() {
     battery_percent_ = (battery_volts_ - robot->Power_GetDefaultBatteryEmptyVoltage()) /
                        (robot->Power_GetDefaultBatteryFullVoltage() - robot->Power_GetDefaultBatteryEmptyVoltage());
   }
-  SendBatteryPercentage(etl::max(0.0f, etl::min(1.0f, battery_percent_)));
-  SendChargerInputCurrent(adapter_current_);
+
+  // The host may want the values less often
+  if (!OutputDue(outputs_gate_)) {
+    return;
+  }
+
+  const char* status_text =
+      charger_configured_ ? ChargerDriver::statusToString(charger_status_) : CHARGE_STATUS_NOT_FOUND_STR;
+  const float battery_percent = etl::max(0.0f, etl::min(1.0f, battery_percent_));
+  OutputFrame frame{keyframe_timer_.Due(xbot::service::system::getTimeMicros())};
+  size_t status_length = 0;
+  const bool send_status = frame.Update(charging_status_output_, status_text, &status_length);
+  const bool send_battery_volts = frame.Update(battery_volts_output_, battery_volts_);
+  const bool send_adapter_volts = frame.Update(adapter_volts_output_, adapter_volts_);
+  const bool send_charge_current = frame.Update(charge_current_output_, charge_current_);
+  const bool send_charger_enabled = frame.Update(charger_enabled_output_, true);
+  const bool send_battery_percent = frame.Update(battery_percent_output_, battery_percent);
+  const bool send_adapter_current = frame.Update(adapter_current_output_, adapter_current_);
+  const bool send_battery_volts_adc = frame.Update(battery_volts_adc_output_, battery_volts_adc_);
+  const bool send_adapter_volts_adc = frame.Update(adapter_volts_adc_output_, adapter_volts_adc_);
+  const bool send_dcdc_current = frame.Update(dcdc_current_output_, dcdc_current_);
+  if (!frame.Any()) {
+    return;
+  }
+
+  // Send the sensor values
+  StartTransaction();
+  if (send_status) SendChargingStatus(status_text, status_length);
+  if (send_battery_volts) SendBatteryVoltage(battery_volts_);
+  if (send_adapter_volts) SendChargeVoltage(adapter_volts_);
+  if (send_charge_current) SendChargeCurrent(charge_current_);
+  if (send_charger_enabled) SendChargerEnabled(true);
+  if (send_battery_percent) SendBatteryPercentage(battery_percent);
+  if (send_adapter_current) SendChargerInputCurrent(adapter_current_);
 
   // ADC values
-  SendBatteryVoltageADC(battery_volts_adc_);
-  SendChargeVoltageADC(adapter_volts_adc_);
-  SendDCDCInputCurrent(dcdc_current_);
+  if (send_battery_volts_adc) SendBatteryVoltageADC(battery_volts_adc_);
+  if (send_adapter_volts_adc) SendChargeVoltageADC(adapter_volts_adc_);
+  if (send_dcdc_current) SendDCDCInputCurrent(dcdc_current_);
 
   CommitTransaction();
 }
@@ -12,6 +12,7 @@
 #include <PowerServiceBase.hpp>
 #include <drivers/charger/charger.hpp>
 #include <limits>
+#include <services/output_cache.hpp>
 #include <xbot-service/Lock.hpp>
 
 using namespace xbot::service;
@@ -110,8 +111,8 @@ class PowerService : public PowerServiceBase {
   void update_charger_();
   void read_adc_();
 
-  ServiceSchedule tick_schedule_{*this, 1'000'000,
-                                 XBOT_FUNCTION_FOR_METHOD(PowerService, &PowerService::service_tick_, this)};
+  MonitoredSchedule tick_schedule_{*this, 1'000'000,
+                                   XBOT_FUNCTION_FOR_METHOD(PowerService, &PowerService::service_tick_, this)};
   Schedule driver_schedule_{scheduler_, true, 1'000'000,
                             XBOT_FUNCTION_FOR_METHOD(PowerService, &PowerService::driver_tick_, this)};
 
@@ -133,6 +134,20 @@ class PowerService : public PowerServiceBase {
 
   PowerManagementCallback power_management_callback_;
 
+  // Sensor outputs are only sent when they changed, with a keyframe every 10 s (see services/output_cache.hpp)
+  KeyframeTimer keyframe_timer_{10'000'000};
+  CachedStringOutput charging_status_output_{};
+  CachedOutput<float> battery_volts_output_{0.02f};
+  CachedOutput<float> adapter_volts_output_{0.05f};
+  CachedOutput<float> charge_current_output_{0.01f};
+  CachedOutput<bool> charger_enabled_output_{};
+  CachedOutput<float> battery_percent_output_{0.002f};
+  CachedOutput<float> adapter_current_output_{0.01f};
+  CachedOutput<float> battery_volts_adc_output_{0.02f};
+  CachedOutput<float> adapter_volts_adc_output_{0.05f};
+  CachedOutput<float> dcdc_current_output_{0.01f};
+  xbot::output_subscriptions::OutputGate outputs_gate_{service_id_, xbot::output_subscriptions::ALL_OUTPUTS};
+
   THD_WORKING_AREA(wa, 1500){};
 
  protected:
@@ -1,8 +1,14 @@
 #ifndef SERVICE_EXT_HPP
 #define SERVICE_EXT_HPP
 
+#include <ulog.h>
+
 #include <globals.hpp>
 #include <xbot-service/Service.hpp>
+#include <xbot/deadlines.hpp>
+#include <xbot/output_subscriptions.hpp>
+#include <xbot/system_monitor.hpp>
+#include <xbot/timebase.hpp>
 
 inline bool TimeoutReached(uint32_t duration, uint32_t delay, uint32_t& block_time) {
   if (duration >= delay) {
@@ -23,12 +29,87 @@ class ServiceExt : public Service {
     return false;
   }
 
+  uint16_t GetServiceId() const {
+    return service_id_;
+  }
+
+  // Sets the priority and deadline of the service thread (cfg/thread_priorities.h), call before start()
+  void SetThreadRole(xbot::deadlines::Role role) {
+    thread_role_ = role;
+    has_thread_role_ = true;
+    xbot::deadlines::AssignThread(this, role);
+  }
+
+  bool GetThreadRole(xbot::deadlines::Role* role) const {
+    *role = thread_role_;
+    return has_thread_role_;
+  }
+
   void SendEvent(Events::Events id) {
     syssts_t sts = chSysGetStatusAndLockX();
     chEvtSignalI(process_thread_, EVENT_MASK(id));
     chMBPostI(&packet_queue_, reinterpret_cast<msg_t>(nullptr));
     chSysRestoreStatusX(sts);
   }
+
+ protected:
+  // Decimates an output (or a group of outputs sent together) as subscribed by the host,
+  // see xbot/output_subscriptions.hpp
+  bool OutputDue(xbot::output_subscriptions::OutputGate& gate, bool changed = true) {
+    return gate.Due(xbot::timebase::NowTicks(), changed);
+  }
+
+ private:
+  xbot::deadlines::Role thread_role_ = xbot::deadlines::Role::POWER;
+  bool has_thread_role_ = false;
+};
+
+/**
+ * ServiceSchedule which reports its tick jitter to the system monitor, see xbot/system_monitor.hpp.
+ * With a thread role, late ticks count as deadline misses and the thread priority is verified.
+ */
+class MonitoredSchedule {
+ public:
+  MonitoredSchedule(ServiceExt& service, uint32_t interval_micros, XBOT_FUNCTION_TYPEDEF<void()> callback)
+      : service_(service),
+        callback_(callback),
+        monitor_(interval_micros),
+        schedule_(service, interval_micros,
+                  XBOT_FUNCTION_FOR_METHOD(MonitoredSchedule, &MonitoredSchedule::Run, this)) {
+  }
+
+ private:
+  void Run() {
+    // Not read in the constructor, drivers' schedules can be constructed before their service
+    const int32_t jitter_us = monitor_.Tick(service_.GetServiceId());
+    xbot::deadlines::Role role;
+    if (service_.GetThreadRole(&role)) {
+      xbot::deadlines::Check(role, jitter_us > 0 ? static_cast<uint32_t>(jitter_us) : 0);
+      CheckPriority(role);
+    }
+    callback_();
+  }
+
+  // Runs in the service thread, so it can fix the priority if the thread wasn't created with it
+  void CheckPriority(xbot::deadlines::Role role) {
+    if (priority_checked_) {
+      return;
+    }
+    priority_checked_ = true;
+    const tprio_t expected = xbot::deadlines::PriorityOf(role);
+    const tprio_t actual = chThdGetSelfX()->realprio;
+    if (actual != expected) {
+      ULOG_WARNING("Service %d runs at priority %d instead of %d, correcting", service_.GetServiceId(),
+                   static_cast<int>(actual), static_cast<int>(expected));
+      chThdSetPriority(expected);
+    }
+  }
+
+  ServiceExt& service_;
+  XBOT_FUNCTION_TYPEDEF<void()> callback_;
+  xbot::system_monitor::ScheduleMonitor monitor_;
+  bool priority_checked_ = false;
+  ServiceSchedule schedule_;
 };
 }  // namespace xbot::service
 